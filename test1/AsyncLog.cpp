@@ -0,0 +1,385 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "AsyncLog.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace Pharaoh;
+using namespace std;
+
+//--------------------------------------------------------------------------------
+// static data
+//--------------------------------------------------------------------------------
+
+// how long the writer sleeps when there's nothing to write, only if it has no eventfd
+// to wait on
+const chrono::milliseconds LOG_WRITER_IDLE_TIME(2);
+
+// the writer collects this much before each write
+const size_t LOG_WRITE_BUFFER_SIZE = 64 * 1024;
+
+const char* const LOG_LEVEL_PREFIXES[] =
+{
+    "[ DEBUG ]",
+    "[MESSAGE]",
+    "[WARNING]",
+    "[ ERROR ]",
+};
+
+//--------------------------------------------------------------------------------
+// ctor & dtor
+//--------------------------------------------------------------------------------
+
+AsyncLog& AsyncLog::GetInstance()
+{
+    static AsyncLog instance;
+    return instance;
+}
+
+AsyncLog::AsyncLog()
+    : m_xSlots(new Slot[CAPACITY])
+    , m_WritePosition(0)
+    , m_ReadPosition(0)
+    , m_DroppedCount(0)
+    , m_OutputFd(STDOUT_FILENO)
+    , m_Stop(false)
+    , m_WakeFd(eventfd(0, EFD_CLOEXEC))
+    , m_WriterWaiting(false)
+    , m_FlushWaiters(0)
+{
+    // each slot's sequence says whose turn it is: equal to the position when it's free
+    // to write, position + 1 once there's a line in it to read
+    for(size_t i = 0; i < CAPACITY; i++)
+    {
+        m_xSlots[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    m_Thread = thread(&AsyncLog::WriterThread, this);
+}
+
+AsyncLog::~AsyncLog()
+{
+    m_Stop.store(true);
+    if(m_WakeFd >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t result = write(m_WakeFd, &one, sizeof(one));
+        (void)result;
+    }
+    m_Thread.join();
+
+    if(m_WakeFd >= 0)
+    {
+        close(m_WakeFd);
+    }
+}
+
+//--------------------------------------------------------------------------------
+// producers
+//--------------------------------------------------------------------------------
+
+AsyncLog::Slot* AsyncLog::Reserve(LogLevel level)
+{
+    size_t position = m_WritePosition.load(memory_order_relaxed);
+    while(true)
+    {
+        Slot& slot = m_xSlots[position & (CAPACITY - 1)];
+        intptr_t difference = (intptr_t)slot.sequence.load(memory_order_acquire) - (intptr_t)position;
+        if(difference == 0)
+        {
+            // free - try to claim it
+            if(true == m_WritePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+            {
+                slot.level = level;
+                slot.length = 0;
+                return &slot;
+            }
+        }
+        else if(difference < 0)
+        {
+            // still waiting to be written out - we've gone all the way round
+            m_DroppedCount.fetch_add(1, memory_order_relaxed);
+            return nullptr;
+        }
+        else
+        {
+            // someone else claimed it first
+            position = m_WritePosition.load(memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLog::Commit(Slot* pSlot)
+{
+    pSlot->sequence.store(pSlot->sequence.load(memory_order_relaxed) + 1, memory_order_seq_cst);
+
+    // the writer says it's waiting before it looks at the ring a last time, so either
+    // it sees this line or this sees it waiting. Only one line gets to wake it.
+    if(true == m_WriterWaiting.load(memory_order_seq_cst) && true == m_WriterWaiting.exchange(false))
+    {
+        uint64_t one = 1;
+        ssize_t result = write(m_WakeFd, &one, sizeof(one));
+        (void)result;
+    }
+}
+
+void AsyncLog::Flush()
+{
+    size_t target = m_WritePosition.load(memory_order_acquire);
+    auto written = [&]() { return (intptr_t)(m_ReadPosition.load(memory_order_seq_cst) - target) >= 0; };
+
+    // the writer only takes the lock to wake us when it knows someone is waiting
+    m_FlushWaiters.fetch_add(1);
+    {
+        unique_lock<mutex> lock(m_FlushMutex);
+        m_FlushCondition.wait(lock, written);
+    }
+    m_FlushWaiters.fetch_sub(1);
+}
+
+void AsyncLog::SetOutput(int fd)
+{
+    Flush();
+    m_OutputFd.store(fd);
+}
+
+uint64_t AsyncLog::GetDroppedCount() const
+{
+    return m_DroppedCount.load(memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------
+// the writer
+//--------------------------------------------------------------------------------
+
+void AsyncLog::WriterThread()
+{
+    // the main loop takes its signals through a signalfd, which only works if no thread
+    // can have them delivered
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    while(false == m_Stop.load())
+    {
+        if(false == Drain())
+        {
+            WaitForLines();
+        }
+    }
+    Drain();
+}
+
+void AsyncLog::WaitForLines()
+{
+    if(m_WakeFd < 0)
+    {
+        this_thread::sleep_for(LOG_WRITER_IDLE_TIME);
+        return;
+    }
+
+    // a line committed after the last Drain either shows up here, or sees us waiting
+    // and signals
+    m_WriterWaiting.store(true, memory_order_seq_cst);
+    size_t position = m_ReadPosition.load(memory_order_relaxed);
+    bool ready = (m_xSlots[position & (CAPACITY - 1)].sequence.load(memory_order_seq_cst) == position + 1);
+    if(false == ready && false == m_Stop.load())
+    {
+        uint64_t count;
+        ssize_t result = read(m_WakeFd, &count, sizeof(count));
+        (void)result;
+    }
+    m_WriterWaiting.store(false);
+}
+
+bool AsyncLog::Drain()
+{
+    static char buffer[LOG_WRITE_BUFFER_SIZE];
+    size_t used = 0;
+    int fd = m_OutputFd.load();
+
+    auto writeBuffer = [&]()
+    {
+        size_t written = 0;
+        while(written < used)
+        {
+            ssize_t result = write(fd, buffer + written, used - written);
+            if(result <= 0)
+            {
+                // nowhere to put it, carry on regardless
+                break;
+            }
+            written += result;
+        }
+        used = 0;
+    };
+
+    size_t position = m_ReadPosition.load(memory_order_relaxed);
+    size_t startPosition = position;
+    while(true)
+    {
+        Slot& slot = m_xSlots[position & (CAPACITY - 1)];
+        if(slot.sequence.load(memory_order_acquire) != position + 1)
+        {
+            break;
+        }
+
+        const char* pPrefix = LOG_LEVEL_PREFIXES[slot.level];
+        size_t prefixLength = strlen(pPrefix);
+        if(used + prefixLength + slot.length + 1 > sizeof(buffer))
+        {
+            writeBuffer();
+        }
+        memcpy(buffer + used, pPrefix, prefixLength);
+        used += prefixLength;
+        memcpy(buffer + used, slot.text, slot.length);
+        used += slot.length;
+        buffer[used++] = '\n';
+
+        // give the slot back to the producers, for the next time round
+        slot.sequence.store(position + CAPACITY, memory_order_release);
+        position++;
+    }
+
+    uint64_t droppedCount = m_DroppedCount.load(memory_order_relaxed);
+    if(droppedCount != m_ReportedDroppedCount)
+    {
+        writeBuffer();
+        used += snprintf(buffer + used, sizeof(buffer) - used, "%s%llu log lines dropped\n",
+            LOG_LEVEL_PREFIXES[LogLevel_Warning], (unsigned long long)(droppedCount - m_ReportedDroppedCount));
+        m_ReportedDroppedCount = droppedCount;
+    }
+
+    writeBuffer();
+
+    // only once it's been written. A Flush either sees how far we've got, or is seen
+    // waiting and woken.
+    m_ReadPosition.store(position, memory_order_seq_cst);
+    if(position != startPosition && m_FlushWaiters.load(memory_order_seq_cst) > 0)
+    {
+        lock_guard<mutex> lock(m_FlushMutex);
+        m_FlushCondition.notify_all();
+    }
+    return position != startPosition;
+}
+
+//--------------------------------------------------------------------------------
+// LogLine
+//--------------------------------------------------------------------------------
+
+LogLine::LogLine(LogLevel level)
+    : m_pSlot(AsyncLog::GetInstance().Reserve(level))
+{
+}
+
+LogLine::~LogLine()
+{
+    if(m_pSlot != nullptr)
+    {
+        AsyncLog::GetInstance().Commit(m_pSlot);
+    }
+}
+
+void LogLine::Append(const char* pText, size_t length)
+{
+    if(m_pSlot == nullptr)
+    {
+        return;
+    }
+
+    // anything that doesn't fit is cut off
+    size_t space = AsyncLog::LINE_SIZE - m_pSlot->length;
+    if(length > space)
+    {
+        length = space;
+    }
+    memcpy(m_pSlot->text + m_pSlot->length, pText, length);
+    m_pSlot->length += length;
+}
+
+void LogLine::AppendUnsigned(unsigned long long value, bool negative)
+{
+    char digits[24];
+    char* pDigit = digits + sizeof(digits);
+    do
+    {
+        *--pDigit = '0' + (value % 10);
+        value /= 10;
+    } while(value != 0);
+
+    if(true == negative)
+    {
+        *--pDigit = '-';
+    }
+    Append(pDigit, digits + sizeof(digits) - pDigit);
+}
+
+LogLine& LogLine::operator<<(const char* pText)
+{
+    Append(pText, strlen(pText));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const string& text)
+{
+    Append(text.data(), text.length());
+    return *this;
+}
+
+LogLine& LogLine::operator<<(char c)
+{
+    Append(&c, 1);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(int value)
+{
+    return *this << (long long)value;
+}
+
+LogLine& LogLine::operator<<(unsigned int value)
+{
+    return *this << (unsigned long long)value;
+}
+
+LogLine& LogLine::operator<<(long value)
+{
+    return *this << (long long)value;
+}
+
+LogLine& LogLine::operator<<(unsigned long value)
+{
+    return *this << (unsigned long long)value;
+}
+
+LogLine& LogLine::operator<<(long long value)
+{
+    // negate as unsigned, so the most negative value survives
+    AppendUnsigned((value < 0) ? 0ULL - (unsigned long long)value : (unsigned long long)value, value < 0);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long long value)
+{
+    AppendUnsigned(value, false);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(double value)
+{
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%g", value);
+    Append(text, (length > 0) ? length : 0);
+    return *this;
+}
@@ -0,0 +1,140 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef ASYNCLOG_H_INCLUDED
+#define ASYNCLOG_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Lines below this level are compiled out completely - their arguments aren't even
+// evaluated. Debug builds keep everything.
+#ifndef PHARAOH_LOG_LEVEL
+#ifdef DEBUG
+#define PHARAOH_LOG_LEVEL Pharaoh::LogLevel_Debug
+#else
+#define PHARAOH_LOG_LEVEL Pharaoh::LogLevel_Message
+#endif
+#endif
+
+#define PHARAOH_LOG(level) if((level) < PHARAOH_LOG_LEVEL) {} else Pharaoh::LogLine(level)
+#define LOG_DEBUG PHARAOH_LOG(Pharaoh::LogLevel_Debug)
+#define LOG_MESSAGE PHARAOH_LOG(Pharaoh::LogLevel_Message)
+#define LOG_WARNING PHARAOH_LOG(Pharaoh::LogLevel_Warning)
+#define LOG_ERROR PHARAOH_LOG(Pharaoh::LogLevel_Error)
+
+namespace Pharaoh
+{
+    enum LogLevel
+    {
+        LogLevel_Debug,
+        LogLevel_Message,
+        LogLevel_Warning,
+        LogLevel_Error
+    };
+
+    //! \brief  Process wide log. Lines are formatted straight into a slot of a lock-free
+    //!         ring buffer, and written out by a background thread, so logging never
+    //!         waits on the terminal. If the ring is full the line is dropped (and counted)
+    //!         rather than blocking. The writer sleeps until there's something to write,
+    //!         so an idle process is never woken by it. Use it through the LOG_* macros.
+    class AsyncLog
+    {
+    public:
+        static const size_t LINE_SIZE = 240;
+
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            LogLevel level;
+            uint16_t length;
+            char text[LINE_SIZE];
+        };
+
+        static AsyncLog& GetInstance();
+
+        //! \brief Claim the next slot to write a line into, nullptr if the ring is full.
+        Slot* Reserve(LogLevel level);
+
+        //! \brief Hand a filled slot over to the writer thread.
+        void Commit(Slot* pSlot);
+
+        //! \brief Wait until everything logged so far has been written.
+        void Flush();
+
+        //! \brief Write to this descriptor from now on, stdout by default.
+        void SetOutput(int fd);
+
+        uint64_t GetDroppedCount() const;
+
+    private:
+        AsyncLog();
+        ~AsyncLog();
+
+        void WriterThread();
+        void WaitForLines();
+        bool Drain();
+
+        static const size_t CAPACITY = 4096; // must be a power of two
+
+        std::unique_ptr<Slot[]> m_xSlots;
+        alignas(64) std::atomic<size_t> m_WritePosition;
+        alignas(64) std::atomic<size_t> m_ReadPosition;
+        std::atomic<uint64_t> m_DroppedCount;
+        uint64_t m_ReportedDroppedCount = 0;
+        std::atomic<int> m_OutputFd;
+        std::atomic<bool> m_Stop;
+        std::thread m_Thread;
+
+        // the writer waits on the eventfd once the ring is empty, and only the first
+        // line after that (the one that finds it waiting) signals it
+        int m_WakeFd;
+        std::atomic<bool> m_WriterWaiting;
+
+        // Flush waits for the writer to catch up
+        std::mutex m_FlushMutex;
+        std::condition_variable m_FlushCondition;
+        std::atomic<int> m_FlushWaiters;
+    };
+
+    //! \brief One line of log, written through operator<<. Sent when it goes out of scope.
+    class LogLine
+    {
+    public:
+        explicit LogLine(LogLevel level);
+        ~LogLine();
+
+        LogLine(const LogLine&) = delete;
+        LogLine& operator=(const LogLine&) = delete;
+
+        LogLine& operator<<(const char* pText);
+        LogLine& operator<<(const std::string& text);
+        LogLine& operator<<(char c);
+        LogLine& operator<<(int value);
+        LogLine& operator<<(unsigned int value);
+        LogLine& operator<<(long value);
+        LogLine& operator<<(unsigned long value);
+        LogLine& operator<<(long long value);
+        LogLine& operator<<(unsigned long long value);
+        LogLine& operator<<(double value);
+
+    private:
+        void Append(const char* pText, size_t length);
+        void AppendUnsigned(unsigned long long value, bool negative);
+
+        AsyncLog::Slot* m_pSlot;
+    };
+}
+
+#endif
@@ -0,0 +1,418 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+// pharaoh-bench - runs the window manager against the in-memory FakeXServer, so the
+// handlers and their data structures can be timed without an X server.
+//
+// usage: pharaoh-bench [windows] [drag steps]
+
+#include "WindowManager.h"
+#include "FakeXServer.h"
+#include "AsyncLog.h"
+#include <X11/keysym.h>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace Pharaoh;
+using namespace std;
+
+//--------------------------------------------------------------------------------
+// helpers
+//--------------------------------------------------------------------------------
+
+// runs one scenario step at a time. Each step is a client or user action followed by
+// the window manager handling the events it caused, like one pass of the event loop.
+static void RunScenario(
+    const string& name,
+    FakeXServer& server,
+    WindowManager& windowManager,
+    unsigned int steps,
+    const function<void(unsigned int)>& step)
+{
+    uint64_t events = 0;
+    uint64_t requestsBefore = server.GetRequestCount();
+    auto startTime = chrono::steady_clock::now();
+    for(unsigned int i = 0; i < steps; i++)
+    {
+        step(i);
+        events += server.GetPendingEventCount();
+        windowManager.ProcessEvents();
+    }
+
+    // and whatever the window manager's own requests caused
+    while(server.GetPendingEventCount() > 0)
+    {
+        events += server.GetPendingEventCount();
+        windowManager.ProcessEvents();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    cout << name << ": " << steps << " steps, " << events << " events, "
+         << (server.GetRequestCount() - requestsBefore) << " requests in " << seconds << "s" << endl
+         << "    " << (double)events / seconds << " events/s, "
+         << seconds * 1e6 / (double)steps << "us per step" << endl;
+}
+
+// times the spatial index on its own, with windows scattered over a large desktop.
+// The queries are what a drag would make at every step.
+static void BenchmarkSpatialIndex(Emperor::XBackend& backend, unsigned int windowCount, unsigned int queries)
+{
+    Emperor::LogCallback logCallback(
+        [](const string&) {},
+        [](const string&) {},
+        [](const string&) {},
+        [](const string&) {});
+
+    // unmapped, so nothing is sent to the server
+    vector<unique_ptr<PharaohWindow>> windows;
+    for(unsigned int i = 0; i < windowCount; i++)
+    {
+        windows.emplace_back(new PharaohWindow(
+            logCallback, backend, backend.GetRootWindow(), XCB_WINDOW_NONE,
+            (int)((i * 397) % 3840), (int)((i * 211) % 2160), 200 + (i % 7) * 60, 150 + (i % 5) * 50));
+    }
+
+    SpatialIndex index;
+    auto startTime = chrono::steady_clock::now();
+    for(auto& xWindow : windows)
+    {
+        index.Update(*xWindow);
+    }
+    double insertSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    size_t found = 0;
+    startTime = chrono::steady_clock::now();
+    for(unsigned int i = 0; i < queries; i++)
+    {
+        found += (index.FindAt((int)((i * 7919) % 4000), (int)((i * 104729) % 2300)) != nullptr) ? 1 : 0;
+    }
+    double pointSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    vector<PharaohWindow*> overlapping;
+    size_t overlaps = 0;
+    startTime = chrono::steady_clock::now();
+    for(unsigned int i = 0; i < queries; i++)
+    {
+        index.FindOverlapping((int)((i * 7919) % 4000), (int)((i * 104729) % 2300), 400, 300, overlapping);
+        overlaps += overlapping.size();
+    }
+    double overlapSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    PharaohWindow& dragged = *windows.back();
+    startTime = chrono::steady_clock::now();
+    for(unsigned int i = 0; i < queries; i++)
+    {
+        dragged.SetLocation((int)(i % 3000), (int)((i / 3) % 2000));
+        index.Update(dragged);
+    }
+    double moveSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    cout << "Spatial index: " << windowCount << " windows, "
+         << insertSeconds * 1e9 / (double)max(windowCount, 1u) << "ns per insert" << endl
+         << "    " << pointSeconds * 1e9 / (double)queries << "ns per point query ("
+         << (double)found / (double)queries << " hits), "
+         << overlapSeconds * 1e9 / (double)queries << "ns per 400x300 overlap query ("
+         << (double)overlaps / (double)queries << " windows), "
+         << moveSeconds * 1e9 / (double)queries << "ns per move" << endl;
+}
+
+//--------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    unsigned int windowCount = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 1000;
+    unsigned int dragSteps = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 100000;
+    bool composite = (argc > 3 && string(argv[3]) == "composite");
+
+    // the handlers log as they go, keep that out of the report. It's still queued, so
+    // the cost of logging is part of the timings.
+    int nullFd = open("/dev/null", O_WRONLY);
+    AsyncLog::GetInstance().SetOutput(nullFd);
+
+    // a desktop that was already running when the window manager (re)started
+    FakeXServer server;
+    unsigned int existingCount = windowCount / 10;
+    vector<xcb_window_t> windows(existingCount + windowCount);
+    for(unsigned int i = 0; i < existingCount; i++)
+    {
+        windows[i] = server.ClientCreateWindow((i * 24) % 1200, (i * 18) % 700, 640, 480, false);
+        server.ClientMapWindow(windows[i]);
+    }
+
+    char wireframeOption[] = "--wireframe";
+    char wireframeClass[] = "BenchOutline";
+    char compositeOption[] = "--composite";
+    char* wmArgv[] = { argv[0], wireframeOption, wireframeClass, compositeOption, nullptr };
+    WindowManager windowManager(composite ? 4 : 3, wmArgv);
+    uint64_t requestsBefore = server.GetRequestCount();
+    auto startTime = chrono::steady_clock::now();
+    if(windowManager.Initialise(server) != 0)
+    {
+        cerr << "Failed to initialise the window manager" << endl;
+        return -1;
+    }
+    cout << "Startup: " << existingCount << " existing windows, "
+         << (server.GetRequestCount() - requestsBefore) << " requests in "
+         << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s" << endl;
+
+    // clients create and map their windows
+    RunScenario("Create & map", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        xcb_window_t& window = windows[existingCount + i];
+        window = server.ClientCreateWindow((i * 16) % 1200, (i * 12) % 700, 640, 480, false);
+        server.ClientMapWindow(window);
+    });
+
+    // clients resize themselves
+    RunScenario("Configure", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        xcb_configure_window_value_list_t values = {};
+        values.width = 600 + (i % 80);
+        values.height = 400 + (i % 60);
+        server.ClientConfigureWindow(windows[existingCount + i], XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+    });
+
+    // the user drags the topmost window around by its title bar
+    if(false == windows.empty())
+    {
+        Emperor::XBackend::WindowGeometry frameGeometry;
+        server.GetRootGeometry(server.GetParent(windows.back()), frameGeometry);
+        int startX = frameGeometry.x + frameGeometry.width / 2;
+        int startY = frameGeometry.y + 16;
+        server.PointerPress(startX, startY, XCB_BUTTON_INDEX_1, 0);
+        RunScenario("Drag", server, windowManager, dragSteps, [&](unsigned int i)
+        {
+            server.PointerMotion(startX + (i % 400), startY + (i % 300), XCB_BUTTON_MASK_1);
+        });
+        server.PointerRelease(startX, startY, XCB_BUTTON_INDEX_1, XCB_BUTTON_MASK_1);
+    }
+
+    // and by holding Alt and grabbing it anywhere in the client, which the root's
+    // grab catches
+    if(false == windows.empty())
+    {
+        Emperor::XBackend::WindowGeometry frameGeometry;
+        server.GetRootGeometry(server.GetParent(windows.back()), frameGeometry);
+        int startX = frameGeometry.x + frameGeometry.width / 2;
+        int startY = frameGeometry.y + frameGeometry.height / 2;
+        server.PointerPress(startX, startY, XCB_BUTTON_INDEX_1, XCB_MOD_MASK_1);
+        RunScenario("Alt+drag", server, windowManager, dragSteps, [&](unsigned int i)
+        {
+            server.PointerMotion(startX + (i % 400), startY + (i % 300), XCB_MOD_MASK_1 | XCB_BUTTON_MASK_1);
+        });
+        server.PointerRelease(startX, startY, XCB_BUTTON_INDEX_1, XCB_MOD_MASK_1 | XCB_BUTTON_MASK_1);
+    }
+
+    // then resizes it from the bottom right corner. The client supports
+    // _NET_WM_SYNC_REQUEST, but only manages to repaint every fourth step.
+    if(false == windows.empty())
+    {
+        xcb_window_t window = windows.back();
+        uint32_t counter = server.ClientCreateCounter(0);
+        xcb_atom_t syncRequest = server.ClientInternAtom("_NET_WM_SYNC_REQUEST");
+        server.ClientSetProperty(window, server.ClientInternAtom("WM_PROTOCOLS"), { syncRequest });
+        server.ClientSetProperty(window, server.ClientInternAtom("_NET_WM_SYNC_REQUEST_COUNTER"), { counter });
+
+        Emperor::XBackend::WindowGeometry frameGeometry;
+        server.GetRootGeometry(server.GetParent(window), frameGeometry);
+        int startX = frameGeometry.x + frameGeometry.width - 2;
+        int startY = frameGeometry.y + frameGeometry.height - 2;
+        server.PointerPress(startX, startY, XCB_BUTTON_INDEX_1, 0);
+        int64_t requestedValue = 0;
+        RunScenario("Sync resize", server, windowManager, dragSteps, [&](unsigned int i)
+        {
+            xcb_client_message_event_t message;
+            while(true == server.ClientReceiveMessage(window, message))
+            {
+                if(message.data.data32[0] == syncRequest)
+                {
+                    requestedValue = ((int64_t)message.data.data32[3] << 32) | message.data.data32[2];
+                }
+            }
+            if(i % 4 == 3)
+            {
+                server.ClientSetCounter(counter, requestedValue);
+            }
+            server.PointerMotion(startX + (i % 400), startY + (i % 300), XCB_BUTTON_MASK_1);
+        });
+        server.PointerRelease(startX, startY, XCB_BUTTON_INDEX_1, XCB_BUTTON_MASK_1);
+    }
+
+    // and again, for a window that's resized as an outline
+    if(false == windows.empty())
+    {
+        xcb_window_t window = windows.back();
+        server.ClientSetStringProperty(window, XCB_ATOM_WM_CLASS, string("bench\0BenchOutline\0", 19));
+
+        Emperor::XBackend::WindowGeometry frameGeometry;
+        server.GetRootGeometry(server.GetParent(window), frameGeometry);
+        int startX = frameGeometry.x + frameGeometry.width - 2;
+        int startY = frameGeometry.y + frameGeometry.height - 2;
+        server.PointerPress(startX, startY, XCB_BUTTON_INDEX_1, 0);
+        RunScenario("Wireframe resize", server, windowManager, dragSteps, [&](unsigned int i)
+        {
+            server.PointerMotion(startX + (i % 400), startY + (i % 300), XCB_BUTTON_MASK_1);
+        });
+        server.PointerRelease(startX, startY, XCB_BUTTON_INDEX_1, XCB_BUTTON_MASK_1);
+    }
+
+    // then drags it against the left edge of the screen, so it fills the left half,
+    // and back out to the middle, which gives it its size back
+    if(false == windows.empty())
+    {
+        xcb_window_t window = windows.back();
+        RunScenario("Aero snap", server, windowManager, windowCount / 10, [&](unsigned int i)
+        {
+            Emperor::XBackend::WindowGeometry frameGeometry;
+            server.GetRootGeometry(server.GetParent(window), frameGeometry);
+            int startX = frameGeometry.x + frameGeometry.width / 2;
+            int startY = frameGeometry.y + 16;
+            int endX = (i % 2 == 0) ? 0 : 960;
+            server.PointerPress(startX, startY, XCB_BUTTON_INDEX_1, 0);
+            server.PointerMotion(endX, 540, XCB_BUTTON_MASK_1);
+            server.PointerRelease(endX, 540, XCB_BUTTON_INDEX_1, XCB_BUTTON_MASK_1);
+        });
+    }
+
+    // the user clicks into the middle of one window after another, which raises and
+    // focuses whichever is on top there and hands the click on to its client
+    RunScenario("Click to focus", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        Emperor::XBackend::WindowGeometry clientGeometry;
+        server.GetRootGeometry(windows[existingCount + (i * 7) % windowCount], clientGeometry);
+        int x = clientGeometry.x + clientGeometry.width / 2;
+        int y = clientGeometry.y + clientGeometry.height / 2;
+        server.PointerPress(x, y, XCB_BUTTON_INDEX_1, 0);
+        server.PointerRelease(x, y, XCB_BUTTON_INDEX_1, XCB_BUTTON_MASK_1);
+    });
+
+    // clients raise or lower themselves, a few at a time. Each batch of requests is one
+    // restack of the frames that moved. Lowering is slow on the fake server, so there
+    // are fewer steps.
+    RunScenario("Client restack", server, windowManager, windowCount / 10, [&](unsigned int i)
+    {
+        xcb_configure_window_value_list_t values = {};
+        for(unsigned int j = 0; j < 4; j++)
+        {
+            values.stack_mode = ((i + j) % 3 == 0) ? XCB_STACK_MODE_BELOW : XCB_STACK_MODE_ABOVE;
+            server.ClientConfigureWindow(windows[existingCount + (i * 7 + j) % windowCount], XCB_CONFIG_WINDOW_STACK_MODE, values);
+        }
+        values.stack_mode = XCB_STACK_MODE_ABOVE;
+        server.ClientConfigureWindow(windows[existingCount + (i * 7) % windowCount], XCB_CONFIG_WINDOW_STACK_MODE, values);
+    });
+
+    // a terminal on top blinks its cursor, and scrolls now and then. Composited, only
+    // the cursor is painted again, or the terminal when it scrolls.
+    RunScenario("Cursor blink", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        if((i % 50) == 49)
+        {
+            server.ClientDrawWindow(windows.back());
+        }
+        else
+        {
+            server.ClientDrawWindow(windows.back(), { (int16_t)(8 + (i % 80) * 8), 40, 2, 16 });
+        }
+    });
+
+    // the user cycles through the windows, sometimes with Num Lock on, letting go of Alt
+    // every few presses, while some of the clients go on drawing. Keycode 23 is Tab on
+    // the fake keyboard, 64 is Alt and 50 is Shift.
+    RunScenario("Alt+Tab", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        server.KeyPress(23, XCB_MOD_MASK_1 | ((i % 2) ? XCB_MOD_MASK_2 : 0));
+        server.ClientDrawWindow(windows[existingCount + (i * 3) % windowCount]);
+        if((i % 4) == 1)
+        {
+            // Shift on its own while Alt is still held, as for Alt+Shift+Tab
+            server.KeyPress(50, XCB_MOD_MASK_1);
+            server.KeyRelease(50, XCB_MOD_MASK_1 | XCB_MOD_MASK_SHIFT);
+        }
+        else if((i % 4) == 3)
+        {
+            server.KeyRelease(64, XCB_MOD_MASK_1);
+        }
+    });
+
+    // then moves Tab somewhere else, so every window's grabs have to be redone
+    server.RemapKey(23, XCB_NO_SYMBOL);
+    server.RemapKey(100, XK_Tab);
+    RunScenario("Alt+Tab after remap", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        server.KeyPress(100, XCB_MOD_MASK_1);
+        if((i % 4) == 3)
+        {
+            server.KeyRelease(64, XCB_MOD_MASK_1);
+        }
+    });
+
+    // and taps Alt+Tab, letting go of Alt before the window manager gets to the Tab.
+    // The switcher is never shown, the focus just moves on.
+    RunScenario("Quick Alt+Tab", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        server.KeyPress(100, XCB_MOD_MASK_1);
+        server.KeyRelease(64, XCB_MOD_MASK_1);
+    });
+
+    // short-lived dialogs come and go on top of everything else
+    RunScenario("Dialog churn", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        xcb_window_t dialog = server.ClientCreateWindow(300 + (i % 50), 200 + (i % 40), 320, 200, false);
+        server.ClientMapWindow(dialog);
+        server.ClientUnmapWindow(dialog);
+        server.ClientDestroyWindow(dialog);
+    });
+
+    // a drop-down terminal is hidden and shown over and over
+    if(false == windows.empty())
+    {
+        xcb_window_t terminal = windows.back();
+        RunScenario("Hide & show", server, windowManager, windowCount, [&](unsigned int i)
+        {
+            server.ClientUnmapWindow(terminal);
+            server.ClientMapWindow(terminal);
+        });
+    }
+
+    // as do menus and tooltips, which map themselves without asking
+    RunScenario("Popup churn", server, windowManager, windowCount, [&](unsigned int i)
+    {
+        xcb_window_t popup = server.ClientCreateWindow(400 + (i % 50), 300 + (i % 40), 200, 300, true);
+        server.ClientMapWindow(popup);
+        server.ClientUnmapWindow(popup);
+        server.ClientDestroyWindow(popup);
+    });
+
+    // and the clients go away again
+    RunScenario("Unmap & destroy", server, windowManager, (unsigned int)windows.size(), [&](unsigned int i)
+    {
+        server.ClientUnmapWindow(windows[i]);
+        server.ClientDestroyWindow(windows[i]);
+    });
+
+    // the idle frames the window manager keeps for reuse are still there
+    BenchmarkSpatialIndex(server, windowCount, dragSteps);
+
+    cout << "Windows left on the server: " << server.GetWindowCount() << endl;
+    windowManager.ReportLatency(cout);
+
+    // the round trip report goes through the log
+    AsyncLog::GetInstance().SetOutput(STDOUT_FILENO);
+    windowManager.ReportRoundTrips();
+    windowManager.ReportWindowPool();
+    windowManager.ReportCompositing();
+    AsyncLog::GetInstance().Flush();
+    return 0;
+}
@@ -0,0 +1,526 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "Compositor.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace Pharaoh;
+using namespace std;
+
+// what's shown where there are no windows
+static const uint32_t DESKTOP_COLOUR = 0x3a6ea5;
+
+// past this many separate boxes in a batch, one box round them all is cheaper
+static const size_t MAX_DAMAGE_BOXES = 32;
+
+static int64_t GetArea(const xcb_rectangle_t& box)
+{
+    return (int64_t)box.width * (int64_t)box.height;
+}
+
+static xcb_rectangle_t GetBoundingBox(const xcb_rectangle_t& a, const xcb_rectangle_t& b)
+{
+    int left = min(a.x, b.x);
+    int top = min(a.y, b.y);
+    int right = max(a.x + a.width, b.x + b.width);
+    int bottom = max(a.y + a.height, b.y + b.height);
+    xcb_rectangle_t box = { (int16_t)left, (int16_t)top, (uint16_t)(right - left), (uint16_t)(bottom - top) };
+    return box;
+}
+
+//--------------------------------------------------------------------------------
+// Ctor
+//--------------------------------------------------------------------------------
+
+Compositor::Compositor(
+    Emperor::XBackend& backend,
+    xcb_window_t rootWindow,
+    xcb_window_t overlay,
+    uint16_t width,
+    uint16_t height)
+    : m_Backend(backend)
+    , m_RootWindow(rootWindow)
+    , m_Overlay(overlay)
+    , m_Width(width)
+    , m_Height(height)
+{
+    // everything is painted into the buffer first, so nothing is seen half drawn
+    m_OverlayPicture = m_Backend.CreateWindowPicture(m_Overlay);
+    m_Buffer = m_Backend.CreateBufferPicture(m_Overlay, m_Width, m_Height);
+    Damage(0, 0, m_Width, m_Height);
+}
+
+void Compositor::AddExisting(xcb_window_t window, const Emperor::XBackend::WindowGeometry& geometry, bool mapped)
+{
+    if(window == m_Overlay || m_Index.find(window) != m_Index.end())
+    {
+        return;
+    }
+
+    WindowList::iterator it = Add(
+        window,
+        geometry.x,
+        geometry.y,
+        geometry.width + 2u * geometry.borderWidth,
+        geometry.height + 2u * geometry.borderWidth,
+        true);
+    if(true == mapped)
+    {
+        Show(*it);
+    }
+}
+
+//--------------------------------------------------------------------------------
+// Structure events
+//--------------------------------------------------------------------------------
+
+void Compositor::OnCreateNotify(const xcb_create_notify_event_t& e)
+{
+    // new windows go on top. One that's already here was in the list we started with.
+    if(e.parent != m_RootWindow || e.window == m_Overlay || m_Index.find(e.window) != m_Index.end())
+    {
+        return;
+    }
+    Add(e.window, e.x, e.y, e.width + 2u * e.border_width, e.height + 2u * e.border_width, true);
+}
+
+void Compositor::OnDestroyNotify(const xcb_destroy_notify_event_t& e)
+{
+    if(e.event != m_RootWindow)
+    {
+        return;
+    }
+
+    WindowList::iterator it = Find(e.window);
+    if(it != m_Windows.end())
+    {
+        Remove(it, true);
+    }
+}
+
+void Compositor::OnReparentNotify(const xcb_reparent_notify_event_t& e)
+{
+    if(e.event != m_RootWindow)
+    {
+        return;
+    }
+
+    // a client going into its frame is no longer ours to draw, one coming back out is,
+    // but the event doesn't say how big it is
+    WindowList::iterator it = Find(e.window);
+    if(e.parent != m_RootWindow)
+    {
+        if(it != m_Windows.end())
+        {
+            Remove(it, false);
+        }
+    }
+    else if(it == m_Windows.end())
+    {
+        Add(e.window, e.x, e.y, 0, 0, false);
+    }
+}
+
+void Compositor::OnConfigureNotify(const xcb_configure_notify_event_t& e)
+{
+    if(e.event != m_RootWindow)
+    {
+        return;
+    }
+    WindowList::iterator it = Find(e.window);
+    if(it == m_Windows.end())
+    {
+        return;
+    }
+
+    CompositedWindow& window = *it;
+    const unsigned int width = e.width + 2u * e.border_width;
+    const unsigned int height = e.height + 2u * e.border_width;
+    const bool resized = (false == window.sizeKnown || width != window.width || height != window.height);
+    const bool moved = (e.x != window.x || e.y != window.y);
+    const xcb_window_t below = (it == m_Windows.begin()) ? XCB_WINDOW_NONE : prev(it)->window;
+    if(false == resized && false == moved && below == e.above_sibling)
+    {
+        return;
+    }
+
+    // where it was is uncovered, where it is now is covered
+    if(true == window.mapped)
+    {
+        DamageWindow(window);
+    }
+
+    // a resized window has a new pixmap, named again when it's next painted
+    if(true == resized && window.picture != 0)
+    {
+        m_Backend.FreePicture(window.picture);
+        window.picture = 0;
+    }
+    window.x = e.x;
+    window.y = e.y;
+    window.width = width;
+    window.height = height;
+    window.sizeKnown = true;
+    Restack(it, e.above_sibling);
+
+    if(true == window.mapped)
+    {
+        DamageWindow(window);
+    }
+}
+
+void Compositor::OnMapNotify(const xcb_map_notify_event_t& e)
+{
+    if(e.event != m_RootWindow)
+    {
+        return;
+    }
+
+    WindowList::iterator it = Find(e.window);
+    if(it != m_Windows.end() && false == it->mapped)
+    {
+        Show(*it);
+    }
+}
+
+void Compositor::OnUnmapNotify(const xcb_unmap_notify_event_t& e)
+{
+    if(e.event != m_RootWindow)
+    {
+        return;
+    }
+
+    WindowList::iterator it = Find(e.window);
+    if(it != m_Windows.end() && true == it->mapped)
+    {
+        Hide(*it, false);
+    }
+}
+
+bool Compositor::OnDamage(uint32_t damage, const xcb_rectangle_t& area)
+{
+    unordered_map<uint32_t, WindowList::iterator>::iterator it = m_ByDamage.find(damage);
+    if(it == m_ByDamage.end())
+    {
+        return false;
+    }
+
+    // the area is the box round everything drawn since the damage was last subtracted
+    const CompositedWindow& window = *it->second;
+    Damage(window.x + area.x, window.y + area.y, area.width, area.height);
+    m_DamageToSubtract.insert(damage);
+    return true;
+}
+
+//--------------------------------------------------------------------------------
+// Repaint
+//--------------------------------------------------------------------------------
+
+void Compositor::Repaint()
+{
+    // sizes asked for since the last repaint, all in one round trip
+    for(const pair<xcb_window_t, xcb_get_geometry_cookie_t>& pending : m_PendingGeometry)
+    {
+        Emperor::XBackend::WindowGeometry geometry;
+        WindowList::iterator it = Find(pending.first);
+        if(true == m_Backend.ReceiveGeometry(pending.second, geometry) && it != m_Windows.end() && false == it->sizeKnown)
+        {
+            it->width = geometry.width + 2u * geometry.borderWidth;
+            it->height = geometry.height + 2u * geometry.borderWidth;
+            it->sizeKnown = true;
+            if(true == it->mapped)
+            {
+                DamageWindow(*it);
+            }
+        }
+    }
+    m_PendingGeometry.clear();
+
+    // what the windows mapped since then draw is reported from now on
+    for(xcb_window_t mapped : m_NewlyMapped)
+    {
+        WindowList::iterator it = Find(mapped);
+        if(it != m_Windows.end() && true == it->mapped && it->damage == 0)
+        {
+            it->damage = m_Backend.CreateAreaDamage(it->window);
+            m_ByDamage[it->damage] = it;
+        }
+    }
+    m_NewlyMapped.clear();
+
+    if(true == m_Damage.empty() && true == m_DamageToSubtract.empty())
+    {
+        return;
+    }
+
+    // anything drawn from here on is reported again
+    for(uint32_t damage : m_DamageToSubtract)
+    {
+        m_Backend.SubtractDamage(damage);
+    }
+    m_DamageToSubtract.clear();
+
+    MergeDamage();
+    for(const xcb_rectangle_t& area : m_Damage)
+    {
+        Paint(area);
+        m_RepaintedArea += (uint64_t)GetArea(area);
+    }
+    if(false == m_Damage.empty())
+    {
+        m_RepaintCount++;
+    }
+    m_Damage.clear();
+}
+
+void Compositor::MergeDamage()
+{
+    // boxes that overlap, or nearly touch, are painted as one. A box no bigger than the
+    // two put together costs no more than painting them both.
+    bool merged = true;
+    while(true == merged)
+    {
+        merged = false;
+        for(size_t i = 0; i < m_Damage.size(); i++)
+        {
+            for(size_t j = i + 1; j < m_Damage.size();)
+            {
+                xcb_rectangle_t box = GetBoundingBox(m_Damage[i], m_Damage[j]);
+                if(GetArea(box) <= GetArea(m_Damage[i]) + GetArea(m_Damage[j]))
+                {
+                    m_Damage[i] = box;
+                    m_Damage[j] = m_Damage.back();
+                    m_Damage.pop_back();
+                    merged = true;
+                }
+                else
+                {
+                    j++;
+                }
+            }
+        }
+    }
+
+    if(m_Damage.size() > MAX_DAMAGE_BOXES)
+    {
+        xcb_rectangle_t box = m_Damage[0];
+        for(const xcb_rectangle_t& area : m_Damage)
+        {
+            box = GetBoundingBox(box, area);
+        }
+        m_Damage.assign(1, box);
+    }
+}
+
+void Compositor::Paint(const xcb_rectangle_t& area)
+{
+    // painted top down, each window only into the parts of the box nothing above it
+    // has covered. Windows that are hidden cost nothing, and painting stops as soon as
+    // the box is full - typing in a window repaints just that window.
+    m_Uncovered.assign(1, area);
+    for(WindowList::reverse_iterator it = m_Windows.rbegin(); it != m_Windows.rend() && false == m_Uncovered.empty(); ++it)
+    {
+        CompositedWindow& window = *it;
+        if(false == window.mapped || false == window.sizeKnown)
+        {
+            continue;
+        }
+        const int windowRight = window.x + (int)window.width;
+        const int windowBottom = window.y + (int)window.height;
+        if(windowRight <= area.x || windowBottom <= area.y ||
+            window.x >= area.x + area.width || window.y >= area.y + area.height)
+        {
+            continue;
+        }
+
+        m_Remaining.clear();
+        for(const xcb_rectangle_t& piece : m_Uncovered)
+        {
+            const int pieceRight = piece.x + piece.width;
+            const int pieceBottom = piece.y + piece.height;
+            const int left = max((int)piece.x, window.x);
+            const int top = max((int)piece.y, window.y);
+            const int right = min(pieceRight, windowRight);
+            const int bottom = min(pieceBottom, windowBottom);
+            if(right <= left || bottom <= top)
+            {
+                m_Remaining.push_back(piece);
+                continue;
+            }
+
+            if(window.picture == 0)
+            {
+                window.picture = m_Backend.CreateContentsPicture(window.window);
+            }
+            m_Backend.CompositePicture(
+                window.picture,
+                m_Buffer,
+                (int16_t)(left - window.x),
+                (int16_t)(top - window.y),
+                (int16_t)left,
+                (int16_t)top,
+                (uint16_t)(right - left),
+                (uint16_t)(bottom - top));
+
+            // what's left of the piece: above, below, then either side
+            if(top > piece.y)
+            {
+                m_Remaining.push_back({ piece.x, piece.y, piece.width, (uint16_t)(top - piece.y) });
+            }
+            if(bottom < pieceBottom)
+            {
+                m_Remaining.push_back({ piece.x, (int16_t)bottom, piece.width, (uint16_t)(pieceBottom - bottom) });
+            }
+            if(left > piece.x)
+            {
+                m_Remaining.push_back({ piece.x, (int16_t)top, (uint16_t)(left - piece.x), (uint16_t)(bottom - top) });
+            }
+            if(right < pieceRight)
+            {
+                m_Remaining.push_back({ (int16_t)right, (int16_t)top, (uint16_t)(pieceRight - right), (uint16_t)(bottom - top) });
+            }
+        }
+        m_Uncovered.swap(m_Remaining);
+    }
+
+    // the desktop shows through whatever's left
+    for(const xcb_rectangle_t& piece : m_Uncovered)
+    {
+        m_Backend.FillRectangle(m_Buffer, DESKTOP_COLOUR, piece);
+    }
+
+    m_Backend.CompositePicture(m_Buffer, m_OverlayPicture, area.x, area.y, area.x, area.y, area.width, area.height);
+}
+
+//--------------------------------------------------------------------------------
+// Windows
+//--------------------------------------------------------------------------------
+
+Compositor::WindowList::iterator Compositor::Add(
+    xcb_window_t window,
+    int x,
+    int y,
+    unsigned int width,
+    unsigned int height,
+    bool sizeKnown)
+{
+    CompositedWindow composited = { window, x, y, width, height, sizeKnown, false, 0, 0 };
+    WindowList::iterator it = m_Windows.insert(m_Windows.end(), composited);
+    m_Index[window] = it;
+    return it;
+}
+
+Compositor::WindowList::iterator Compositor::Find(xcb_window_t window)
+{
+    unordered_map<xcb_window_t, WindowList::iterator>::iterator it = m_Index.find(window);
+    return (it != m_Index.end()) ? it->second : m_Windows.end();
+}
+
+void Compositor::Remove(WindowList::iterator it, bool destroyed)
+{
+    if(true == it->mapped)
+    {
+        Hide(*it, destroyed);
+    }
+    m_Index.erase(it->window);
+    m_Windows.erase(it);
+}
+
+void Compositor::Restack(WindowList::iterator it, xcb_window_t aboveSibling)
+{
+    // straight above its sibling, or at the bottom
+    WindowList::iterator position = m_Windows.begin();
+    if(aboveSibling != XCB_WINDOW_NONE)
+    {
+        WindowList::iterator sibling = Find(aboveSibling);
+        if(sibling == m_Windows.end() || sibling == it)
+        {
+            return;
+        }
+        position = next(sibling);
+    }
+    if(position != it)
+    {
+        m_Windows.splice(position, m_Windows, it);
+    }
+}
+
+void Compositor::Show(CompositedWindow& window)
+{
+    // its damage is made at the repaint, popups that come and go in one batch never
+    // need one
+    window.mapped = true;
+    m_NewlyMapped.push_back(window.window);
+    if(true == window.sizeKnown)
+    {
+        DamageWindow(window);
+    }
+    else
+    {
+        m_PendingGeometry.emplace_back(window.window, m_Backend.RequestGeometry(window.window));
+    }
+}
+
+void Compositor::Hide(CompositedWindow& window, bool destroyed)
+{
+    DamageWindow(window);
+    if(window.picture != 0)
+    {
+        m_Backend.FreePicture(window.picture);
+        window.picture = 0;
+    }
+
+    // a destroyed window's damage has gone with it
+    if(window.damage != 0)
+    {
+        m_ByDamage.erase(window.damage);
+        m_DamageToSubtract.erase(window.damage);
+        if(false == destroyed)
+        {
+            m_Backend.DestroyDamage(window.damage);
+        }
+        window.damage = 0;
+    }
+    window.mapped = false;
+}
+
+void Compositor::DamageWindow(const CompositedWindow& window)
+{
+    if(true == window.sizeKnown)
+    {
+        Damage(window.x, window.y, (int)window.width, (int)window.height);
+    }
+}
+
+void Compositor::Damage(int x, int y, int width, int height)
+{
+    // only what's on screen
+    const int left = max(x, 0);
+    const int top = max(y, 0);
+    const int right = min(x + width, (int)m_Width);
+    const int bottom = min(y + height, (int)m_Height);
+    if(right > left && bottom > top)
+    {
+        m_Damage.push_back({ (int16_t)left, (int16_t)top, (uint16_t)(right - left), (uint16_t)(bottom - top) });
+    }
+}
+
+//--------------------------------------------------------------------------------
+// Others
+//--------------------------------------------------------------------------------
+
+uint64_t Compositor::GetRepaintCount() const
+{
+    return m_RepaintCount;
+}
+
+uint64_t Compositor::GetRepaintedArea() const
+{
+    return m_RepaintedArea;
+}
@@ -0,0 +1,131 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef COMPOSITOR_H_INCLUDED
+#define COMPOSITOR_H_INCLUDED
+
+#include <xcb/xcb.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "XBackend.h"
+
+namespace Pharaoh
+{
+    //! \brief  Draws the root's children ourselves (--composite). They're redirected off
+    //!         screen, and painted through Render into a buffer and from there onto the
+    //!         overlay window. What each window draws comes in as damaged boxes, which
+    //!         are gathered over an event batch, merged, and only they are painted
+    //!         again: a blinking cursor repaints a cursor-sized box, and with nothing
+    //!         changing nothing is done at all.
+    //!         The windows are followed from the root's substructure events alone, so
+    //!         popups and our own windows are drawn the same as frames.
+    class Compositor
+    {
+    public:
+        //! \brief ctor - Start drawing the windows, the whole screen first.
+        //! \param backend The X server to use.
+        //! \param rootWindow The root window, whose children are drawn.
+        //! \param overlay The window to draw on, from XBackend::StartCompositing.
+        //! \param width The root window's width.
+        //! \param height The root window's height.
+        Compositor(
+            Emperor::XBackend& backend,
+            xcb_window_t rootWindow,
+            xcb_window_t overlay,
+            uint16_t width,
+            uint16_t height);
+
+        //! \brief Add a window that was there before we started. Bottom to top, after the ctor.
+        void AddExisting(xcb_window_t window, const Emperor::XBackend::WindowGeometry& geometry, bool mapped);
+
+        void OnCreateNotify(const xcb_create_notify_event_t& e);
+        void OnDestroyNotify(const xcb_destroy_notify_event_t& e);
+        void OnReparentNotify(const xcb_reparent_notify_event_t& e);
+        void OnConfigureNotify(const xcb_configure_notify_event_t& e);
+        void OnMapNotify(const xcb_map_notify_event_t& e);
+        void OnUnmapNotify(const xcb_unmap_notify_event_t& e);
+
+        //! \brief  Note part of a window that's been drawn in.
+        //! \return false if the damage isn't one of ours.
+        bool OnDamage(uint32_t damage, const xcb_rectangle_t& area);
+
+        //! \brief Paint whatever's been damaged since last time, once per event batch.
+        void Repaint();
+
+        //! \brief How many times something was painted, and how many pixels in all.
+        uint64_t GetRepaintCount() const;
+        uint64_t GetRepaintedArea() const;
+
+    private:
+        struct CompositedWindow
+        {
+            xcb_window_t window;
+            int x;
+            int y;
+            unsigned int width;     // with the border
+            unsigned int height;
+            bool sizeKnown;         // not after it's reparented to the root
+            bool mapped;
+            uint32_t picture;       // named when it's first painted, 0 until then
+            uint32_t damage;        // while it's mapped, from the first repaint after
+        };
+
+        // the root's children, bottom to top, mapped or not
+        typedef std::list<CompositedWindow> WindowList;
+
+        WindowList::iterator Add(xcb_window_t window, int x, int y, unsigned int width, unsigned int height, bool sizeKnown);
+        WindowList::iterator Find(xcb_window_t window);
+        void Remove(WindowList::iterator it, bool destroyed);
+        void Restack(WindowList::iterator it, xcb_window_t aboveSibling);
+        void Show(CompositedWindow& window);
+        void Hide(CompositedWindow& window, bool destroyed);
+        void DamageWindow(const CompositedWindow& window);
+        void Damage(int x, int y, int width, int height);
+        void MergeDamage();
+        void Paint(const xcb_rectangle_t& area);
+
+        Emperor::XBackend& m_Backend;
+        xcb_window_t m_RootWindow;
+        xcb_window_t m_Overlay;
+        uint16_t m_Width;
+        uint16_t m_Height;
+        uint32_t m_OverlayPicture;
+        uint32_t m_Buffer;
+
+        WindowList m_Windows;
+        std::unordered_map<xcb_window_t, WindowList::iterator> m_Index;
+        std::unordered_map<uint32_t, WindowList::iterator> m_ByDamage;
+
+        // what's to be painted at the end of the batch, in root coordinates, and the
+        // damage it came from, to be subtracted first
+        std::vector<xcb_rectangle_t> m_Damage;
+        std::unordered_set<uint32_t> m_DamageToSubtract;
+
+        // windows mapped since the last repaint, to be given damage
+        std::vector<xcb_window_t> m_NewlyMapped;
+
+        // sizes asked for when a window with none was mapped, collected at the repaint
+        std::vector<std::pair<xcb_window_t, xcb_get_geometry_cookie_t>> m_PendingGeometry;
+
+        // the parts of the box being painted that are still to be painted, kept to save
+        // allocating them every time
+        std::vector<xcb_rectangle_t> m_Uncovered;
+        std::vector<xcb_rectangle_t> m_Remaining;
+
+        uint64_t m_RepaintCount = 0;
+        uint64_t m_RepaintedArea = 0;
+    };
+}
+
+#endif
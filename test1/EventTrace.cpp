@@ -0,0 +1,122 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "EventTrace.h"
+#include <cstring>
+
+using namespace std;
+using namespace Pharaoh;
+
+// file header, records follow immediately after it
+struct EventTraceHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+const char EVENT_TRACE_MAGIC[8] = { 'P', 'H', 'A', 'R', 'T', 'R', 'C', '\0' };
+const uint32_t EVENT_TRACE_VERSION = 1;
+
+// buffer a good number of records per write, recording shouldn't cost a syscall per event
+const size_t EVENT_TRACE_BUFFER_SIZE = 64 * 1024;
+
+//--------------------------------------------------------------------------------
+// EventTraceWriter
+//--------------------------------------------------------------------------------
+EventTraceWriter::~EventTraceWriter()
+{
+    Close();
+}
+
+bool EventTraceWriter::Open(const string& path)
+{
+    Close();
+
+    m_pFile = fopen(path.c_str(), "wb");
+    if(m_pFile == nullptr)
+    {
+        return false;
+    }
+
+    m_Buffer.resize(EVENT_TRACE_BUFFER_SIZE);
+    setvbuf(m_pFile, m_Buffer.data(), _IOFBF, m_Buffer.size());
+
+    EventTraceHeader header;
+    memcpy(header.magic, EVENT_TRACE_MAGIC, sizeof(header.magic));
+    header.version = EVENT_TRACE_VERSION;
+    header.recordSize = sizeof(EventTraceRecord);
+    fwrite(&header, sizeof(header), 1, m_pFile);
+
+    m_StartTime = chrono::steady_clock::now();
+    return true;
+}
+
+void EventTraceWriter::Close()
+{
+    if(m_pFile != nullptr)
+    {
+        fclose(m_pFile);
+        m_pFile = nullptr;
+    }
+}
+
+bool EventTraceWriter::IsOpen() const
+{
+    return m_pFile != nullptr;
+}
+
+void EventTraceWriter::Write(const xcb_generic_event_t* pEvent, bool batchStart)
+{
+    if(m_pFile == nullptr)
+    {
+        return;
+    }
+
+    EventTraceRecord record;
+    record.timestamp = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - m_StartTime).count();
+    record.sequence = pEvent->full_sequence;
+    record.flags = (true == batchStart) ? EventTraceRecord::Flags_BatchStart : 0;
+
+    // the first 32 bytes are the wire event, full_sequence is XCB's own addition
+    memcpy(record.event, pEvent, sizeof(record.event));
+
+    fwrite(&record, sizeof(record), 1, m_pFile);
+}
+
+//--------------------------------------------------------------------------------
+// Reading
+//--------------------------------------------------------------------------------
+bool Pharaoh::ReadEventTrace(const string& path, vector<EventTraceRecord>& records)
+{
+    FILE* pFile = fopen(path.c_str(), "rb");
+    if(pFile == nullptr)
+    {
+        return false;
+    }
+
+    EventTraceHeader header;
+    if(fread(&header, sizeof(header), 1, pFile) != 1 ||
+        memcmp(header.magic, EVENT_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != EVENT_TRACE_VERSION ||
+        header.recordSize != sizeof(EventTraceRecord))
+    {
+        fclose(pFile);
+        return false;
+    }
+
+    records.clear();
+    EventTraceRecord record;
+    while(fread(&record, sizeof(record), 1, pFile) == 1)
+    {
+        records.push_back(record);
+    }
+
+    fclose(pFile);
+    return true;
+}
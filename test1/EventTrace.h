@@ -0,0 +1,69 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef EVENTTRACE_H_INCLUDED
+#define EVENTTRACE_H_INCLUDED
+
+#include <xcb/xcb.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Pharaoh
+{
+    //! \brief One recorded X event. Fixed size, written to the trace file as-is.
+    struct EventTraceRecord
+    {
+        enum Flags
+        {
+            Flags_BatchStart = 1    //!< First event read in a batch by the event loop.
+        };
+
+        uint64_t timestamp;         //!< Nanoseconds since the recording started.
+        uint32_t sequence;          //!< Full sequence number of the last request the server had processed.
+        uint32_t flags;             //!< Combination of Flags values.
+        uint8_t event[32];          //!< The event exactly as it came off the wire.
+    };
+
+    //! \brief Writes a binary trace of the X events the window manager receives.
+    class EventTraceWriter
+    {
+    public:
+        ~EventTraceWriter();
+
+        //! \brief Create the trace file, replacing any existing file.
+        //! \return true if the file was opened, false if not.
+        bool Open(const std::string& path);
+
+        //! \brief Flush and close the trace file.
+        void Close();
+
+        //! \brief Return true if a trace is being recorded.
+        bool IsOpen() const;
+
+        //! \brief Append an event to the trace. Writes are buffered.
+        //! \param pEvent The event, as returned by XCB.
+        //! \param batchStart true if this is the first event of an event loop batch.
+        void Write(const xcb_generic_event_t* pEvent, bool batchStart);
+
+    private:
+        FILE* m_pFile = nullptr;
+        std::vector<char> m_Buffer;
+        std::chrono::steady_clock::time_point m_StartTime;
+    };
+
+    //! \brief Read a whole trace file written by EventTraceWriter.
+    //! \param path The trace file.
+    //! \param records Output, the records in the order they were recorded.
+    //! \return true if the trace was read, false if the file couldn't be opened or isn't a trace.
+    bool ReadEventTrace(const std::string& path, std::vector<EventTraceRecord>& records);
+}
+
+#endif
@@ -0,0 +1,1800 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "FakeXServer.h"
+#include "KeySymbols.h"
+#include <X11/keysym.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Pharaoh;
+using namespace std;
+
+//--------------------------------------------------------------------------------
+// static data
+//--------------------------------------------------------------------------------
+
+// window ids are handed out from a different range for each "connection"
+const xcb_window_t FAKE_ROOT_WINDOW = 0x00000100;
+const xcb_window_t FAKE_FIRST_CLIENT_WINDOW = 0x00200001;
+const xcb_window_t FAKE_FIRST_MANAGER_WINDOW = 0x00400001;
+
+// the first atom after the predefined ones
+const xcb_atom_t FAKE_FIRST_ATOM = XCB_ATOM_WM_TRANSIENT_FOR + 1;
+
+// the one monitor
+const unsigned int FAKE_REFRESH_RATE = 60;
+
+// where the SYNC extension's events would be, if it were asked
+const uint8_t FAKE_SYNC_FIRST_EVENT = 90;
+const uint8_t FAKE_SYNC_ALARM_NOTIFY = 1;
+
+// and Composite, Render and DAMAGE, as a real server might number them
+const uint8_t FAKE_RENDER_MAJOR_OPCODE = 139;
+const uint8_t FAKE_COMPOSITE_MAJOR_OPCODE = 142;
+const uint8_t FAKE_DAMAGE_MAJOR_OPCODE = 143;
+const uint8_t FAKE_DAMAGE_FIRST_EVENT = 92;
+const uint8_t FAKE_DAMAGE_NOTIFY = 0;
+
+// a minimal keyboard - one keysym per keycode, only the keys the window manager uses
+const xcb_keycode_t FAKE_MIN_KEYCODE = 8;
+const xcb_keycode_t FAKE_MAX_KEYCODE = 255;
+const struct { xcb_keycode_t keycode; xcb_keysym_t keysym; } FAKE_KEYMAP[] =
+{
+    { 9, XK_Escape },
+    { 23, XK_Tab },
+    { 36, XK_Return },
+    { 37, XK_Control_L },
+    { 50, XK_Shift_L },
+    { 64, XK_Alt_L },
+    { 65, XK_space },
+    { 67, XK_F1 },
+    { 68, XK_F2 },
+    { 69, XK_F3 },
+    { 70, XK_F4 },
+    { 71, XK_F5 },
+    { 72, XK_F6 },
+    { 73, XK_F7 },
+    { 74, XK_F8 },
+    { 75, XK_F9 },
+    { 76, XK_F10 },
+};
+
+//--------------------------------------------------------------------------------
+// ctor & dtor
+//--------------------------------------------------------------------------------
+
+FakeXServer::FakeXServer(uint16_t screenWidth, uint16_t screenHeight)
+    : m_ScreenWidth(screenWidth)
+    , m_ScreenHeight(screenHeight)
+    , m_RootWindow(FAKE_ROOT_WINDOW)
+    , m_NextClientWindow(FAKE_FIRST_CLIENT_WINDOW)
+    , m_NextManagerWindow(FAKE_FIRST_MANAGER_WINDOW)
+    , m_Focus(FAKE_ROOT_WINDOW)
+{
+    FakeWindow& root = m_Windows[m_RootWindow];
+    root.parent = XCB_WINDOW_NONE;
+    root.x = 0;
+    root.y = 0;
+    root.width = screenWidth;
+    root.height = screenHeight;
+    root.borderWidth = 0;
+    root.mapped = true;
+    root.overrideRedirect = false;
+    root.eventMask = 0;
+
+    m_Keysyms.assign(FAKE_MAX_KEYCODE - FAKE_MIN_KEYCODE + 1, XCB_NO_SYMBOL);
+    for(const auto& key : FAKE_KEYMAP)
+    {
+        m_Keysyms[key.keycode - FAKE_MIN_KEYCODE] = key.keysym;
+    }
+}
+
+FakeXServer::~FakeXServer()
+{
+}
+
+//--------------------------------------------------------------------------------
+// the client side
+//--------------------------------------------------------------------------------
+
+xcb_window_t FakeXServer::ClientCreateWindow(int16_t x, int16_t y, uint16_t width, uint16_t height, bool overrideRedirect)
+{
+    xcb_window_t window = m_NextClientWindow++;
+    uint32_t values[1] = { overrideRedirect ? 1u : 0u };
+    AddWindow(window, m_RootWindow, x, y, width, height, XCB_CW_OVERRIDE_REDIRECT, values);
+    return window;
+}
+
+void FakeXServer::ClientMapWindow(xcb_window_t window)
+{
+    FakeWindow* pWindow = FindWindow(window);
+    if(pWindow == nullptr || true == pWindow->mapped)
+    {
+        return;
+    }
+
+    // the window manager decides when a redirected window gets mapped
+    const FakeWindow* pParent = FindWindow(pWindow->parent);
+    if(false == pWindow->overrideRedirect && (pParent->eventMask & XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT) != 0)
+    {
+        xcb_map_request_event_t mapRequest = {};
+        mapRequest.response_type = XCB_MAP_REQUEST;
+        mapRequest.parent = pWindow->parent;
+        mapRequest.window = window;
+        QueueEvent(&mapRequest);
+        return;
+    }
+
+    DoMap(window, *pWindow);
+}
+
+void FakeXServer::ClientUnmapWindow(xcb_window_t window)
+{
+    FakeWindow* pWindow = FindWindow(window);
+    if(pWindow != nullptr)
+    {
+        DoUnmap(window, *pWindow);
+    }
+}
+
+void FakeXServer::ClientConfigureWindow(xcb_window_t window, uint16_t valueMask, const xcb_configure_window_value_list_t& values)
+{
+    FakeWindow* pWindow = FindWindow(window);
+    if(pWindow == nullptr)
+    {
+        return;
+    }
+
+    const FakeWindow* pParent = FindWindow(pWindow->parent);
+    if(false == pWindow->overrideRedirect && (pParent->eventMask & XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT) != 0)
+    {
+        // the request carries the current value of anything that isn't being changed
+        xcb_configure_request_event_t configureRequest = {};
+        configureRequest.response_type = XCB_CONFIGURE_REQUEST;
+        configureRequest.stack_mode = (valueMask & XCB_CONFIG_WINDOW_STACK_MODE) ? values.stack_mode : XCB_STACK_MODE_ABOVE;
+        configureRequest.parent = pWindow->parent;
+        configureRequest.window = window;
+        configureRequest.sibling = (valueMask & XCB_CONFIG_WINDOW_SIBLING) ? values.sibling : XCB_WINDOW_NONE;
+        configureRequest.x = (valueMask & XCB_CONFIG_WINDOW_X) ? values.x : pWindow->x;
+        configureRequest.y = (valueMask & XCB_CONFIG_WINDOW_Y) ? values.y : pWindow->y;
+        configureRequest.width = (valueMask & XCB_CONFIG_WINDOW_WIDTH) ? values.width : pWindow->width;
+        configureRequest.height = (valueMask & XCB_CONFIG_WINDOW_HEIGHT) ? values.height : pWindow->height;
+        configureRequest.border_width = (valueMask & XCB_CONFIG_WINDOW_BORDER_WIDTH) ? values.border_width : pWindow->borderWidth;
+        configureRequest.value_mask = valueMask;
+        QueueEvent(&configureRequest);
+        return;
+    }
+
+    ApplyConfigure(window, *pWindow, valueMask, values);
+}
+
+xcb_atom_t FakeXServer::ClientInternAtom(const string& name)
+{
+    return InternAtom(name);
+}
+
+bool FakeXServer::ClientReceiveMessage(xcb_window_t window, xcb_client_message_event_t& message)
+{
+    auto it = m_ClientMessages.find(window);
+    if(it == m_ClientMessages.end() || true == it->second.empty())
+    {
+        return false;
+    }
+
+    message = it->second.front();
+    it->second.pop_front();
+    return true;
+}
+
+uint32_t FakeXServer::ClientCreateCounter(int64_t value)
+{
+    // counters share the client's id range
+    uint32_t counter = m_NextClientWindow++;
+    m_Counters[counter] = value;
+    return counter;
+}
+
+void FakeXServer::ClientSetCounter(uint32_t counter, int64_t value)
+{
+    auto counterIt = m_Counters.find(counter);
+    if(counterIt == m_Counters.end())
+    {
+        return;
+    }
+
+    counterIt->second = value;
+    for(auto& alarm : m_Alarms)
+    {
+        if(alarm.second.counter == counter)
+        {
+            CheckAlarm(alarm.first, alarm.second);
+        }
+    }
+}
+
+void FakeXServer::ClientDrawWindow(xcb_window_t window)
+{
+    const FakeWindow* pWindow = FindWindow(window);
+    if(pWindow != nullptr)
+    {
+        ClientDrawWindow(window, { 0, 0, pWindow->width, pWindow->height });
+    }
+}
+
+void FakeXServer::ClientDrawWindow(xcb_window_t window, const xcb_rectangle_t& area)
+{
+    // a redirected window's drawing lands in the contents of the windows it's in, so
+    // damage to any of them is reported, once until it's subtracted, or each time the
+    // box round it grows. Where the area is in each of them is worked out up front.
+    struct Ancestor
+    {
+        xcb_window_t window;
+        const FakeWindow* pWindow;
+        int x;
+        int y;
+    };
+    vector<Ancestor> ancestors;
+    int x = area.x;
+    int y = area.y;
+    for(const FakeWindow* pAncestor = FindWindow(window); pAncestor != nullptr; pAncestor = FindWindow(window))
+    {
+        ancestors.push_back({ window, pAncestor, x, y });
+        x += pAncestor->x + pAncestor->borderWidth;
+        y += pAncestor->y + pAncestor->borderWidth;
+        window = pAncestor->parent;
+    }
+
+    for(auto& damage : m_Damages)
+    {
+        FakeDamage& fakeDamage = damage.second;
+        if(true == fakeDamage.reported && false == fakeDamage.areas)
+        {
+            continue;
+        }
+
+        const Ancestor* pAncestor = nullptr;
+        for(const Ancestor& ancestor : ancestors)
+        {
+            if(ancestor.window == fakeDamage.window)
+            {
+                pAncestor = &ancestor;
+                break;
+            }
+        }
+        if(pAncestor == nullptr)
+        {
+            continue;
+        }
+
+        // clipped to the damaged window
+        int left = max(pAncestor->x, 0);
+        int top = max(pAncestor->y, 0);
+        int right = min(pAncestor->x + (int)area.width, (int)pAncestor->pWindow->width);
+        int bottom = min(pAncestor->y + (int)area.height, (int)pAncestor->pWindow->height);
+        if(right <= left || bottom <= top)
+        {
+            continue;
+        }
+        if(true == fakeDamage.reported)
+        {
+            int boxRight = fakeDamage.box.x + fakeDamage.box.width;
+            int boxBottom = fakeDamage.box.y + fakeDamage.box.height;
+            if(left >= fakeDamage.box.x && top >= fakeDamage.box.y && right <= boxRight && bottom <= boxBottom)
+            {
+                continue;
+            }
+            left = min(left, (int)fakeDamage.box.x);
+            top = min(top, (int)fakeDamage.box.y);
+            right = max(right, boxRight);
+            bottom = max(bottom, boxBottom);
+        }
+        fakeDamage.box = { (int16_t)left, (int16_t)top, (uint16_t)(right - left), (uint16_t)(bottom - top) };
+        fakeDamage.reported = true;
+
+        // DamageNotify: level, drawable, damage, time, area, geometry
+        uint8_t event[32] = {};
+        event[0] = FAKE_DAMAGE_FIRST_EVENT + FAKE_DAMAGE_NOTIFY;
+        memcpy(event + 4, &fakeDamage.window, sizeof(xcb_window_t));
+        memcpy(event + 8, &damage.first, sizeof(uint32_t));
+        memcpy(event + 16, &fakeDamage.box, sizeof(xcb_rectangle_t));
+        QueueEvent(event);
+    }
+}
+
+void FakeXServer::ClientDestroyWindow(xcb_window_t window)
+{
+    if(FindWindow(window) != nullptr)
+    {
+        DoDestroy(window);
+    }
+}
+
+void FakeXServer::ClientSetProperty(xcb_window_t window, xcb_atom_t property, const vector<uint32_t>& values)
+{
+    FakeWindow* pWindow = FindWindow(window);
+    if(pWindow != nullptr)
+    {
+        pWindow->properties[property] = values;
+    }
+}
+
+void FakeXServer::ClientSetStringProperty(xcb_window_t window, xcb_atom_t property, const string& value)
+{
+    FakeWindow* pWindow = FindWindow(window);
+    if(pWindow != nullptr)
+    {
+        pWindow->stringProperties[property] = value;
+    }
+}
+
+//--------------------------------------------------------------------------------
+// the user
+//--------------------------------------------------------------------------------
+
+void FakeXServer::PointerPress(int16_t rootX, int16_t rootY, uint8_t button, uint16_t state)
+{
+    if(true == m_PointerFrozen)
+    {
+        m_HeldPointerEvents.push_back({ XCB_BUTTON_PRESS, rootX, rootY, button, state });
+        return;
+    }
+
+    if(m_PointerGrabWindow == XCB_WINDOW_NONE)
+    {
+        // look for a passive grab, starting from the root and working down to the
+        // window under the pointer
+        vector<xcb_window_t> ancestors;
+        for(xcb_window_t window = FindWindowAt(rootX, rootY); window != XCB_WINDOW_NONE; window = FindWindow(window)->parent)
+        {
+            ancestors.push_back(window);
+        }
+
+        for(auto it = ancestors.rbegin(); it != ancestors.rend() && m_PointerGrabWindow == XCB_WINDOW_NONE; ++it)
+        {
+            for(const ButtonGrab& grab : FindWindow(*it)->buttonGrabs)
+            {
+                if((grab.button == XCB_BUTTON_INDEX_ANY || grab.button == button) &&
+                    (grab.modifiers == XCB_MOD_MASK_ANY || grab.modifiers == (state & 0xff)))
+                {
+                    m_PointerGrabWindow = *it;
+                    m_PointerGrabMask = grab.eventMask;
+                    m_PointerFrozen = (grab.pointerMode == XCB_GRAB_MODE_SYNC);
+                    break;
+                }
+            }
+        }
+
+        // otherwise the first window that asked for presses gets an implicit grab
+        for(auto it = ancestors.begin(); it != ancestors.end() && m_PointerGrabWindow == XCB_WINDOW_NONE; ++it)
+        {
+            uint32_t eventMask = FindWindow(*it)->eventMask;
+            if((eventMask & XCB_EVENT_MASK_BUTTON_PRESS) != 0)
+            {
+                m_PointerGrabWindow = *it;
+                m_PointerGrabMask = eventMask;
+            }
+        }
+
+        if(m_PointerGrabWindow == XCB_WINDOW_NONE)
+        {
+            return;
+        }
+    }
+
+    m_PressX = rootX;
+    m_PressY = rootY;
+    QueueButtonEvent(XCB_BUTTON_PRESS, m_PointerGrabWindow, FindChildAt(m_PointerGrabWindow, rootX, rootY), rootX, rootY, button, state);
+}
+
+void FakeXServer::PointerMotion(int16_t rootX, int16_t rootY, uint16_t state)
+{
+    if(true == m_PointerFrozen)
+    {
+        m_HeldPointerEvents.push_back({ XCB_MOTION_NOTIFY, rootX, rootY, 0, state });
+        return;
+    }
+
+    // nobody uses the child of a motion event, and finding it is a walk down the tree
+    const uint16_t motionMask = XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_BUTTON_MOTION | XCB_EVENT_MASK_BUTTON_1_MOTION;
+    if(m_PointerGrabWindow != XCB_WINDOW_NONE && (m_PointerGrabMask & motionMask) != 0)
+    {
+        QueueButtonEvent(XCB_MOTION_NOTIFY, m_PointerGrabWindow, XCB_WINDOW_NONE, rootX, rootY, XCB_MOTION_NORMAL, state);
+    }
+}
+
+void FakeXServer::PointerRelease(int16_t rootX, int16_t rootY, uint8_t button, uint16_t state)
+{
+    if(true == m_PointerFrozen)
+    {
+        m_HeldPointerEvents.push_back({ XCB_BUTTON_RELEASE, rootX, rootY, button, state });
+        return;
+    }
+
+    if(m_PointerGrabWindow == XCB_WINDOW_NONE)
+    {
+        return;
+    }
+
+    if((m_PointerGrabMask & XCB_EVENT_MASK_BUTTON_RELEASE) != 0)
+    {
+        QueueButtonEvent(XCB_BUTTON_RELEASE, m_PointerGrabWindow, FindChildAt(m_PointerGrabWindow, rootX, rootY), rootX, rootY, button, state);
+    }
+    m_PointerGrabWindow = XCB_WINDOW_NONE;
+    m_PointerGrabMask = 0;
+}
+
+void FakeXServer::KeyPress(xcb_keycode_t key, uint16_t state)
+{
+    m_ModifierState = (state | KeySymbols::GetKeysymModifierMask(GetKeysym(key))) & 0xff;
+    if(m_KeyboardGrabWindow != XCB_WINDOW_NONE)
+    {
+        QueueButtonEvent(XCB_KEY_PRESS, m_KeyboardGrabWindow, XCB_WINDOW_NONE, 0, 0, key, state);
+        return;
+    }
+
+    vector<xcb_window_t> ancestors;
+    for(xcb_window_t window = m_Focus; window != XCB_WINDOW_NONE; window = FindWindow(window)->parent)
+    {
+        ancestors.push_back(window);
+    }
+
+    for(auto it = ancestors.rbegin(); it != ancestors.rend(); ++it)
+    {
+        for(const KeyGrab& grab : FindWindow(*it)->keyGrabs)
+        {
+            if((grab.key == XCB_GRAB_ANY || grab.key == key) &&
+                (grab.modifiers == XCB_MOD_MASK_ANY || grab.modifiers == (state & 0xff)))
+            {
+                // button and key events share a layout, the pointer position isn't tracked
+                QueueButtonEvent(XCB_KEY_PRESS, *it, XCB_WINDOW_NONE, 0, 0, key, state);
+                return;
+            }
+        }
+    }
+}
+
+void FakeXServer::KeyRelease(xcb_keycode_t key, uint16_t state)
+{
+    m_ModifierState = state & ~KeySymbols::GetKeysymModifierMask(GetKeysym(key)) & 0xff;
+    if(m_KeyboardGrabWindow != XCB_WINDOW_NONE)
+    {
+        QueueButtonEvent(XCB_KEY_RELEASE, m_KeyboardGrabWindow, XCB_WINDOW_NONE, 0, 0, key, state);
+    }
+}
+
+xcb_keysym_t FakeXServer::GetKeysym(xcb_keycode_t key) const
+{
+    return (key < FAKE_MIN_KEYCODE) ? XCB_NO_SYMBOL : m_Keysyms[key - FAKE_MIN_KEYCODE];
+}
+
+void FakeXServer::RemapKey(xcb_keycode_t key, xcb_keysym_t keysym)
+{
+    if(key < FAKE_MIN_KEYCODE)
+    {
+        return;
+    }
+    m_Keysyms[key - FAKE_MIN_KEYCODE] = keysym;
+
+    xcb_mapping_notify_event_t mappingNotify = {};
+    mappingNotify.response_type = XCB_MAPPING_NOTIFY;
+    mappingNotify.request = XCB_MAPPING_KEYBOARD;
+    mappingNotify.first_keycode = key;
+    mappingNotify.count = 1;
+    QueueEvent(&mappingNotify);
+}
+
+//--------------------------------------------------------------------------------
+// inspection
+//--------------------------------------------------------------------------------
+
+bool FakeXServer::GetRootGeometry(xcb_window_t window, WindowGeometry& geometry) const
+{
+    const FakeWindow* pWindow = FindWindow(window);
+    if(pWindow == nullptr)
+    {
+        return false;
+    }
+
+    int x, y;
+    GetRootPosition(window, x, y);
+    geometry.x = x;
+    geometry.y = y;
+    geometry.width = pWindow->width;
+    geometry.height = pWindow->height;
+    geometry.borderWidth = pWindow->borderWidth;
+    return true;
+}
+
+xcb_window_t FakeXServer::GetParent(xcb_window_t window) const
+{
+    const FakeWindow* pWindow = FindWindow(window);
+    return (pWindow != nullptr) ? pWindow->parent : XCB_WINDOW_NONE;
+}
+
+bool FakeXServer::IsViewable(xcb_window_t window) const
+{
+    return IsViewable(FindWindow(window));
+}
+
+xcb_window_t FakeXServer::GetFocus() const
+{
+    return m_Focus;
+}
+
+size_t FakeXServer::GetWindowCount() const
+{
+    // not counting the root
+    return m_Windows.size() - 1;
+}
+
+size_t FakeXServer::GetPendingEventCount() const
+{
+    return m_Events.size();
+}
+
+uint64_t FakeXServer::GetRequestCount() const
+{
+    return m_Sequence;
+}
+
+//--------------------------------------------------------------------------------
+// connection
+//--------------------------------------------------------------------------------
+
+xcb_window_t FakeXServer::GetRootWindow() const
+{
+    return m_RootWindow;
+}
+
+int FakeXServer::GetFileDescriptor() const
+{
+    // nothing to wait on, everything happens as soon as it's asked for
+    return -1;
+}
+
+bool FakeXServer::HasError() const
+{
+    return false;
+}
+
+xcb_generic_event_t* FakeXServer::PollForEvent()
+{
+    if(true == m_Events.empty())
+    {
+        return nullptr;
+    }
+
+    // handed over the same way XCB does, the caller frees it
+    xcb_generic_event_t* pEvent = (xcb_generic_event_t*)malloc(sizeof(xcb_generic_event_t));
+    *pEvent = m_Events.front();
+    m_Events.pop_front();
+    return pEvent;
+}
+
+const char* FakeXServer::GetExtensionEventName(uint8_t eventType) const
+{
+    if(eventType == FAKE_SYNC_FIRST_EVENT + FAKE_SYNC_ALARM_NOTIFY)
+    {
+        return "SyncAlarmNotify";
+    }
+    if(eventType == FAKE_DAMAGE_FIRST_EVENT + FAKE_DAMAGE_NOTIFY)
+    {
+        return "DamageNotify";
+    }
+    return nullptr;
+}
+
+void FakeXServer::Flush()
+{
+}
+
+void FakeXServer::Sync()
+{
+    CountRoundTrip(NextRequest());
+}
+
+//--------------------------------------------------------------------------------
+// requests without replies
+//--------------------------------------------------------------------------------
+
+xcb_window_t FakeXServer::CreateWindow(
+    xcb_window_t parent,
+    int16_t x,
+    int16_t y,
+    uint16_t width,
+    uint16_t height,
+    uint32_t valueMask,
+    const uint32_t* pValues)
+{
+    NextRequest();
+    xcb_window_t window = m_NextManagerWindow++;
+    if(FindWindowOrError(parent, XCB_CREATE_WINDOW) != nullptr)
+    {
+        AddWindow(window, parent, x, y, width, height, valueMask, pValues);
+    }
+    return window;
+}
+
+void FakeXServer::DestroyWindow(xcb_window_t window)
+{
+    NextRequest();
+    if(FindWindowOrError(window, XCB_DESTROY_WINDOW) != nullptr)
+    {
+        DoDestroy(window);
+    }
+}
+
+void FakeXServer::ChangeWindowAttributes(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_CHANGE_WINDOW_ATTRIBUTES);
+    if(pWindow != nullptr)
+    {
+        ApplyAttributes(*pWindow, valueMask, pValues);
+    }
+}
+
+void FakeXServer::ConfigureWindow(xcb_window_t window, uint16_t valueMask, const xcb_configure_window_value_list_t& values)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_CONFIGURE_WINDOW);
+    if(pWindow != nullptr)
+    {
+        ApplyConfigure(window, *pWindow, valueMask, values);
+    }
+}
+
+void FakeXServer::MapWindow(xcb_window_t window)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_MAP_WINDOW);
+    if(pWindow != nullptr)
+    {
+        DoMap(window, *pWindow);
+    }
+}
+
+void FakeXServer::UnmapWindow(xcb_window_t window)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_UNMAP_WINDOW);
+    if(pWindow != nullptr)
+    {
+        DoUnmap(window, *pWindow);
+    }
+}
+
+void FakeXServer::ReparentWindow(xcb_window_t window, xcb_window_t parent, int16_t x, int16_t y)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_REPARENT_WINDOW);
+    FakeWindow* pNewParent = FindWindowOrError(parent, XCB_REPARENT_WINDOW);
+    if(pWindow == nullptr || pNewParent == nullptr)
+    {
+        return;
+    }
+
+    // a mapped window is unmapped first, and mapped again afterwards
+    bool wasMapped = pWindow->mapped;
+    DoUnmap(window, *pWindow);
+
+    xcb_window_t oldParent = pWindow->parent;
+    FakeWindow* pOldParent = FindWindow(oldParent);
+    pOldParent->children.erase(find(pOldParent->children.begin(), pOldParent->children.end(), window));
+    pNewParent->children.push_back(window);
+    pWindow->parent = parent;
+    pWindow->x = x;
+    pWindow->y = y;
+
+    xcb_reparent_notify_event_t reparentNotify = {};
+    reparentNotify.response_type = XCB_REPARENT_NOTIFY;
+    reparentNotify.window = window;
+    reparentNotify.parent = parent;
+    reparentNotify.x = x;
+    reparentNotify.y = y;
+    reparentNotify.override_redirect = pWindow->overrideRedirect;
+    QueueStructureEvent(window, &reparentNotify, &reparentNotify.event);
+
+    // the old parent hears about it as well
+    if((pOldParent->eventMask & XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) != 0)
+    {
+        reparentNotify.event = oldParent;
+        QueueEvent(&reparentNotify);
+    }
+
+    if(true == wasMapped)
+    {
+        DoMap(window, *pWindow);
+    }
+}
+
+void FakeXServer::ChangeSaveSet(uint8_t mode, xcb_window_t window)
+{
+    // the window manager's connection never closes, so the save set has nothing to do
+    NextRequest();
+    FindWindowOrError(window, XCB_CHANGE_SAVE_SET);
+}
+
+void FakeXServer::SetInputFocus(xcb_window_t window)
+{
+    NextRequest();
+    if(FindWindowOrError(window, XCB_SET_INPUT_FOCUS) != nullptr)
+    {
+        m_Focus = window;
+    }
+}
+
+void FakeXServer::GrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_GRAB_KEY);
+    if(pWindow != nullptr)
+    {
+        pWindow->keyGrabs.push_back({ key, modifiers });
+    }
+}
+
+void FakeXServer::UngrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_UNGRAB_KEY);
+    if(pWindow != nullptr)
+    {
+        vector<KeyGrab>& grabs = pWindow->keyGrabs;
+        grabs.erase(
+            remove_if(grabs.begin(), grabs.end(), [&](const KeyGrab& grab)
+            {
+                return (key == XCB_GRAB_ANY || grab.key == key) &&
+                    (modifiers == XCB_MOD_MASK_ANY || grab.modifiers == modifiers);
+            }),
+            grabs.end());
+    }
+}
+
+void FakeXServer::GrabButton(xcb_window_t window, uint16_t eventMask, uint8_t button, uint16_t modifiers, uint8_t pointerMode)
+{
+    NextRequest();
+    FakeWindow* pWindow = FindWindowOrError(window, XCB_GRAB_BUTTON);
+    if(pWindow != nullptr)
+    {
+        pWindow->buttonGrabs.push_back({ button, modifiers, eventMask, pointerMode });
+    }
+}
+
+void FakeXServer::AllowEvents(uint8_t mode, xcb_timestamp_t /*time*/)
+{
+    NextRequest();
+    if(false == m_PointerFrozen)
+    {
+        return;
+    }
+    m_PointerFrozen = false;
+
+    // a replayed press goes on to the window under the pointer. Its client is taken to
+    // want it, so the grab is theirs and we hear nothing more of this click.
+    if(mode == XCB_ALLOW_REPLAY_POINTER)
+    {
+        m_PointerGrabWindow = FindWindowAt(m_PressX, m_PressY);
+        m_PointerGrabMask = 0;
+    }
+
+    vector<HeldPointerEvent> held;
+    held.swap(m_HeldPointerEvents);
+    for(const HeldPointerEvent& event : held)
+    {
+        switch(event.responseType)
+        {
+        case XCB_BUTTON_PRESS:
+            PointerPress(event.rootX, event.rootY, event.button, event.state);
+            break;
+        case XCB_MOTION_NOTIFY:
+            PointerMotion(event.rootX, event.rootY, event.state);
+            break;
+        case XCB_BUTTON_RELEASE:
+            PointerRelease(event.rootX, event.rootY, event.button, event.state);
+            break;
+        }
+    }
+}
+
+void FakeXServer::UngrabKeyboard()
+{
+    NextRequest();
+    m_KeyboardGrabWindow = XCB_WINDOW_NONE;
+}
+
+void FakeXServer::GrabServer()
+{
+    NextRequest();
+}
+
+void FakeXServer::UngrabServer()
+{
+    NextRequest();
+}
+
+void FakeXServer::SendEvent(xcb_window_t window, uint32_t eventMask, const void* pEvent)
+{
+    // client messages are kept for the client to pick up, anything else has nobody to
+    // receive it
+    NextRequest();
+    if(FindWindowOrError(window, XCB_SEND_EVENT) != nullptr
+        && (((const xcb_generic_event_t*)pEvent)->response_type & ~0x80) == XCB_CLIENT_MESSAGE)
+    {
+        m_ClientMessages[window].push_back(*(const xcb_client_message_event_t*)pEvent);
+    }
+}
+
+void FakeXServer::KillClient(xcb_window_t window)
+{
+    // every client owns a single window
+    NextRequest();
+    if(FindWindowOrError(window, XCB_KILL_CLIENT) != nullptr)
+    {
+        DoDestroy(window);
+    }
+}
+
+//--------------------------------------------------------------------------------
+// requests with replies
+//--------------------------------------------------------------------------------
+
+xcb_void_cookie_t FakeXServer::RequestChangeWindowAttributesChecked(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues)
+{
+    // checked, so an error goes in the reply rather than the event queue
+    unsigned int sequence = NextRequest();
+    PendingReply& reply = m_PendingReplies[sequence];
+    if(FindWindow(window) == nullptr)
+    {
+        reply.errorCode = XCB_WINDOW;
+    }
+    else
+    {
+        reply.errorCode = 0;
+        ApplyAttributes(*FindWindow(window), valueMask, pValues);
+    }
+    return { sequence };
+}
+
+uint8_t FakeXServer::ReceiveErrorCode(xcb_void_cookie_t cookie)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return 0;
+    }
+
+    uint8_t errorCode = it->second.errorCode;
+    m_PendingReplies.erase(it);
+    return errorCode;
+}
+
+xcb_intern_atom_cookie_t FakeXServer::RequestAtom(const string& name)
+{
+    unsigned int sequence = NextRequest();
+    m_PendingReplies[sequence].atom = InternAtom(name);
+    return { sequence };
+}
+
+xcb_atom_t FakeXServer::ReceiveAtom(xcb_intern_atom_cookie_t cookie)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return XCB_ATOM_NONE;
+    }
+
+    xcb_atom_t atom = it->second.atom;
+    m_PendingReplies.erase(it);
+    return atom;
+}
+
+xcb_get_geometry_cookie_t FakeXServer::RequestGeometry(xcb_window_t window)
+{
+    unsigned int sequence = NextRequest();
+    PendingReply& reply = m_PendingReplies[sequence];
+    const FakeWindow* pWindow = FindWindow(window);
+    reply.success = (pWindow != nullptr);
+    if(true == reply.success)
+    {
+        reply.geometry.x = pWindow->x;
+        reply.geometry.y = pWindow->y;
+        reply.geometry.width = pWindow->width;
+        reply.geometry.height = pWindow->height;
+        reply.geometry.borderWidth = pWindow->borderWidth;
+    }
+    return { sequence };
+}
+
+bool FakeXServer::ReceiveGeometry(xcb_get_geometry_cookie_t cookie, WindowGeometry& geometry)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+
+    bool success = it->second.success;
+    geometry = it->second.geometry;
+    m_PendingReplies.erase(it);
+    return success;
+}
+
+xcb_get_window_attributes_cookie_t FakeXServer::RequestAttributes(xcb_window_t window)
+{
+    unsigned int sequence = NextRequest();
+    PendingReply& reply = m_PendingReplies[sequence];
+    const FakeWindow* pWindow = FindWindow(window);
+    reply.success = (pWindow != nullptr);
+    if(true == reply.success)
+    {
+        reply.attributes.overrideRedirect = pWindow->overrideRedirect;
+        if(true == IsViewable(pWindow))
+        {
+            reply.attributes.mapState = XCB_MAP_STATE_VIEWABLE;
+        }
+        else
+        {
+            reply.attributes.mapState = pWindow->mapped ? XCB_MAP_STATE_UNVIEWABLE : XCB_MAP_STATE_UNMAPPED;
+        }
+    }
+    return { sequence };
+}
+
+bool FakeXServer::ReceiveAttributes(xcb_get_window_attributes_cookie_t cookie, WindowAttributes& attributes)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+
+    bool success = it->second.success;
+    attributes = it->second.attributes;
+    m_PendingReplies.erase(it);
+    return success;
+}
+
+xcb_query_tree_cookie_t FakeXServer::RequestChildren(xcb_window_t window)
+{
+    unsigned int sequence = NextRequest();
+    PendingReply& reply = m_PendingReplies[sequence];
+    const FakeWindow* pWindow = FindWindow(window);
+    reply.success = (pWindow != nullptr);
+    if(true == reply.success)
+    {
+        reply.values.assign(pWindow->children.begin(), pWindow->children.end());
+    }
+    return { sequence };
+}
+
+bool FakeXServer::ReceiveChildren(xcb_query_tree_cookie_t cookie, vector<xcb_window_t>& children)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+
+    bool success = it->second.success;
+    children.assign(it->second.values.begin(), it->second.values.end());
+    m_PendingReplies.erase(it);
+    return success;
+}
+
+xcb_get_property_cookie_t FakeXServer::RequestProperty(xcb_window_t window, xcb_atom_t property, xcb_atom_t type)
+{
+    // properties don't keep their type, only whether they're strings or 32-bit values
+    unsigned int sequence = NextRequest();
+    PendingReply& reply = m_PendingReplies[sequence];
+    const FakeWindow* pWindow = FindWindow(window);
+    reply.success = (pWindow != nullptr);
+    if(true == reply.success)
+    {
+        auto propertyIt = pWindow->properties.find(property);
+        if(propertyIt != pWindow->properties.end())
+        {
+            reply.values = propertyIt->second;
+        }
+        auto stringPropertyIt = pWindow->stringProperties.find(property);
+        if(stringPropertyIt != pWindow->stringProperties.end())
+        {
+            reply.text = stringPropertyIt->second;
+        }
+    }
+    return { sequence };
+}
+
+bool FakeXServer::ReceiveProperty(xcb_get_property_cookie_t cookie, vector<uint32_t>& values)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+
+    bool success = it->second.success;
+    values.swap(it->second.values);
+    m_PendingReplies.erase(it);
+    return success;
+}
+
+bool FakeXServer::ReceiveStringProperty(xcb_get_property_cookie_t cookie, string& value)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+
+    bool success = it->second.success;
+    value.swap(it->second.text);
+    m_PendingReplies.erase(it);
+    return success;
+}
+
+xcb_get_keyboard_mapping_cookie_t FakeXServer::RequestKeyboardMapping()
+{
+    unsigned int sequence = NextRequest();
+    m_PendingReplies[sequence].success = true;
+    return { sequence };
+}
+
+bool FakeXServer::ReceiveKeyboardMapping(
+    xcb_get_keyboard_mapping_cookie_t cookie,
+    xcb_keycode_t& minKeycode,
+    uint8_t& keysymsPerKeycode,
+    vector<xcb_keysym_t>& keysyms)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+    m_PendingReplies.erase(it);
+
+    minKeycode = FAKE_MIN_KEYCODE;
+    keysymsPerKeycode = 1;
+    keysyms = m_Keysyms;
+    return true;
+}
+
+xcb_grab_keyboard_cookie_t FakeXServer::RequestKeyboardGrab(xcb_window_t window)
+{
+    // nobody else is ever holding the keyboard
+    unsigned int sequence = NextRequest();
+    PendingReply& reply = m_PendingReplies[sequence];
+    if(FindWindow(window) == nullptr)
+    {
+        reply.grabStatus = XCB_GRAB_STATUS_NOT_VIEWABLE;
+    }
+    else
+    {
+        reply.grabStatus = XCB_GRAB_STATUS_SUCCESS;
+        m_KeyboardGrabWindow = window;
+    }
+    return { sequence };
+}
+
+uint8_t FakeXServer::ReceiveKeyboardGrab(xcb_grab_keyboard_cookie_t cookie)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return XCB_GRAB_STATUS_NOT_VIEWABLE;
+    }
+
+    uint8_t status = it->second.grabStatus;
+    m_PendingReplies.erase(it);
+    return status;
+}
+
+xcb_query_pointer_cookie_t FakeXServer::RequestPointerState(xcb_window_t window)
+{
+    unsigned int sequence = NextRequest();
+    PendingReply& reply = m_PendingReplies[sequence];
+    reply.success = (FindWindow(window) != nullptr);
+    reply.state = m_ModifierState;
+    return { sequence };
+}
+
+bool FakeXServer::ReceivePointerState(xcb_query_pointer_cookie_t cookie, uint16_t& state)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+
+    bool success = it->second.success;
+    state = it->second.state;
+    m_PendingReplies.erase(it);
+    return success;
+}
+
+Emperor::XBackend::ExtensionCookie FakeXServer::RequestRefreshRate()
+{
+    unsigned int sequence = NextRequest();
+    m_PendingReplies[sequence].success = true;
+    return { sequence };
+}
+
+unsigned int FakeXServer::ReceiveRefreshRate(ExtensionCookie cookie)
+{
+    CountRoundTrip(cookie.sequence);
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return 0;
+    }
+    m_PendingReplies.erase(it);
+    return FAKE_REFRESH_RATE;
+}
+
+Emperor::XBackend::ExtensionCookie FakeXServer::RequestMonitors()
+{
+    unsigned int sequence = NextRequest();
+    m_PendingReplies[sequence].success = true;
+    return { sequence };
+}
+
+bool FakeXServer::ReceiveMonitors(ExtensionCookie cookie, vector<xcb_rectangle_t>& monitors)
+{
+    CountRoundTrip(cookie.sequence);
+    monitors.clear();
+    auto it = m_PendingReplies.find(cookie.sequence);
+    if(it == m_PendingReplies.end())
+    {
+        return false;
+    }
+    m_PendingReplies.erase(it);
+
+    // a single monitor covering the screen
+    monitors.push_back({ 0, 0, m_ScreenWidth, m_ScreenHeight });
+    return true;
+}
+
+uint32_t FakeXServer::CreateCounterAlarm(uint32_t counter, int64_t value)
+{
+    NextRequest();
+    if(m_Counters.find(counter) == m_Counters.end())
+    {
+        QueueError(XCB_VALUE, FAKE_SYNC_FIRST_EVENT, counter);
+        return 0;
+    }
+
+    uint32_t alarm = m_NextManagerWindow++;
+    FakeAlarm& fakeAlarm = m_Alarms[alarm];
+    fakeAlarm.counter = counter;
+    fakeAlarm.value = value;
+    fakeAlarm.active = true;
+    CheckAlarm(alarm, fakeAlarm);
+    return alarm;
+}
+
+void FakeXServer::ChangeCounterAlarm(uint32_t alarm, int64_t value)
+{
+    NextRequest();
+    auto it = m_Alarms.find(alarm);
+    if(it != m_Alarms.end())
+    {
+        it->second.value = value;
+        it->second.active = true;
+        CheckAlarm(alarm, it->second);
+    }
+}
+
+void FakeXServer::DestroyCounterAlarm(uint32_t alarm)
+{
+    NextRequest();
+    m_Alarms.erase(alarm);
+}
+
+bool FakeXServer::IsCounterAlarmEvent(const xcb_generic_event_t* pEvent, uint32_t& alarm) const
+{
+    if((pEvent->response_type & ~0x80) != FAKE_SYNC_FIRST_EVENT + FAKE_SYNC_ALARM_NOTIFY)
+    {
+        return false;
+    }
+    memcpy(&alarm, (const uint8_t*)pEvent + 4, sizeof(alarm));
+    return true;
+}
+
+//--------------------------------------------------------------------------------
+// Composite, Render & Damage
+//--------------------------------------------------------------------------------
+
+bool FakeXServer::InitialiseThumbnails()
+{
+    NextRequest();
+    return true;
+}
+
+void FakeXServer::RedirectWindow(xcb_window_t window)
+{
+    // nothing is drawn, so there are no contents to keep. Pictures are only ids.
+    NextRequest();
+    FindWindowOrError(window, FAKE_COMPOSITE_MAJOR_OPCODE);
+}
+
+void FakeXServer::UnredirectWindow(xcb_window_t window)
+{
+    NextRequest();
+    FindWindowOrError(window, FAKE_COMPOSITE_MAJOR_OPCODE);
+}
+
+uint32_t FakeXServer::CreateContentsPicture(xcb_window_t window)
+{
+    // name the pixmap, make the picture, free the pixmap
+    NextRequest();
+    NextRequest();
+    NextRequest();
+    if(FindWindowOrError(window, FAKE_COMPOSITE_MAJOR_OPCODE) == nullptr)
+    {
+        return 0;
+    }
+    return m_NextManagerWindow++;
+}
+
+uint32_t FakeXServer::CreateWindowPicture(xcb_window_t window)
+{
+    NextRequest();
+    if(FindWindowOrError(window, FAKE_RENDER_MAJOR_OPCODE) == nullptr)
+    {
+        return 0;
+    }
+    return m_NextManagerWindow++;
+}
+
+uint32_t FakeXServer::CreateBufferPicture(xcb_window_t window, uint16_t width, uint16_t height)
+{
+    // make the pixmap, make the picture, free the pixmap
+    NextRequest();
+    NextRequest();
+    NextRequest();
+    if(FindWindowOrError(window, XCB_CREATE_PIXMAP) == nullptr)
+    {
+        return 0;
+    }
+    return m_NextManagerWindow++;
+}
+
+void FakeXServer::FreePicture(uint32_t picture)
+{
+    NextRequest();
+}
+
+void FakeXServer::SetPictureScale(uint32_t picture, uint32_t numerator, uint32_t denominator)
+{
+    // the transform and the filter
+    NextRequest();
+    NextRequest();
+}
+
+void FakeXServer::CompositePicture(
+    uint32_t source,
+    uint32_t destination,
+    int16_t sourceX,
+    int16_t sourceY,
+    int16_t x,
+    int16_t y,
+    uint16_t width,
+    uint16_t height)
+{
+    NextRequest();
+}
+
+void FakeXServer::FillRectangle(uint32_t picture, uint32_t colour, const xcb_rectangle_t& rectangle)
+{
+    NextRequest();
+}
+
+uint32_t FakeXServer::CreateDamage(xcb_window_t window)
+{
+    NextRequest();
+    if(FindWindowOrError(window, FAKE_DAMAGE_MAJOR_OPCODE) == nullptr)
+    {
+        return 0;
+    }
+    uint32_t damage = m_NextManagerWindow++;
+    m_Damages[damage] = { window, false, false, {} };
+    return damage;
+}
+
+uint32_t FakeXServer::CreateAreaDamage(xcb_window_t window)
+{
+    uint32_t damage = CreateDamage(window);
+    auto it = m_Damages.find(damage);
+    if(it != m_Damages.end())
+    {
+        it->second.areas = true;
+    }
+    return damage;
+}
+
+void FakeXServer::SubtractDamage(uint32_t damage)
+{
+    NextRequest();
+    auto it = m_Damages.find(damage);
+    if(it != m_Damages.end())
+    {
+        it->second.reported = false;
+    }
+}
+
+void FakeXServer::DestroyDamage(uint32_t damage)
+{
+    NextRequest();
+    m_Damages.erase(damage);
+}
+
+bool FakeXServer::IsDamageEvent(const xcb_generic_event_t* pEvent, uint32_t& damage, xcb_rectangle_t& area) const
+{
+    if((pEvent->response_type & ~0x80) != FAKE_DAMAGE_FIRST_EVENT + FAKE_DAMAGE_NOTIFY)
+    {
+        return false;
+    }
+    memcpy(&damage, (const uint8_t*)pEvent + 8, sizeof(damage));
+    memcpy(&area, (const uint8_t*)pEvent + 16, sizeof(area));
+    return true;
+}
+
+xcb_window_t FakeXServer::StartCompositing()
+{
+    // the XFixes version, the redirection, the overlay (waited for), and the empty
+    // input shape
+    NextRequest();
+    NextRequest();
+    CountRoundTrip(NextRequest());
+    NextRequest();
+    NextRequest();
+    NextRequest();
+
+    // the overlay covers the screen, above all the root's children but not one of
+    // them, so it's never in a reply or an event
+    const FakeWindow* pRoot = FindWindow(m_RootWindow);
+    xcb_window_t overlay = m_NextManagerWindow++;
+    FakeWindow& fakeOverlay = m_Windows[overlay];
+    fakeOverlay.parent = m_RootWindow;
+    fakeOverlay.x = 0;
+    fakeOverlay.y = 0;
+    fakeOverlay.width = pRoot->width;
+    fakeOverlay.height = pRoot->height;
+    fakeOverlay.borderWidth = 0;
+    fakeOverlay.mapped = true;
+    fakeOverlay.overrideRedirect = true;
+    fakeOverlay.eventMask = 0;
+    return overlay;
+}
+
+//--------------------------------------------------------------------------------
+// the window tree
+//--------------------------------------------------------------------------------
+
+unsigned int FakeXServer::NextRequest()
+{
+    CountRequest(++m_Sequence);
+    return m_Sequence;
+}
+
+xcb_atom_t FakeXServer::InternAtom(const string& name)
+{
+    auto it = m_Atoms.find(name);
+    if(it == m_Atoms.end())
+    {
+        it = m_Atoms.emplace(name, FAKE_FIRST_ATOM + m_Atoms.size()).first;
+    }
+    return it->second;
+}
+
+void FakeXServer::CheckAlarm(uint32_t alarm, FakeAlarm& fakeAlarm)
+{
+    // only the positive comparison test the window manager uses. Once it has fired the
+    // alarm stays quiet until it's changed.
+    int64_t counterValue = m_Counters[fakeAlarm.counter];
+    if(false == fakeAlarm.active || counterValue < fakeAlarm.value)
+    {
+        return;
+    }
+    fakeAlarm.active = false;
+
+    // AlarmNotify: alarm, counter value and alarm value as 64-bit hi/lo pairs, time, state
+    uint8_t event[32] = {};
+    event[0] = FAKE_SYNC_FIRST_EVENT + FAKE_SYNC_ALARM_NOTIFY;
+    memcpy(event + 4, &alarm, sizeof(alarm));
+    int32_t high = (int32_t)(counterValue >> 32);
+    uint32_t low = (uint32_t)counterValue;
+    memcpy(event + 8, &high, sizeof(high));
+    memcpy(event + 12, &low, sizeof(low));
+    high = (int32_t)(fakeAlarm.value >> 32);
+    low = (uint32_t)fakeAlarm.value;
+    memcpy(event + 16, &high, sizeof(high));
+    memcpy(event + 20, &low, sizeof(low));
+    event[28] = 1; // XCB_SYNC_ALARMSTATE_INACTIVE
+    QueueEvent(event);
+}
+
+FakeXServer::FakeWindow* FakeXServer::FindWindow(xcb_window_t window)
+{
+    auto it = m_Windows.find(window);
+    return (it != m_Windows.end()) ? &it->second : nullptr;
+}
+
+const FakeXServer::FakeWindow* FakeXServer::FindWindow(xcb_window_t window) const
+{
+    auto it = m_Windows.find(window);
+    return (it != m_Windows.end()) ? &it->second : nullptr;
+}
+
+FakeXServer::FakeWindow* FakeXServer::FindWindowOrError(xcb_window_t window, uint8_t majorCode)
+{
+    FakeWindow* pWindow = FindWindow(window);
+    if(pWindow == nullptr)
+    {
+        QueueError(XCB_WINDOW, majorCode, window);
+    }
+    return pWindow;
+}
+
+bool FakeXServer::IsViewable(const FakeWindow* pWindow) const
+{
+    for(; pWindow != nullptr; pWindow = FindWindow(pWindow->parent))
+    {
+        if(false == pWindow->mapped)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FakeXServer::GetRootPosition(xcb_window_t window, int& x, int& y) const
+{
+    x = 0;
+    y = 0;
+    for(const FakeWindow* pWindow = FindWindow(window); pWindow != nullptr; pWindow = FindWindow(pWindow->parent))
+    {
+        x += pWindow->x + pWindow->borderWidth;
+        y += pWindow->y + pWindow->borderWidth;
+    }
+}
+
+xcb_window_t FakeXServer::FindWindowAt(int rootX, int rootY) const
+{
+    // descend through the topmost mapped child containing the point
+    xcb_window_t window = m_RootWindow;
+    int windowX = 0;
+    int windowY = 0;
+    bool descended = true;
+    while(true == descended)
+    {
+        descended = false;
+        const FakeWindow* pWindow = FindWindow(window);
+        for(auto it = pWindow->children.rbegin(); it != pWindow->children.rend(); ++it)
+        {
+            const FakeWindow* pChild = FindWindow(*it);
+            int childX = windowX + pChild->x;
+            int childY = windowY + pChild->y;
+            int outerWidth = pChild->width + 2 * pChild->borderWidth;
+            int outerHeight = pChild->height + 2 * pChild->borderWidth;
+            if(true == pChild->mapped &&
+                rootX >= childX && rootX < childX + outerWidth &&
+                rootY >= childY && rootY < childY + outerHeight)
+            {
+                window = *it;
+                windowX = childX + pChild->borderWidth;
+                windowY = childY + pChild->borderWidth;
+                descended = true;
+                break;
+            }
+        }
+    }
+    return window;
+}
+
+xcb_window_t FakeXServer::FindChildAt(xcb_window_t window, int rootX, int rootY) const
+{
+    // the child of the window that is, or holds, the window under the point
+    for(xcb_window_t child = FindWindowAt(rootX, rootY); child != XCB_WINDOW_NONE; )
+    {
+        xcb_window_t parent = FindWindow(child)->parent;
+        if(parent == window)
+        {
+            return child;
+        }
+        child = parent;
+    }
+    return XCB_WINDOW_NONE;
+}
+
+void FakeXServer::AddWindow(
+    xcb_window_t window,
+    xcb_window_t parent,
+    int16_t x,
+    int16_t y,
+    uint16_t width,
+    uint16_t height,
+    uint32_t valueMask,
+    const uint32_t* pValues)
+{
+    FakeWindow& fakeWindow = m_Windows[window];
+    fakeWindow.parent = parent;
+    fakeWindow.x = x;
+    fakeWindow.y = y;
+    fakeWindow.width = width;
+    fakeWindow.height = height;
+    fakeWindow.borderWidth = 0;
+    fakeWindow.mapped = false;
+    fakeWindow.overrideRedirect = false;
+    fakeWindow.eventMask = 0;
+    ApplyAttributes(fakeWindow, valueMask, pValues);
+
+    // new windows go on top of their siblings
+    FakeWindow* pParent = FindWindow(parent);
+    pParent->children.push_back(window);
+    if((pParent->eventMask & XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) != 0)
+    {
+        xcb_create_notify_event_t createNotify = {};
+        createNotify.response_type = XCB_CREATE_NOTIFY;
+        createNotify.parent = parent;
+        createNotify.window = window;
+        createNotify.x = x;
+        createNotify.y = y;
+        createNotify.width = width;
+        createNotify.height = height;
+        createNotify.override_redirect = fakeWindow.overrideRedirect;
+        QueueEvent(&createNotify);
+    }
+}
+
+void FakeXServer::ApplyAttributes(FakeWindow& fakeWindow, uint32_t valueMask, const uint32_t* pValues)
+{
+    // one value per bit set, in bit order. Only the attributes that change what the
+    // window manager sees are kept.
+    for(uint32_t bit = 1; bit != 0 && bit <= valueMask; bit <<= 1)
+    {
+        if((valueMask & bit) == 0)
+        {
+            continue;
+        }
+
+        uint32_t value = *pValues++;
+        if(bit == XCB_CW_OVERRIDE_REDIRECT)
+        {
+            fakeWindow.overrideRedirect = (value != 0);
+        }
+        else if(bit == XCB_CW_EVENT_MASK)
+        {
+            fakeWindow.eventMask = value;
+        }
+    }
+}
+
+void FakeXServer::ApplyConfigure(xcb_window_t window, FakeWindow& fakeWindow, uint16_t valueMask, const xcb_configure_window_value_list_t& values)
+{
+    if(valueMask & XCB_CONFIG_WINDOW_X)
+    {
+        fakeWindow.x = values.x;
+    }
+    if(valueMask & XCB_CONFIG_WINDOW_Y)
+    {
+        fakeWindow.y = values.y;
+    }
+    if(valueMask & XCB_CONFIG_WINDOW_WIDTH)
+    {
+        fakeWindow.width = values.width;
+    }
+    if(valueMask & XCB_CONFIG_WINDOW_HEIGHT)
+    {
+        fakeWindow.height = values.height;
+    }
+    if(valueMask & XCB_CONFIG_WINDOW_BORDER_WIDTH)
+    {
+        fakeWindow.borderWidth = values.border_width;
+    }
+
+    FakeWindow* pParent = FindWindow(fakeWindow.parent);
+    vector<xcb_window_t>& siblings = pParent->children;
+    if(valueMask & XCB_CONFIG_WINDOW_STACK_MODE)
+    {
+        siblings.erase(find(siblings.rbegin(), siblings.rend(), window).base() - 1);
+
+        // relative to the sibling if there is one, otherwise to all of them. Searched
+        // from the top as well, windows are usually restacked near the top.
+        auto siblingIt = siblings.end();
+        if(valueMask & XCB_CONFIG_WINDOW_SIBLING)
+        {
+            auto reverseIt = find(siblings.rbegin(), siblings.rend(), (xcb_window_t)values.sibling);
+            siblingIt = (reverseIt == siblings.rend()) ? siblings.end() : reverseIt.base() - 1;
+        }
+
+        if(siblingIt == siblings.end())
+        {
+            if(values.stack_mode == XCB_STACK_MODE_BELOW)
+            {
+                siblings.insert(siblings.begin(), window);
+            }
+            else
+            {
+                siblings.push_back(window);
+            }
+        }
+        else
+        {
+            siblings.insert((values.stack_mode == XCB_STACK_MODE_BELOW) ? siblingIt : siblingIt + 1, window);
+        }
+    }
+
+    // searched from the top, that's where the windows being moved around usually are
+    auto stackIt = find(siblings.rbegin(), siblings.rend(), window).base() - 1;
+    xcb_configure_notify_event_t configureNotify = {};
+    configureNotify.response_type = XCB_CONFIGURE_NOTIFY;
+    configureNotify.window = window;
+    configureNotify.above_sibling = (stackIt == siblings.begin()) ? XCB_WINDOW_NONE : *(stackIt - 1);
+    configureNotify.x = fakeWindow.x;
+    configureNotify.y = fakeWindow.y;
+    configureNotify.width = fakeWindow.width;
+    configureNotify.height = fakeWindow.height;
+    configureNotify.border_width = fakeWindow.borderWidth;
+    configureNotify.override_redirect = fakeWindow.overrideRedirect;
+    QueueStructureEvent(window, &configureNotify, &configureNotify.event);
+}
+
+void FakeXServer::DoMap(xcb_window_t window, FakeWindow& fakeWindow)
+{
+    if(true == fakeWindow.mapped)
+    {
+        return;
+    }
+    fakeWindow.mapped = true;
+
+    xcb_map_notify_event_t mapNotify = {};
+    mapNotify.response_type = XCB_MAP_NOTIFY;
+    mapNotify.window = window;
+    mapNotify.override_redirect = fakeWindow.overrideRedirect;
+    QueueStructureEvent(window, &mapNotify, &mapNotify.event);
+}
+
+void FakeXServer::DoUnmap(xcb_window_t window, FakeWindow& fakeWindow)
+{
+    if(false == fakeWindow.mapped)
+    {
+        return;
+    }
+    fakeWindow.mapped = false;
+
+    if(m_Focus == window)
+    {
+        m_Focus = m_RootWindow;
+    }
+
+    xcb_unmap_notify_event_t unmapNotify = {};
+    unmapNotify.response_type = XCB_UNMAP_NOTIFY;
+    unmapNotify.window = window;
+    unmapNotify.from_configure = 0;
+    QueueStructureEvent(window, &unmapNotify, &unmapNotify.event);
+}
+
+void FakeXServer::DoDestroy(xcb_window_t window)
+{
+    // unmapped first, then destroyed from the bottom of the tree upwards
+    DoUnmap(window, *FindWindow(window));
+
+    vector<xcb_window_t> children = FindWindow(window)->children;
+    for(xcb_window_t child : children)
+    {
+        DoDestroy(child);
+    }
+
+    xcb_destroy_notify_event_t destroyNotify = {};
+    destroyNotify.response_type = XCB_DESTROY_NOTIFY;
+    destroyNotify.window = window;
+    QueueStructureEvent(window, &destroyNotify, &destroyNotify.event);
+
+    FakeWindow* pParent = FindWindow(FindWindow(window)->parent);
+    pParent->children.erase(find(pParent->children.begin(), pParent->children.end(), window));
+    m_Windows.erase(window);
+    m_ClientMessages.erase(window);
+
+    // damage goes with its window
+    for(auto it = m_Damages.begin(); it != m_Damages.end();)
+    {
+        it = (it->second.window == window) ? m_Damages.erase(it) : next(it);
+    }
+
+    if(m_PointerGrabWindow == window)
+    {
+        m_PointerGrabWindow = XCB_WINDOW_NONE;
+        m_PointerGrabMask = 0;
+    }
+    if(m_KeyboardGrabWindow == window)
+    {
+        m_KeyboardGrabWindow = XCB_WINDOW_NONE;
+    }
+    if(m_Focus == window)
+    {
+        m_Focus = m_RootWindow;
+    }
+}
+
+//--------------------------------------------------------------------------------
+// events
+//--------------------------------------------------------------------------------
+
+void FakeXServer::QueueEvent(const void* pEvent)
+{
+    // every core event is 32 bytes on the wire, XCB adds the full sequence number after it
+    m_Events.emplace_back();
+    xcb_generic_event_t& event = m_Events.back();
+    memcpy(&event, pEvent, 32);
+    event.sequence = (uint16_t)m_Sequence;
+    event.full_sequence = m_Sequence;
+}
+
+void FakeXServer::QueueError(uint8_t errorCode, uint8_t majorCode, uint32_t resource)
+{
+    xcb_generic_error_t error = {};
+    error.response_type = 0;
+    error.error_code = errorCode;
+    error.resource_id = resource;
+    error.major_code = majorCode;
+    QueueEvent(&error);
+}
+
+void FakeXServer::QueueStructureEvent(xcb_window_t window, void* pEvent, xcb_window_t* pEventField)
+{
+    // delivered to the window itself, and to its parent
+    const FakeWindow* pWindow = FindWindow(window);
+    if((pWindow->eventMask & XCB_EVENT_MASK_STRUCTURE_NOTIFY) != 0)
+    {
+        *pEventField = window;
+        QueueEvent(pEvent);
+    }
+
+    const FakeWindow* pParent = FindWindow(pWindow->parent);
+    if(pParent != nullptr && (pParent->eventMask & XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) != 0)
+    {
+        *pEventField = pWindow->parent;
+        QueueEvent(pEvent);
+    }
+}
+
+void FakeXServer::QueueButtonEvent(uint8_t responseType, xcb_window_t window, xcb_window_t child, int16_t rootX, int16_t rootY, uint8_t detail, uint16_t state)
+{
+    int windowX, windowY;
+    GetRootPosition(window, windowX, windowY);
+
+    // button, key and motion events share a layout
+    xcb_button_press_event_t event = {};
+    event.response_type = responseType;
+    event.detail = detail;
+    event.time = (uint32_t)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    event.root = m_RootWindow;
+    event.event = window;
+    event.child = child;
+    event.root_x = rootX;
+    event.root_y = rootY;
+    event.event_x = rootX - windowX;
+    event.event_y = rootY - windowY;
+    event.state = state;
+    event.same_screen = 1;
+    QueueEvent(&event);
+}
@@ -0,0 +1,303 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef FAKEXSERVER_H_INCLUDED
+#define FAKEXSERVER_H_INCLUDED
+
+#include "XBackend.h"
+#include <xcb/xcb.h>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Pharaoh
+{
+    //! \brief  In-memory model of an X server, just detailed enough to drive the window
+    //!         manager without a display. It keeps the window tree, geometry, map state,
+    //!         event masks, passive grabs and properties, and generates the events the
+    //!         window manager would receive. The Client* and Pointer* functions play the
+    //!         part of applications and the user.
+    class FakeXServer : public Emperor::XBackend
+    {
+    public:
+        FakeXServer(uint16_t screenWidth = 1920, uint16_t screenHeight = 1080);
+        virtual ~FakeXServer();
+
+        // the client side
+        xcb_window_t ClientCreateWindow(int16_t x, int16_t y, uint16_t width, uint16_t height, bool overrideRedirect);
+        void ClientMapWindow(xcb_window_t window);
+        void ClientUnmapWindow(xcb_window_t window);
+        void ClientConfigureWindow(xcb_window_t window, uint16_t valueMask, const xcb_configure_window_value_list_t& values);
+        void ClientDestroyWindow(xcb_window_t window);
+        void ClientSetProperty(xcb_window_t window, xcb_atom_t property, const std::vector<uint32_t>& values);
+        void ClientSetStringProperty(xcb_window_t window, xcb_atom_t property, const std::string& value);
+        xcb_atom_t ClientInternAtom(const std::string& name);
+        //! \brief Take the oldest client message sent to a window, false if there are none.
+        bool ClientReceiveMessage(xcb_window_t window, xcb_client_message_event_t& message);
+        //! \brief XSync counters, for _NET_WM_SYNC_REQUEST. Setting one can fire alarms.
+        uint32_t ClientCreateCounter(int64_t value);
+        void ClientSetCounter(uint32_t counter, int64_t value);
+        //! \brief Draw in a window, which reports damage to it and the windows it's in.
+        void ClientDrawWindow(xcb_window_t window);
+        //! \brief Draw in part of a window, relative to the window.
+        void ClientDrawWindow(xcb_window_t window, const xcb_rectangle_t& area);
+
+        // the user
+        void PointerPress(int16_t rootX, int16_t rootY, uint8_t button, uint16_t state);
+        void PointerMotion(int16_t rootX, int16_t rootY, uint16_t state);
+        void PointerRelease(int16_t rootX, int16_t rootY, uint8_t button, uint16_t state);
+        void KeyPress(xcb_keycode_t key, uint16_t state);
+        //! \brief Only reported while the keyboard is grabbed, passive grabs stop at the press.
+        void KeyRelease(xcb_keycode_t key, uint16_t state);
+        //! \brief Change what a key produces, as xmodmap would. Everyone is sent a MappingNotify.
+        void RemapKey(xcb_keycode_t key, xcb_keysym_t keysym);
+
+        // inspection
+        bool GetRootGeometry(xcb_window_t window, WindowGeometry& geometry) const;
+        xcb_window_t GetParent(xcb_window_t window) const;
+        bool IsViewable(xcb_window_t window) const;
+        xcb_window_t GetFocus() const;
+        size_t GetWindowCount() const;
+        size_t GetPendingEventCount() const;
+        uint64_t GetRequestCount() const;
+
+        // XBackend
+        xcb_window_t GetRootWindow() const override;
+        int GetFileDescriptor() const override;
+        bool HasError() const override;
+        xcb_generic_event_t* PollForEvent() override;
+        const char* GetExtensionEventName(uint8_t eventType) const override;
+        void Flush() override;
+        void Sync() override;
+
+        xcb_window_t CreateWindow(
+            xcb_window_t parent,
+            int16_t x,
+            int16_t y,
+            uint16_t width,
+            uint16_t height,
+            uint32_t valueMask,
+            const uint32_t* pValues) override;
+        void DestroyWindow(xcb_window_t window) override;
+        void ChangeWindowAttributes(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues) override;
+        void ConfigureWindow(xcb_window_t window, uint16_t valueMask, const xcb_configure_window_value_list_t& values) override;
+        void MapWindow(xcb_window_t window) override;
+        void UnmapWindow(xcb_window_t window) override;
+        void ReparentWindow(xcb_window_t window, xcb_window_t parent, int16_t x, int16_t y) override;
+        void ChangeSaveSet(uint8_t mode, xcb_window_t window) override;
+        void SetInputFocus(xcb_window_t window) override;
+        void GrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key) override;
+        void UngrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key) override;
+        void GrabButton(xcb_window_t window, uint16_t eventMask, uint8_t button, uint16_t modifiers, uint8_t pointerMode) override;
+        void AllowEvents(uint8_t mode, xcb_timestamp_t time) override;
+        void UngrabKeyboard() override;
+        void GrabServer() override;
+        void UngrabServer() override;
+        void SendEvent(xcb_window_t window, uint32_t eventMask, const void* pEvent) override;
+        void KillClient(xcb_window_t window) override;
+
+        xcb_void_cookie_t RequestChangeWindowAttributesChecked(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues) override;
+        uint8_t ReceiveErrorCode(xcb_void_cookie_t cookie) override;
+        xcb_intern_atom_cookie_t RequestAtom(const std::string& name) override;
+        xcb_atom_t ReceiveAtom(xcb_intern_atom_cookie_t cookie) override;
+        xcb_get_geometry_cookie_t RequestGeometry(xcb_window_t window) override;
+        bool ReceiveGeometry(xcb_get_geometry_cookie_t cookie, WindowGeometry& geometry) override;
+        xcb_get_window_attributes_cookie_t RequestAttributes(xcb_window_t window) override;
+        bool ReceiveAttributes(xcb_get_window_attributes_cookie_t cookie, WindowAttributes& attributes) override;
+        xcb_query_tree_cookie_t RequestChildren(xcb_window_t window) override;
+        bool ReceiveChildren(xcb_query_tree_cookie_t cookie, std::vector<xcb_window_t>& children) override;
+        xcb_get_property_cookie_t RequestProperty(xcb_window_t window, xcb_atom_t property, xcb_atom_t type) override;
+        bool ReceiveProperty(xcb_get_property_cookie_t cookie, std::vector<uint32_t>& values) override;
+        bool ReceiveStringProperty(xcb_get_property_cookie_t cookie, std::string& value) override;
+        xcb_get_keyboard_mapping_cookie_t RequestKeyboardMapping() override;
+        bool ReceiveKeyboardMapping(
+            xcb_get_keyboard_mapping_cookie_t cookie,
+            xcb_keycode_t& minKeycode,
+            uint8_t& keysymsPerKeycode,
+            std::vector<xcb_keysym_t>& keysyms) override;
+        xcb_grab_keyboard_cookie_t RequestKeyboardGrab(xcb_window_t window) override;
+        uint8_t ReceiveKeyboardGrab(xcb_grab_keyboard_cookie_t cookie) override;
+        xcb_query_pointer_cookie_t RequestPointerState(xcb_window_t window) override;
+        bool ReceivePointerState(xcb_query_pointer_cookie_t cookie, uint16_t& state) override;
+        ExtensionCookie RequestRefreshRate() override;
+        unsigned int ReceiveRefreshRate(ExtensionCookie cookie) override;
+        ExtensionCookie RequestMonitors() override;
+        bool ReceiveMonitors(ExtensionCookie cookie, std::vector<xcb_rectangle_t>& monitors) override;
+        uint32_t CreateCounterAlarm(uint32_t counter, int64_t value) override;
+        void ChangeCounterAlarm(uint32_t alarm, int64_t value) override;
+        void DestroyCounterAlarm(uint32_t alarm) override;
+        bool IsCounterAlarmEvent(const xcb_generic_event_t* pEvent, uint32_t& alarm) const override;
+        bool InitialiseThumbnails() override;
+        void RedirectWindow(xcb_window_t window) override;
+        void UnredirectWindow(xcb_window_t window) override;
+        uint32_t CreateContentsPicture(xcb_window_t window) override;
+        uint32_t CreateWindowPicture(xcb_window_t window) override;
+        uint32_t CreateBufferPicture(xcb_window_t window, uint16_t width, uint16_t height) override;
+        void FreePicture(uint32_t picture) override;
+        void SetPictureScale(uint32_t picture, uint32_t numerator, uint32_t denominator) override;
+        void CompositePicture(
+            uint32_t source,
+            uint32_t destination,
+            int16_t sourceX,
+            int16_t sourceY,
+            int16_t x,
+            int16_t y,
+            uint16_t width,
+            uint16_t height) override;
+        void FillRectangle(uint32_t picture, uint32_t colour, const xcb_rectangle_t& rectangle) override;
+        uint32_t CreateDamage(xcb_window_t window) override;
+        uint32_t CreateAreaDamage(xcb_window_t window) override;
+        void SubtractDamage(uint32_t damage) override;
+        void DestroyDamage(uint32_t damage) override;
+        bool IsDamageEvent(const xcb_generic_event_t* pEvent, uint32_t& damage, xcb_rectangle_t& area) const override;
+        xcb_window_t StartCompositing() override;
+
+    private:
+        struct ButtonGrab
+        {
+            uint8_t button;
+            uint16_t modifiers;
+            uint16_t eventMask;
+            uint8_t pointerMode;
+        };
+
+        // what the user did with the pointer while it was frozen
+        struct HeldPointerEvent
+        {
+            uint8_t responseType;
+            int16_t rootX;
+            int16_t rootY;
+            uint8_t button;
+            uint16_t state;
+        };
+
+        struct KeyGrab
+        {
+            xcb_keycode_t key;
+            uint16_t modifiers;
+        };
+
+        struct FakeWindow
+        {
+            xcb_window_t parent;
+            std::vector<xcb_window_t> children; // bottom to top
+            int16_t x;
+            int16_t y;
+            uint16_t width;
+            uint16_t height;
+            uint16_t borderWidth;
+            bool mapped;
+            bool overrideRedirect;
+            uint32_t eventMask;
+            std::vector<ButtonGrab> buttonGrabs;
+            std::vector<KeyGrab> keyGrabs;
+            std::unordered_map<xcb_atom_t, std::vector<uint32_t>> properties;
+            std::unordered_map<xcb_atom_t, std::string> stringProperties;
+        };
+
+        // replies are worked out when the request is made, and held until asked for
+        struct PendingReply
+        {
+            bool success;
+            uint8_t errorCode;
+            uint8_t grabStatus;
+            uint16_t state;
+            xcb_atom_t atom;
+            WindowGeometry geometry;
+            WindowAttributes attributes;
+            std::vector<uint32_t> values;
+            std::string text;
+        };
+
+        struct FakeAlarm
+        {
+            uint32_t counter;
+            int64_t value;
+            bool active;
+        };
+
+        struct FakeDamage
+        {
+            xcb_window_t window;
+            bool reported;  // until it's subtracted
+            bool areas;     // reported again whenever the box grows
+            xcb_rectangle_t box;
+        };
+
+        unsigned int NextRequest();
+        xcb_atom_t InternAtom(const std::string& name);
+        void CheckAlarm(uint32_t alarm, FakeAlarm& fakeAlarm);
+        FakeWindow* FindWindow(xcb_window_t window);
+        const FakeWindow* FindWindow(xcb_window_t window) const;
+        FakeWindow* FindWindowOrError(xcb_window_t window, uint8_t majorCode);
+        bool IsViewable(const FakeWindow* pWindow) const;
+        void GetRootPosition(xcb_window_t window, int& x, int& y) const;
+        xcb_window_t FindWindowAt(int rootX, int rootY) const;
+        xcb_window_t FindChildAt(xcb_window_t window, int rootX, int rootY) const;
+        void AddWindow(
+            xcb_window_t window,
+            xcb_window_t parent,
+            int16_t x,
+            int16_t y,
+            uint16_t width,
+            uint16_t height,
+            uint32_t valueMask,
+            const uint32_t* pValues);
+        void ApplyAttributes(FakeWindow& fakeWindow, uint32_t valueMask, const uint32_t* pValues);
+        void ApplyConfigure(xcb_window_t window, FakeWindow& fakeWindow, uint16_t valueMask, const xcb_configure_window_value_list_t& values);
+        void DoMap(xcb_window_t window, FakeWindow& fakeWindow);
+        void DoUnmap(xcb_window_t window, FakeWindow& fakeWindow);
+        void DoDestroy(xcb_window_t window);
+
+        void QueueEvent(const void* pEvent);
+        void QueueError(uint8_t errorCode, uint8_t majorCode, uint32_t resource);
+        void QueueStructureEvent(xcb_window_t window, void* pEvent, xcb_window_t* pEventField);
+        xcb_keysym_t GetKeysym(xcb_keycode_t key) const;
+        void QueueButtonEvent(uint8_t responseType, xcb_window_t window, xcb_window_t child, int16_t rootX, int16_t rootY, uint8_t detail, uint16_t state);
+
+        uint16_t m_ScreenWidth;
+        uint16_t m_ScreenHeight;
+        xcb_window_t m_RootWindow;
+        xcb_window_t m_NextClientWindow;
+        xcb_window_t m_NextManagerWindow;
+        xcb_window_t m_Focus;
+        unsigned int m_Sequence = 0;
+
+        // the window holding the pointer grab started by a button press, if any
+        xcb_window_t m_PointerGrabWindow = XCB_WINDOW_NONE;
+        uint16_t m_PointerGrabMask = 0;
+
+        // a synchronous grab freezes the pointer at the press, and everything after it
+        // is held until AllowEvents
+        bool m_PointerFrozen = false;
+        int16_t m_PressX = 0;
+        int16_t m_PressY = 0;
+        std::vector<HeldPointerEvent> m_HeldPointerEvents;
+
+        // the window holding an active keyboard grab, if any
+        xcb_window_t m_KeyboardGrabWindow = XCB_WINDOW_NONE;
+
+        // the modifiers held down, from the keys pressed and let go
+        uint16_t m_ModifierState = 0;
+
+        std::unordered_map<xcb_window_t, FakeWindow> m_Windows;
+        std::unordered_map<std::string, xcb_atom_t> m_Atoms;
+        std::unordered_map<unsigned int, PendingReply> m_PendingReplies;
+        std::deque<xcb_generic_event_t> m_Events;
+        std::unordered_map<xcb_window_t, std::deque<xcb_client_message_event_t>> m_ClientMessages;
+        std::unordered_map<uint32_t, int64_t> m_Counters;
+        std::unordered_map<uint32_t, FakeAlarm> m_Alarms;
+        std::unordered_map<uint32_t, FakeDamage> m_Damages;
+
+        // one keysym per keycode, from the minimum keycode up
+        std::vector<xcb_keysym_t> m_Keysyms;
+    };
+}
+
+#endif
@@ -0,0 +1,88 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "FramePool.h"
+#include "WindowTable.h"
+
+using namespace Pharaoh;
+using namespace std;
+
+//--------------------------------------------------------------------------------
+// Ctor
+//--------------------------------------------------------------------------------
+
+FramePool::FramePool(WindowTable& windows, size_t maxIdle)
+    : m_Windows(windows)
+    , m_MaxIdle(maxIdle)
+{
+}
+
+//--------------------------------------------------------------------------------
+// Statistics
+//--------------------------------------------------------------------------------
+
+void FramePool::SetMaxIdle(size_t maxIdle)
+{
+    m_MaxIdle = maxIdle;
+}
+
+size_t FramePool::GetIdleCount() const
+{
+    return m_IdleFrames.size();
+}
+
+size_t FramePool::GetMaxIdle() const
+{
+    return m_MaxIdle;
+}
+
+const FramePool::Statistics& FramePool::GetStatistics() const
+{
+    return m_Statistics;
+}
+
+//--------------------------------------------------------------------------------
+// FrameRegistry
+//--------------------------------------------------------------------------------
+
+void FramePool::AddFrame(xcb_window_t frame, Emperor::ReparentingWindow& window)
+{
+    m_Windows.AddFrame(frame, window);
+}
+
+void FramePool::RemoveFrame(xcb_window_t frame)
+{
+    m_Windows.RemoveFrame(frame);
+}
+
+xcb_window_t FramePool::ReuseFrame()
+{
+    if(true == m_IdleFrames.empty())
+    {
+        m_Statistics.misses++;
+        return XCB_WINDOW_NONE;
+    }
+
+    xcb_window_t frame = m_IdleFrames.back();
+    m_IdleFrames.pop_back();
+    m_Statistics.hits++;
+    return frame;
+}
+
+bool FramePool::KeepFrame(xcb_window_t frame)
+{
+    if(m_IdleFrames.size() >= m_MaxIdle)
+    {
+        m_Statistics.discarded++;
+        return false;
+    }
+
+    m_IdleFrames.push_back(frame);
+    m_Statistics.kept++;
+    return true;
+}
@@ -0,0 +1,68 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef FRAMEPOOL_H_INCLUDED
+#define FRAMEPOOL_H_INCLUDED
+
+#include <xcb/xcb.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ReparentingWindow.h"
+
+namespace Pharaoh
+{
+    class WindowTable;
+
+    //! \brief  Frames that windows have finished with, kept unmapped and decorated for the
+    //!         next window to be mapped. A window that's hidden and shown again and again
+    //!         (dialogs, tray popups, drop-down terminals) then costs a configure for its
+    //!         frame instead of creating, decorating and destroying one each time.
+    //!         Frames in use are recorded in the WindowTable as usual. Only a bounded
+    //!         number are kept idle, any more are destroyed.
+    class FramePool : public Emperor::FrameRegistry
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t hits = 0;          // frames handed out again
+            uint64_t misses = 0;        // frames that had to be made
+            uint64_t kept = 0;          // frames taken back
+            uint64_t discarded = 0;     // frames destroyed because the pool was full
+        };
+
+        //! \brief ctor
+        //! \param windows Where frames in use are recorded.
+        //! \param maxIdle How many unused frames to keep at most.
+        FramePool(WindowTable& windows, size_t maxIdle);
+
+        //! \brief Change how many unused frames are kept. Frames already kept stay.
+        void SetMaxIdle(size_t maxIdle);
+
+        size_t GetIdleCount() const;
+        size_t GetMaxIdle() const;
+        const Statistics& GetStatistics() const;
+
+        // FrameRegistry
+        void AddFrame(xcb_window_t frame, Emperor::ReparentingWindow& window) override;
+        void RemoveFrame(xcb_window_t frame) override;
+        xcb_window_t ReuseFrame() override;
+        bool KeepFrame(xcb_window_t frame) override;
+
+    private:
+        WindowTable& m_Windows;
+        size_t m_MaxIdle;
+
+        // the most recently kept last, so it's handed out first
+        std::vector<xcb_window_t> m_IdleFrames;
+        Statistics m_Statistics;
+    };
+}
+
+#endif
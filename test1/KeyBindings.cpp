@@ -0,0 +1,238 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "KeyBindings.h"
+#include <X11/keysym.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <strings.h>
+
+using namespace std;
+using namespace Pharaoh;
+
+const unsigned int KeyBindings::MODIFIER_COMBINATIONS;
+
+const array<uint16_t, 4> KeyBindings::LOCK_MODIFIERS =
+{{
+    0,
+    XCB_MOD_MASK_LOCK,
+    XCB_MOD_MASK_2,
+    XCB_MOD_MASK_LOCK | XCB_MOD_MASK_2
+}};
+
+const char* const ACTION_NAMES[KeyAction_Count] =
+{
+    "none",
+    "close",
+    "next"
+};
+
+// keys with names, besides letters, digits and function keys
+const struct { const char* name; xcb_keysym_t keysym; } KEY_NAMES[] =
+{
+    { "Tab", XK_Tab },
+    { "Return", XK_Return },
+    { "Escape", XK_Escape },
+    { "space", XK_space },
+    { "BackSpace", XK_BackSpace },
+    { "Delete", XK_Delete },
+    { "Insert", XK_Insert },
+    { "Home", XK_Home },
+    { "End", XK_End },
+    { "Prior", XK_Prior },
+    { "Next", XK_Next },
+    { "Left", XK_Left },
+    { "Right", XK_Right },
+    { "Up", XK_Up },
+    { "Down", XK_Down },
+    { "Print", XK_Print },
+};
+
+//--------------------------------------------------------------------------------
+// ctor
+//--------------------------------------------------------------------------------
+
+KeyBindings::KeyBindings()
+{
+    m_Bindings.push_back({ XCB_MOD_MASK_1, XK_F4, KeyAction_CloseWindow });
+    m_Bindings.push_back({ XCB_MOD_MASK_1, XK_Tab, KeyAction_NextWindow });
+    m_Actions.fill(KeyAction_None);
+}
+
+//--------------------------------------------------------------------------------
+// Adding bindings
+//--------------------------------------------------------------------------------
+
+bool KeyBindings::Add(const string& binding)
+{
+    size_t equals = binding.find('=');
+    if(equals == string::npos)
+    {
+        return false;
+    }
+
+    // the action
+    string actionName = binding.substr(equals + 1);
+    KeyAction action = KeyAction_Count;
+    for(unsigned int i = 0; i < KeyAction_Count; i++)
+    {
+        if(actionName == ACTION_NAMES[i])
+        {
+            action = (KeyAction)i;
+        }
+    }
+    if(action == KeyAction_Count)
+    {
+        return false;
+    }
+
+    // the modifiers, then the key
+    uint16_t modifiers = 0;
+    size_t start = 0;
+    size_t plus = binding.find('+');
+    while(plus != string::npos && plus < equals)
+    {
+        uint16_t modifier;
+        if(false == ParseModifier(binding.substr(start, plus - start), modifier))
+        {
+            return false;
+        }
+        modifiers |= modifier;
+        start = plus + 1;
+        plus = binding.find('+', start);
+    }
+
+    xcb_keysym_t keysym;
+    if(false == ParseKeysym(binding.substr(start, equals - start), keysym))
+    {
+        return false;
+    }
+
+    m_Bindings.erase(
+        remove_if(m_Bindings.begin(), m_Bindings.end(), [&](const Binding& existing)
+        {
+            return existing.modifiers == modifiers && existing.keysym == keysym;
+        }),
+        m_Bindings.end());
+    if(action != KeyAction_None)
+    {
+        m_Bindings.push_back({ modifiers, keysym, action });
+    }
+    return true;
+}
+
+bool KeyBindings::ParseModifier(const string& name, uint16_t& modifier)
+{
+    const char* pName = name.c_str();
+    if(strcasecmp(pName, "Shift") == 0)
+    {
+        modifier = XCB_MOD_MASK_SHIFT;
+    }
+    else if(strcasecmp(pName, "Control") == 0 || strcasecmp(pName, "Ctrl") == 0)
+    {
+        modifier = XCB_MOD_MASK_CONTROL;
+    }
+    else if(strcasecmp(pName, "Alt") == 0 || strcasecmp(pName, "Mod1") == 0)
+    {
+        modifier = XCB_MOD_MASK_1;
+    }
+    else if(strcasecmp(pName, "Super") == 0 || strcasecmp(pName, "Mod4") == 0)
+    {
+        modifier = XCB_MOD_MASK_4;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool KeyBindings::ParseKeysym(const string& name, xcb_keysym_t& keysym)
+{
+    // letters and digits are their own (lower case) keysyms
+    if(name.length() == 1 && isalnum((unsigned char)name[0]))
+    {
+        keysym = (xcb_keysym_t)tolower((unsigned char)name[0]);
+        return true;
+    }
+
+    // F1 - F24
+    if(name.length() > 1 && (name[0] == 'F' || name[0] == 'f'))
+    {
+        char* pEnd = nullptr;
+        long number = strtol(name.c_str() + 1, &pEnd, 10);
+        if(*pEnd == '\0' && number >= 1 && number <= 24)
+        {
+            keysym = XK_F1 + (xcb_keysym_t)(number - 1);
+            return true;
+        }
+    }
+
+    for(const auto& key : KEY_NAMES)
+    {
+        if(strcasecmp(name.c_str(), key.name) == 0)
+        {
+            keysym = key.keysym;
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------
+// Compiling
+//--------------------------------------------------------------------------------
+
+void KeyBindings::Compile(const KeySymbols& keySymbols)
+{
+    m_Actions.fill(KeyAction_None);
+    m_CompiledKeys.clear();
+
+    for(const Binding& binding : m_Bindings)
+    {
+        xcb_keycode_t keycode = keySymbols.GetKeycode(binding.keysym);
+        if(keycode == 0)
+        {
+            // not on this keyboard
+            continue;
+        }
+
+        m_Actions[(keycode * MODIFIER_COMBINATIONS) + GetModifierIndex(binding.modifiers)] = binding.action;
+        m_CompiledKeys.push_back({ keycode, binding.modifiers });
+    }
+}
+
+//--------------------------------------------------------------------------------
+// Grabs
+//--------------------------------------------------------------------------------
+
+void KeyBindings::Grab(Emperor::XBackend& backend, xcb_window_t window) const
+{
+    for(const CompiledKey& key : m_CompiledKeys)
+    {
+        for(uint16_t lockModifiers : LOCK_MODIFIERS)
+        {
+            backend.GrabKey(window, key.modifiers | lockModifiers, key.keycode);
+        }
+    }
+}
+
+void KeyBindings::Ungrab(Emperor::XBackend& backend, xcb_window_t window)
+{
+    backend.UngrabKey(window, XCB_MOD_MASK_ANY, XCB_GRAB_ANY);
+}
+
+//--------------------------------------------------------------------------------
+// Others
+//--------------------------------------------------------------------------------
+
+const char* KeyBindings::GetActionName(KeyAction action)
+{
+    return (action < KeyAction_Count) ? ACTION_NAMES[action] : "unknown";
+}
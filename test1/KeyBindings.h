@@ -0,0 +1,112 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef KEYBINDINGS_H_INCLUDED
+#define KEYBINDINGS_H_INCLUDED
+
+#include "KeySymbols.h"
+#include "XBackend.h"
+#include <xcb/xcb.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Pharaoh
+{
+    enum KeyAction : uint8_t
+    {
+        KeyAction_None,
+        KeyAction_CloseWindow,
+        KeyAction_NextWindow,
+
+        KeyAction_Count
+    };
+
+    //! \brief  The window manager's keyboard shortcuts. Bindings are given as keysyms
+    //!         and modifier names, and compiled against the keyboard mapping into a
+    //!         table indexed by keycode and modifiers, so a key press is one array
+    //!         lookup however many bindings there are. Compile again whenever the
+    //!         server says the mapping has changed.
+    class KeyBindings
+    {
+    public:
+        //! \brief ctor - Alt+F4 closes the focused window, Alt+Tab moves to the next one.
+        KeyBindings();
+
+        //! \brief  Add a binding, replacing any existing one for the same keys. Takes effect
+        //!         at the next Compile.
+        //! \param binding "Modifier+...+Key=action", e.g. "Alt+Shift+Tab=next".
+        //!         Modifiers are Shift, Control (Ctrl), Alt (Mod1) and Super (Mod4).
+        //!         Actions are close, next and none (to remove a binding).
+        //! \return false if the binding couldn't be understood.
+        bool Add(const std::string& binding);
+
+        //! \brief Resolve every binding to its keycode in the current mapping.
+        void Compile(const KeySymbols& keySymbols);
+
+        //! \brief Get the action bound to a key press, KeyAction_None if there isn't one.
+        //! \param keycode The detail of the key press.
+        //! \param state The modifier state of the key press. Caps and Num Lock are ignored.
+        KeyAction GetAction(xcb_keycode_t keycode, uint16_t state) const
+        {
+            return m_Actions[(keycode * MODIFIER_COMBINATIONS) + GetModifierIndex(state)];
+        }
+
+        //! \brief Get the modifiers in a key press's state a binding can be for, without the locks.
+        static uint16_t GetBoundModifiers(uint16_t state)
+        {
+            return state & (XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL | XCB_MOD_MASK_1 | XCB_MOD_MASK_4);
+        }
+
+        //! \brief Grab every bound key on a window, with and without Caps and Num Lock.
+        void Grab(Emperor::XBackend& backend, xcb_window_t window) const;
+
+        //! \brief Let go of every key grabbed on a window, before grabbing a new set.
+        static void Ungrab(Emperor::XBackend& backend, xcb_window_t window);
+
+        static const char* GetActionName(KeyAction action);
+
+        //! Caps Lock and Num Lock (conventionally Mod2) in every combination. Grab with
+        //! each of these added, so the locks don't stop anything working.
+        static const std::array<uint16_t, 4> LOCK_MODIFIERS;
+
+    private:
+        struct Binding
+        {
+            uint16_t modifiers;
+            xcb_keysym_t keysym;
+            KeyAction action;
+        };
+
+        struct CompiledKey
+        {
+            xcb_keycode_t keycode;
+            uint16_t modifiers;
+        };
+
+        // the modifiers that can be bound, packed into an index. The locks aren't among them.
+        static const unsigned int MODIFIER_COMBINATIONS = 16;
+        static unsigned int GetModifierIndex(uint16_t state)
+        {
+            return ((state & XCB_MOD_MASK_SHIFT) ? 1 : 0) |
+                ((state & XCB_MOD_MASK_CONTROL) ? 2 : 0) |
+                ((state & XCB_MOD_MASK_1) ? 4 : 0) |
+                ((state & XCB_MOD_MASK_4) ? 8 : 0);
+        }
+
+        static bool ParseModifier(const std::string& name, uint16_t& modifier);
+        static bool ParseKeysym(const std::string& name, xcb_keysym_t& keysym);
+
+        std::vector<Binding> m_Bindings;
+        std::vector<CompiledKey> m_CompiledKeys;
+        std::array<KeyAction, 256 * MODIFIER_COMBINATIONS> m_Actions;
+    };
+}
+
+#endif
@@ -0,0 +1,96 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "KeySymbols.h"
+#include <X11/keysym.h>
+
+using namespace std;
+using namespace Pharaoh;
+
+//--------------------------------------------------------------------------------
+// Fetching the mapping
+//--------------------------------------------------------------------------------
+xcb_get_keyboard_mapping_cookie_t KeySymbols::RequestMapping(Emperor::XBackend& backend)
+{
+    return backend.RequestKeyboardMapping();
+}
+
+bool KeySymbols::ReceiveMapping(Emperor::XBackend& backend, xcb_get_keyboard_mapping_cookie_t cookie)
+{
+    return backend.ReceiveKeyboardMapping(cookie, m_MinKeycode, m_KeysymsPerKeycode, m_Keysyms);
+}
+
+//--------------------------------------------------------------------------------
+// Lookup
+//--------------------------------------------------------------------------------
+xcb_keycode_t KeySymbols::GetKeycode(xcb_keysym_t keysym) const
+{
+    if(m_KeysymsPerKeycode == 0)
+    {
+        return 0;
+    }
+
+    // same search order as XKeysymToKeycode: each column in turn, lowest keycode first
+    size_t keycodeCount = m_Keysyms.size() / m_KeysymsPerKeycode;
+    for(uint8_t column = 0; column < m_KeysymsPerKeycode; column++)
+    {
+        for(size_t i = 0; i < keycodeCount; i++)
+        {
+            if(m_Keysyms[(i * m_KeysymsPerKeycode) + column] == keysym)
+            {
+                return (xcb_keycode_t)(m_MinKeycode + i);
+            }
+        }
+    }
+
+    return 0;
+}
+
+xcb_keysym_t KeySymbols::GetKeysym(xcb_keycode_t keycode) const
+{
+    size_t index = (size_t)(keycode - m_MinKeycode) * m_KeysymsPerKeycode;
+    if(m_KeysymsPerKeycode == 0 || keycode < m_MinKeycode || index >= m_Keysyms.size())
+    {
+        return XCB_NO_SYMBOL;
+    }
+    return m_Keysyms[index];
+}
+
+uint16_t KeySymbols::GetModifierMask(xcb_keycode_t keycode) const
+{
+    return GetKeysymModifierMask(GetKeysym(keycode));
+}
+
+uint16_t KeySymbols::GetKeysymModifierMask(xcb_keysym_t keysym)
+{
+    switch(keysym)
+    {
+    case XK_Shift_L:
+    case XK_Shift_R:
+        return XCB_MOD_MASK_SHIFT;
+    case XK_Caps_Lock:
+        return XCB_MOD_MASK_LOCK;
+    case XK_Control_L:
+    case XK_Control_R:
+        return XCB_MOD_MASK_CONTROL;
+    case XK_Alt_L:
+    case XK_Alt_R:
+    case XK_Meta_L:
+    case XK_Meta_R:
+        return XCB_MOD_MASK_1;
+    case XK_Num_Lock:
+        return XCB_MOD_MASK_2;
+    case XK_Super_L:
+    case XK_Super_R:
+    case XK_Hyper_L:
+    case XK_Hyper_R:
+        return XCB_MOD_MASK_4;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,56 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef KEYSYMBOLS_H_INCLUDED
+#define KEYSYMBOLS_H_INCLUDED
+
+#include "XBackend.h"
+#include <xcb/xcb.h>
+#include <vector>
+
+namespace Pharaoh
+{
+    //! \brief  Client-side copy of the server's keyboard mapping, so keysyms can be
+    //!         turned into keycodes without asking the server each time.
+    class KeySymbols
+    {
+    public:
+        //! \brief Send the request for the keyboard mapping. Collect it with ReceiveMapping.
+        //! \param backend The X server to ask.
+        xcb_get_keyboard_mapping_cookie_t RequestMapping(Emperor::XBackend& backend);
+
+        //! \brief Wait for and store the keyboard mapping requested with RequestMapping.
+        //! \param backend The X server asked in RequestMapping.
+        //! \param cookie The cookie returned from RequestMapping.
+        //! \return true if the mapping was received, false if not.
+        bool ReceiveMapping(Emperor::XBackend& backend, xcb_get_keyboard_mapping_cookie_t cookie);
+
+        //! \brief Find the first keycode that produces the given keysym. Returns 0 if none do.
+        //! \param keysym The keysym to look up (one of the XK_ values).
+        xcb_keycode_t GetKeycode(xcb_keysym_t keysym) const;
+
+        //! \brief Get the keysym a key produces unshifted, XCB_NO_SYMBOL if it has none.
+        //! \param keycode The key to look up.
+        xcb_keysym_t GetKeysym(xcb_keycode_t keycode) const;
+
+        //! \brief Get the modifier a key sets, 0 if it isn't a modifier.
+        //! \param keycode The key to look up.
+        uint16_t GetModifierMask(xcb_keycode_t keycode) const;
+
+        //! \brief  Get the modifier a keysym conventionally sets, as KeyBindings names
+        //!         them: Alt and Meta are Mod1, Num Lock Mod2, Super and Hyper Mod4.
+        static uint16_t GetKeysymModifierMask(xcb_keysym_t keysym);
+
+    private:
+        xcb_keycode_t m_MinKeycode = 0;
+        uint8_t m_KeysymsPerKeycode = 0;
+        std::vector<xcb_keysym_t> m_Keysyms;
+    };
+}
+
+#endif
@@ -0,0 +1,104 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Pharaoh;
+using namespace std;
+
+//--------------------------------------------------------------------------------
+// recording
+//--------------------------------------------------------------------------------
+
+void LatencyHistogram::Record(uint64_t value)
+{
+    m_Buckets[GetBucket(value)]++;
+    m_Count++;
+    m_Max = max(m_Max, value);
+}
+
+void LatencyHistogram::Reset()
+{
+    m_Buckets.fill(0);
+    m_Count = 0;
+    m_Max = 0;
+}
+
+//--------------------------------------------------------------------------------
+// results
+//--------------------------------------------------------------------------------
+
+uint64_t LatencyHistogram::GetCount() const
+{
+    return m_Count;
+}
+
+uint64_t LatencyHistogram::GetMax() const
+{
+    return m_Max;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double fraction) const
+{
+    if(m_Count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = max((uint64_t)1, (uint64_t)ceil(fraction * (double)m_Count));
+    uint64_t seen = 0;
+    for(unsigned int bucket = 0; bucket < BUCKET_COUNT; bucket++)
+    {
+        seen += m_Buckets[bucket];
+        if(seen >= target)
+        {
+            // the bucket's top can overshoot what was actually recorded
+            return min(GetBucketTop(bucket), m_Max);
+        }
+    }
+    return m_Max;
+}
+
+//--------------------------------------------------------------------------------
+// bucket layout
+//--------------------------------------------------------------------------------
+
+// Values below SUB_BUCKETS get a bucket each. Above that, a value whose highest set bit
+// is n goes in one of SUB_BUCKETS buckets spanning [2^n, 2^(n+1)), picked by the
+// SUB_BUCKET_BITS bits below the highest.
+unsigned int LatencyHistogram::GetBucket(uint64_t value)
+{
+    if(value < SUB_BUCKETS)
+    {
+        return (unsigned int)value;
+    }
+
+    unsigned int highestBit = 63 - __builtin_clzll(value);
+    if(highestBit >= MAX_VALUE_BITS)
+    {
+        return BUCKET_COUNT - 1;
+    }
+
+    unsigned int shift = highestBit - SUB_BUCKET_BITS;
+    unsigned int subBucket = (unsigned int)(value >> shift) - SUB_BUCKETS;
+    return (shift + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::GetBucketTop(unsigned int bucket)
+{
+    if(bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    unsigned int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t subBucket = bucket % SUB_BUCKETS;
+    return ((SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
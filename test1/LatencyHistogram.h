@@ -0,0 +1,55 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef LATENCYHISTOGRAM_H_INCLUDED
+#define LATENCYHISTOGRAM_H_INCLUDED
+
+#include <array>
+#include <cstdint>
+
+namespace Pharaoh
+{
+    //! \brief  Fixed size latency histogram, in the style of HdrHistogram. Each power of two
+    //!         is split into SUB_BUCKETS linear buckets, so any recorded value is known to
+    //!         within ~3%. Recording is a couple of bit operations and an increment, with
+    //!         no allocation, so it can stay on all the time.
+    class LatencyHistogram
+    {
+    public:
+        //! \brief Record one value, in nanoseconds. Values beyond ~18 minutes are clamped.
+        void Record(uint64_t value);
+
+        //! \brief Number of values recorded.
+        uint64_t GetCount() const;
+
+        //! \brief Largest value recorded, exactly.
+        uint64_t GetMax() const;
+
+        //! \brief  Get the value that the given fraction of the recorded values are at or
+        //!         below. The answer is the top of the bucket it falls in.
+        //! \param fraction 0.5 for the median, 0.99 for the 99th percentile, etc.
+        uint64_t GetPercentile(double fraction) const;
+
+        void Reset();
+
+    private:
+        static const unsigned int SUB_BUCKET_BITS = 5;
+        static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const unsigned int MAX_VALUE_BITS = 40;
+        static const unsigned int BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        static unsigned int GetBucket(uint64_t value);
+        static uint64_t GetBucketTop(unsigned int bucket);
+
+        std::array<uint64_t, BUCKET_COUNT> m_Buckets = {};
+        uint64_t m_Count = 0;
+        uint64_t m_Max = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,303 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "MainLoop.h"
+#include "AsyncLog.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+using namespace Pharaoh;
+
+// how many epoll events to take per wakeup
+const int MAX_EPOLL_EVENTS = 16;
+
+//--------------------------------------------------------------------------------
+// ctor & dtor
+//--------------------------------------------------------------------------------
+MainLoop::MainLoop()
+{
+    sigemptyset(&m_Signals);
+
+    m_EpollFileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+    if(m_EpollFileDescriptor < 0)
+    {
+        LOG_ERROR << "Failed to create epoll instance: " << strerror(errno);
+        return;
+    }
+
+    // the timerfd stays registered, it's simply disarmed when there are no timers
+    m_TimerFileDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(m_TimerFileDescriptor < 0)
+    {
+        LOG_ERROR << "Failed to create timerfd: " << strerror(errno);
+        return;
+    }
+    AddFileDescriptor(m_TimerFileDescriptor, EPOLLIN, [this](uint32_t) { OnTimerFileDescriptor(); });
+}
+
+MainLoop::~MainLoop()
+{
+    if(m_SignalFileDescriptor >= 0)
+    {
+        close(m_SignalFileDescriptor);
+    }
+    if(m_TimerFileDescriptor >= 0)
+    {
+        close(m_TimerFileDescriptor);
+    }
+    if(m_EpollFileDescriptor >= 0)
+    {
+        close(m_EpollFileDescriptor);
+    }
+}
+
+//--------------------------------------------------------------------------------
+// File descriptors
+//--------------------------------------------------------------------------------
+bool MainLoop::AddFileDescriptor(int fd, uint32_t events, const function<void(uint32_t)>& callback)
+{
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    if(epoll_ctl(m_EpollFileDescriptor, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        LOG_ERROR << "Failed to watch file descriptor " << fd << ": " << strerror(errno);
+        return false;
+    }
+
+    m_FileDescriptorCallbacks[fd] = callback;
+    return true;
+}
+
+void MainLoop::RemoveFileDescriptor(int fd)
+{
+    epoll_ctl(m_EpollFileDescriptor, EPOLL_CTL_DEL, fd, nullptr);
+    m_FileDescriptorCallbacks.erase(fd);
+}
+
+//--------------------------------------------------------------------------------
+// Timers
+//--------------------------------------------------------------------------------
+MainLoop::TimerId MainLoop::AddTimer(Clock::duration delay, Clock::duration interval, const function<void()>& callback)
+{
+    TimerId id = m_NextTimerId++;
+    Clock::time_point deadline = Clock::now() + delay;
+
+    m_Timers[id] = Timer{ deadline, interval, callback };
+    m_TimerDeadlines.emplace(deadline, id);
+
+    // only touch the timerfd if this is the new earliest deadline
+    if(m_TimerDeadlines.begin()->second == id)
+    {
+        ArmTimerFileDescriptor();
+    }
+
+    return id;
+}
+
+void MainLoop::CancelTimer(TimerId id)
+{
+    auto it = m_Timers.find(id);
+    if(it == m_Timers.end())
+    {
+        return;
+    }
+
+    auto range = m_TimerDeadlines.equal_range(it->second.deadline);
+    for(auto deadlineIt = range.first; deadlineIt != range.second; ++deadlineIt)
+    {
+        if(deadlineIt->second == id)
+        {
+            m_TimerDeadlines.erase(deadlineIt);
+            break;
+        }
+    }
+    m_Timers.erase(it);
+
+    // leaving the timerfd armed for a cancelled deadline would only cost one
+    // spurious wakeup, but an idle loop should make none.
+    if(m_TimerDeadlines.empty())
+    {
+        ArmTimerFileDescriptor();
+    }
+}
+
+void MainLoop::ArmTimerFileDescriptor()
+{
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    if(false == m_TimerDeadlines.empty())
+    {
+        // steady_clock is CLOCK_MONOTONIC, so the deadline can be used as an absolute time
+        auto deadline = chrono::duration_cast<chrono::nanoseconds>(m_TimerDeadlines.begin()->first.time_since_epoch()).count();
+
+        // an all-zero it_value disarms the timer, make sure a deadline of zero still fires
+        spec.it_value.tv_sec = deadline / 1000000000;
+        spec.it_value.tv_nsec = max(deadline % 1000000000, (decltype(deadline))1);
+    }
+
+    timerfd_settime(m_TimerFileDescriptor, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void MainLoop::OnTimerFileDescriptor()
+{
+    // clear the expiration count
+    uint64_t expirations;
+    while(read(m_TimerFileDescriptor, &expirations, sizeof(expirations)) > 0) {}
+
+    Clock::time_point now = Clock::now();
+    while(false == m_TimerDeadlines.empty() && m_TimerDeadlines.begin()->first <= now)
+    {
+        TimerId id = m_TimerDeadlines.begin()->second;
+        m_TimerDeadlines.erase(m_TimerDeadlines.begin());
+
+        auto it = m_Timers.find(id);
+        if(it == m_Timers.end())
+        {
+            continue;
+        }
+
+        // copy the callback, it may cancel its own timer
+        function<void()> callback = it->second.callback;
+        if(it->second.interval > Clock::duration::zero())
+        {
+            // keep to the original schedule, but don't try to catch up on missed calls
+            Timer& timer = it->second;
+            timer.deadline += timer.interval;
+            if(timer.deadline <= now)
+            {
+                timer.deadline = now + timer.interval;
+            }
+            m_TimerDeadlines.emplace(timer.deadline, id);
+        }
+        else
+        {
+            m_Timers.erase(it);
+        }
+
+        callback();
+    }
+
+    ArmTimerFileDescriptor();
+}
+
+//--------------------------------------------------------------------------------
+// Signals
+//--------------------------------------------------------------------------------
+bool MainLoop::AddSignal(int signalNumber, const function<void()>& callback)
+{
+    // block normal delivery, the signal is read from the signalfd instead
+    sigaddset(&m_Signals, signalNumber);
+    if(sigprocmask(SIG_BLOCK, &m_Signals, nullptr) != 0)
+    {
+        LOG_ERROR << "Failed to block signal " << signalNumber << ": " << strerror(errno);
+        return false;
+    }
+
+    // passing the existing descriptor updates its mask
+    bool isNew = (m_SignalFileDescriptor < 0);
+    m_SignalFileDescriptor = signalfd(m_SignalFileDescriptor, &m_Signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(m_SignalFileDescriptor < 0)
+    {
+        LOG_ERROR << "Failed to create signalfd: " << strerror(errno);
+        return false;
+    }
+
+    if(true == isNew)
+    {
+        AddFileDescriptor(m_SignalFileDescriptor, EPOLLIN, [this](uint32_t) { OnSignalFileDescriptor(); });
+    }
+
+    m_SignalCallbacks[signalNumber] = callback;
+    return true;
+}
+
+void MainLoop::OnSignalFileDescriptor()
+{
+    signalfd_siginfo info;
+    while(read(m_SignalFileDescriptor, &info, sizeof(info)) == sizeof(info))
+    {
+        auto it = m_SignalCallbacks.find(info.ssi_signo);
+        if(it != m_SignalCallbacks.end())
+        {
+            it->second();
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------
+// Running
+//--------------------------------------------------------------------------------
+void MainLoop::SetPrepareCallback(const function<void()>& callback)
+{
+    m_PrepareCallback = callback;
+}
+
+bool MainLoop::Run()
+{
+    if(m_EpollFileDescriptor < 0 || m_TimerFileDescriptor < 0)
+    {
+        return false;
+    }
+
+    m_Running = true;
+    while(true == m_Running)
+    {
+        if(m_PrepareCallback)
+        {
+            m_PrepareCallback();
+
+            // the prepare callback may have decided we're done
+            if(false == m_Running)
+            {
+                break;
+            }
+        }
+
+        // sleep until something happens. There's no timeout, timers come through the timerfd.
+        epoll_event events[MAX_EPOLL_EVENTS];
+        int eventCount = epoll_wait(m_EpollFileDescriptor, events, MAX_EPOLL_EVENTS, -1);
+        if(eventCount < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            LOG_ERROR << "epoll_wait failed: " << strerror(errno);
+            m_Running = false;
+            return false;
+        }
+
+        for(int i = 0; i < eventCount && true == m_Running; i++)
+        {
+            // look the callback up each time, an earlier callback may have removed it.
+            // Call a copy, so it can safely remove itself.
+            auto it = m_FileDescriptorCallbacks.find(events[i].data.fd);
+            if(it != m_FileDescriptorCallbacks.end())
+            {
+                function<void(uint32_t)> callback = it->second;
+                callback(events[i].events);
+            }
+        }
+    }
+
+    return true;
+}
+
+void MainLoop::Stop()
+{
+    m_Running = false;
+}
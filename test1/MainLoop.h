@@ -0,0 +1,100 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef MAINLOOP_H_INCLUDED
+#define MAINLOOP_H_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <signal.h>
+
+namespace Pharaoh
+{
+    //! \brief  epoll based main loop. Waits on any number of file descriptors, timers
+    //!         and signals at once, and sleeps until one of them needs attention.
+    //!         Timers share a single timerfd armed for the earliest deadline, so when
+    //!         nothing is due the loop makes no wakeups at all.
+    class MainLoop
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+        typedef unsigned long TimerId;
+
+        MainLoop();
+        ~MainLoop();
+
+        //! \brief Watch a file descriptor.
+        //! \param fd The file descriptor to watch. It is not closed by the loop.
+        //! \param events The epoll events to wait for (EPOLLIN etc).
+        //! \param callback Called with the epoll events that occurred.
+        //! \return true if the descriptor was added, false if not.
+        bool AddFileDescriptor(int fd, uint32_t events, const std::function<void(uint32_t)>& callback);
+
+        //! \brief Stop watching a file descriptor.
+        void RemoveFileDescriptor(int fd);
+
+        //! \brief Call something after a delay, and optionally every interval after that.
+        //! \param delay How long to wait before the first call.
+        //! \param interval How long between subsequent calls. Zero for a one-shot timer.
+        //! \param callback The function to call.
+        //! \return The id to cancel the timer with.
+        TimerId AddTimer(Clock::duration delay, Clock::duration interval, const std::function<void()>& callback);
+
+        //! \brief Cancel a timer. Safe to call with an id that has already fired or been cancelled.
+        void CancelTimer(TimerId id);
+
+        //! \brief  Handle a signal through the loop rather than asynchronously. The signal is
+        //!         blocked for the calling thread, so call this before starting any threads.
+        //! \param signalNumber The signal to handle (SIGTERM etc).
+        //! \param callback The function to call when the signal arrives.
+        //! \return true if the signal handler was added, false if not.
+        bool AddSignal(int signalNumber, const std::function<void()>& callback);
+
+        //! \brief Set a function to be called each time before the loop goes to sleep.
+        void SetPrepareCallback(const std::function<void()>& callback);
+
+        //! \brief Run until Stop is called.
+        //! \return false if the loop couldn't be started or failed while waiting, true otherwise.
+        bool Run();
+
+        //! \brief Make Run return once the current callbacks have finished.
+        void Stop();
+
+    private:
+        struct Timer
+        {
+            Clock::time_point deadline;
+            Clock::duration interval;
+            std::function<void()> callback;
+        };
+
+        void OnTimerFileDescriptor();
+        void OnSignalFileDescriptor();
+        void ArmTimerFileDescriptor();
+
+        int m_EpollFileDescriptor = -1;
+        int m_TimerFileDescriptor = -1;
+        int m_SignalFileDescriptor = -1;
+        bool m_Running = false;
+
+        std::map<int, std::function<void(uint32_t)>> m_FileDescriptorCallbacks;
+
+        TimerId m_NextTimerId = 1;
+        std::map<TimerId, Timer> m_Timers;
+        std::multimap<Clock::time_point, TimerId> m_TimerDeadlines;
+
+        sigset_t m_Signals;
+        std::map<int, std::function<void()>> m_SignalCallbacks;
+
+        std::function<void()> m_PrepareCallback;
+    };
+}
+
+#endif
@@ -0,0 +1,215 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef SLABPOOL_H_INCLUDED
+#define SLABPOOL_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Pharaoh
+{
+    //! \brief  Objects that come and go a lot, allocated from fixed size slabs. Freed slots
+    //!         are reused before a new slab is added and slabs are never given back, so
+    //!         churn doesn't fragment the heap, objects never move, and the live objects
+    //!         stay packed together for walking over them all.
+    //!         Each slot has a generation that goes up whenever its object is destroyed,
+    //!         so a Handle kept past the life of its object is detected, not followed.
+    template<typename T, size_t SLAB_SIZE = 64>
+    class SlabPool
+    {
+    public:
+        struct Handle
+        {
+            uint32_t index = INVALID_INDEX;
+            uint32_t generation = 0;
+        };
+
+        struct Statistics
+        {
+            size_t slabs = 0;
+            size_t capacity = 0;        // slots in all the slabs
+            size_t live = 0;
+            size_t peakLive = 0;
+            size_t bytesReserved = 0;
+            uint64_t allocations = 0;
+            uint64_t frees = 0;
+        };
+
+        SlabPool() {}
+
+        ~SlabPool()
+        {
+            for(uint32_t index = 0; index < GetCapacity(); index++)
+            {
+                Slot& slot = GetSlot(index);
+                if(true == slot.live)
+                {
+                    GetObject(slot)->~T();
+                }
+            }
+        }
+
+        SlabPool(const SlabPool&) = delete;
+        SlabPool& operator=(const SlabPool&) = delete;
+
+        //! \brief Construct a new object in a free slot, adding a slab if there isn't one.
+        template<typename... Args>
+        T* Create(Args&&... args)
+        {
+            if(m_FreeList == INVALID_INDEX)
+            {
+                AddSlab();
+            }
+
+            Slot& slot = GetSlot(m_FreeList);
+            m_FreeList = slot.nextFree;
+            T* pObject = new(&slot.storage) T(std::forward<Args>(args)...);
+            slot.live = true;
+
+            m_Statistics.live++;
+            m_Statistics.allocations++;
+            if(m_Statistics.live > m_Statistics.peakLive)
+            {
+                m_Statistics.peakLive = m_Statistics.live;
+            }
+            return pObject;
+        }
+
+        //! \brief Destroy an object from this pool. Its handles are no longer valid.
+        void Destroy(T* pObject)
+        {
+            Slot& slot = GetSlot(GetHandle(pObject).index);
+            pObject->~T();
+            slot.live = false;
+            slot.generation++;
+            slot.nextFree = m_FreeList;
+            m_FreeList = slot.index;
+
+            m_Statistics.live--;
+            m_Statistics.frees++;
+        }
+
+        //! \brief Get a handle that stays safe to hold on to after the object is destroyed.
+        Handle GetHandle(const T* pObject) const
+        {
+            // the object is the first thing in its slot
+            const Slot* pSlot = reinterpret_cast<const Slot*>(pObject);
+            Handle handle;
+            handle.index = pSlot->index;
+            handle.generation = pSlot->generation;
+            return handle;
+        }
+
+        //! \brief Get the object a handle refers to, nullptr if it has been destroyed.
+        T* Get(Handle handle) const
+        {
+            if(handle.index >= GetCapacity())
+            {
+                return nullptr;
+            }
+            Slot& slot = GetSlot(handle.index);
+            return (true == slot.live && slot.generation == handle.generation) ? GetObject(slot) : nullptr;
+        }
+
+        //! \brief  The live object after this one in slot order, wrapping round. The object
+        //!         itself if it's the only one.
+        T* GetNext(const T* pObject) const
+        {
+            uint32_t start = GetHandle(pObject).index;
+            uint32_t capacity = GetCapacity();
+            for(uint32_t i = 1; i <= capacity; i++)
+            {
+                Slot& slot = GetSlot((start + i) % capacity);
+                if(true == slot.live)
+                {
+                    return GetObject(slot);
+                }
+            }
+            return nullptr;
+        }
+
+        //! \brief Call function(T*) for every live object, in slot order.
+        template<typename Function>
+        void ForEach(Function function) const
+        {
+            for(uint32_t index = 0; index < GetCapacity(); index++)
+            {
+                Slot& slot = GetSlot(index);
+                if(true == slot.live)
+                {
+                    function(GetObject(slot));
+                }
+            }
+        }
+
+        const Statistics& GetStatistics() const
+        {
+            return m_Statistics;
+        }
+
+    private:
+        static const uint32_t INVALID_INDEX = 0xffffffff;
+
+        struct Slot
+        {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+            uint32_t index;
+            uint32_t generation;
+            uint32_t nextFree;
+            bool live;
+        };
+
+        void AddSlab()
+        {
+            uint32_t firstIndex = GetCapacity();
+            m_xSlabs.emplace_back(new Slot[SLAB_SIZE]);
+            Slot* pSlab = m_xSlabs.back().get();
+
+            // chained so the lowest index is handed out first
+            for(uint32_t i = 0; i < SLAB_SIZE; i++)
+            {
+                pSlab[i].index = firstIndex + i;
+                pSlab[i].generation = 0;
+                pSlab[i].nextFree = (i + 1 < SLAB_SIZE) ? firstIndex + i + 1 : m_FreeList;
+                pSlab[i].live = false;
+            }
+            m_FreeList = firstIndex;
+
+            m_Statistics.slabs++;
+            m_Statistics.capacity += SLAB_SIZE;
+            m_Statistics.bytesReserved += SLAB_SIZE * sizeof(Slot);
+        }
+
+        uint32_t GetCapacity() const
+        {
+            return (uint32_t)(m_xSlabs.size() * SLAB_SIZE);
+        }
+
+        Slot& GetSlot(uint32_t index) const
+        {
+            return m_xSlabs[index / SLAB_SIZE][index % SLAB_SIZE];
+        }
+
+        static T* GetObject(Slot& slot)
+        {
+            return reinterpret_cast<T*>(&slot.storage);
+        }
+
+        std::vector<std::unique_ptr<Slot[]>> m_xSlabs;
+        uint32_t m_FreeList = INVALID_INDEX;
+        Statistics m_Statistics;
+    };
+}
+
+#endif
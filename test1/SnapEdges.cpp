@@ -0,0 +1,192 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "SnapEdges.h"
+#include "Window.h"
+#include <iterator>
+
+using namespace Pharaoh;
+using namespace std;
+
+const int SnapEdges::SNAP_DISTANCE;
+
+//--------------------------------------------------------------------------------
+// Monitors
+//--------------------------------------------------------------------------------
+
+void SnapEdges::SetMonitors(const vector<xcb_rectangle_t>& monitors)
+{
+    for(SnapEdgeSet::iterator edge : m_MonitorVerticalEdges)
+    {
+        m_Vertical.erase(edge);
+    }
+    for(SnapEdgeSet::iterator edge : m_MonitorHorizontalEdges)
+    {
+        m_Horizontal.erase(edge);
+    }
+    m_MonitorVerticalEdges.clear();
+    m_MonitorHorizontalEdges.clear();
+
+    m_Monitors = monitors;
+    for(const xcb_rectangle_t& monitor : m_Monitors)
+    {
+        int right = monitor.x + monitor.width;
+        int bottom = monitor.y + monitor.height;
+        m_MonitorVerticalEdges.push_back(m_Vertical.insert({ monitor.x, monitor.y, bottom, nullptr }));
+        m_MonitorVerticalEdges.push_back(m_Vertical.insert({ right, monitor.y, bottom, nullptr }));
+        m_MonitorHorizontalEdges.push_back(m_Horizontal.insert({ monitor.y, monitor.x, right, nullptr }));
+        m_MonitorHorizontalEdges.push_back(m_Horizontal.insert({ bottom, monitor.x, right, nullptr }));
+    }
+}
+
+const vector<xcb_rectangle_t>& SnapEdges::GetMonitors() const
+{
+    return m_Monitors;
+}
+
+const xcb_rectangle_t* SnapEdges::FindMonitor(int x, int y) const
+{
+    for(const xcb_rectangle_t& monitor : m_Monitors)
+    {
+        if(x >= monitor.x && x < monitor.x + monitor.width &&
+            y >= monitor.y && y < monitor.y + monitor.height)
+        {
+            return &monitor;
+        }
+    }
+    return nullptr;
+}
+
+//--------------------------------------------------------------------------------
+// Update & Remove
+//--------------------------------------------------------------------------------
+
+void SnapEdges::Update(PharaohWindow& window)
+{
+    int x, y;
+    unsigned int width, height;
+    unsigned int left, top, right, bottom;
+    window.GetLocation(x, y);
+    window.GetSize(width, height);
+    window.GetFrameExtents(left, top, right, bottom);
+    const int frameRight = x + (int)(width + left + right);
+    const int frameBottom = y + (int)(height + top + bottom);
+
+    SnapNode& node = window.GetSnapNode();
+    if(true == node.filed)
+    {
+        if(node.left->position == x && node.top->position == y &&
+            node.right->position == frameRight && node.bottom->position == frameBottom)
+        {
+            return;
+        }
+
+        // a window usually moves a little at a time, so its old edges are a good hint
+        // for where the new ones go
+        SnapEdgeSet::iterator oldLeft = node.left;
+        SnapEdgeSet::iterator oldRight = node.right;
+        SnapEdgeSet::iterator oldTop = node.top;
+        SnapEdgeSet::iterator oldBottom = node.bottom;
+        node.left = m_Vertical.insert(oldLeft, { x, y, frameBottom, &window });
+        node.right = m_Vertical.insert(oldRight, { frameRight, y, frameBottom, &window });
+        node.top = m_Horizontal.insert(oldTop, { y, x, frameRight, &window });
+        node.bottom = m_Horizontal.insert(oldBottom, { frameBottom, x, frameRight, &window });
+        m_Vertical.erase(oldLeft);
+        m_Vertical.erase(oldRight);
+        m_Horizontal.erase(oldTop);
+        m_Horizontal.erase(oldBottom);
+        return;
+    }
+
+    node.left = m_Vertical.insert({ x, y, frameBottom, &window });
+    node.right = m_Vertical.insert({ frameRight, y, frameBottom, &window });
+    node.top = m_Horizontal.insert({ y, x, frameRight, &window });
+    node.bottom = m_Horizontal.insert({ frameBottom, x, frameRight, &window });
+    node.filed = true;
+    m_Count++;
+}
+
+void SnapEdges::Remove(PharaohWindow& window)
+{
+    SnapNode& node = window.GetSnapNode();
+    if(false == node.filed)
+    {
+        return;
+    }
+
+    m_Vertical.erase(node.left);
+    m_Vertical.erase(node.right);
+    m_Horizontal.erase(node.top);
+    m_Horizontal.erase(node.bottom);
+    node = SnapNode();
+    m_Count--;
+}
+
+//--------------------------------------------------------------------------------
+// Queries
+//--------------------------------------------------------------------------------
+
+bool SnapEdges::FindVertical(int x, int top, int bottom, const PharaohWindow* pExclude, int& edgeX) const
+{
+    return FindNearest(m_Vertical, x, top, bottom, pExclude, edgeX);
+}
+
+bool SnapEdges::FindHorizontal(int y, int left, int right, const PharaohWindow* pExclude, int& edgeY) const
+{
+    return FindNearest(m_Horizontal, y, left, right, pExclude, edgeY);
+}
+
+bool SnapEdges::FindNearest(
+    const SnapEdgeSet& edges,
+    int position,
+    int start,
+    int end,
+    const PharaohWindow* pExclude,
+    int& nearest)
+{
+    // work outwards from the position, nearest edges first, so the first edge that runs
+    // alongside is the answer. Edges that line up are common (cascaded windows, tiles),
+    // this stops at the first of them rather than looking at them all.
+    const SnapEdge from = { position, 0, 0, nullptr };
+    SnapEdgeSet::const_iterator after = edges.lower_bound(from);
+    SnapEdgeSet::const_iterator before = after;
+    for(;;)
+    {
+        bool haveAfter = (after != edges.end() && after->position - position <= SNAP_DISTANCE);
+        bool haveBefore = (before != edges.begin() && position - prev(before)->position <= SNAP_DISTANCE);
+        if(false == haveAfter && false == haveBefore)
+        {
+            return false;
+        }
+
+        SnapEdgeSet::const_iterator it;
+        if(true == haveAfter && (false == haveBefore || after->position - position <= position - prev(before)->position))
+        {
+            it = after++;
+        }
+        else
+        {
+            it = --before;
+        }
+
+        if((it->pWindow != pExclude || pExclude == nullptr) && it->start < end && it->end > start)
+        {
+            nearest = it->position;
+            return true;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------
+// Others
+//--------------------------------------------------------------------------------
+
+size_t SnapEdges::GetCount() const
+{
+    return m_Count;
+}
@@ -0,0 +1,110 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef SNAPEDGES_H_INCLUDED
+#define SNAPEDGES_H_INCLUDED
+
+#include <xcb/xcb.h>
+#include <cstddef>
+#include <set>
+#include <vector>
+
+namespace Pharaoh
+{
+    class PharaohWindow;
+
+    //! \brief  One side of a frame or a monitor. A vertical edge is at an x and runs from
+    //!         start to end down the screen, a horizontal edge the other way round.
+    struct SnapEdge
+    {
+        int position;
+        int start;
+        int end;                        // one past the last pixel
+        const PharaohWindow* pWindow;   // nullptr for a monitor's edge
+    };
+
+    struct SnapEdgeOrder
+    {
+        bool operator()(const SnapEdge& a, const SnapEdge& b) const
+        {
+            return a.position < b.position;
+        }
+    };
+
+    typedef std::multiset<SnapEdge, SnapEdgeOrder> SnapEdgeSet;
+
+    //! \brief  Where a window's edges are in the SnapEdges. Each PharaohWindow has one.
+    struct SnapNode
+    {
+        bool filed = false;
+        SnapEdgeSet::iterator left;
+        SnapEdgeSet::iterator right;
+        SnapEdgeSet::iterator top;
+        SnapEdgeSet::iterator bottom;
+    };
+
+    //! \brief  The edges of the mapped windows' frames and of the monitors, kept sorted
+    //!         by where they are, so a frame being dragged finds the edges near its own
+    //!         with a binary search instead of looking at every window. Windows are
+    //!         refiled as they come, go and move, a few tree operations each.
+    class SnapEdges
+    {
+    public:
+        //! \brief How close, in pixels, a frame has to come to an edge to snap to it.
+        static const int SNAP_DISTANCE = 10;
+
+        //! \brief Replace the monitors, and their edges.
+        void SetMonitors(const std::vector<xcb_rectangle_t>& monitors);
+
+        const std::vector<xcb_rectangle_t>& GetMonitors() const;
+
+        //! \brief Get the monitor a point is on, nullptr if it's between or off them.
+        const xcb_rectangle_t* FindMonitor(int x, int y) const;
+
+        //! \brief File a mapped window's edges, or refile them where its frame is now.
+        void Update(PharaohWindow& window);
+
+        //! \brief Take a window's edges out, before its frame is unmapped.
+        void Remove(PharaohWindow& window);
+
+        //! \brief  Find the nearest vertical edge within SNAP_DISTANCE of x that runs
+        //!         alongside top to bottom.
+        //! \param pExclude A window whose own edges don't count, the one being dragged.
+        //! \param edgeX Set to where the edge is.
+        //! \return false if there isn't one.
+        bool FindVertical(int x, int top, int bottom, const PharaohWindow* pExclude, int& edgeX) const;
+
+        //! \brief  Find the nearest horizontal edge within SNAP_DISTANCE of y that runs
+        //!         alongside left to right.
+        //! \param pExclude A window whose own edges don't count, the one being dragged.
+        //! \param edgeY Set to where the edge is.
+        //! \return false if there isn't one.
+        bool FindHorizontal(int y, int left, int right, const PharaohWindow* pExclude, int& edgeY) const;
+
+        //! \brief How many windows have their edges filed.
+        size_t GetCount() const;
+
+    private:
+        static bool FindNearest(
+            const SnapEdgeSet& edges,
+            int position,
+            int start,
+            int end,
+            const PharaohWindow* pExclude,
+            int& nearest);
+
+        SnapEdgeSet m_Vertical;
+        SnapEdgeSet m_Horizontal;
+        std::vector<xcb_rectangle_t> m_Monitors;
+        std::vector<SnapEdgeSet::iterator> m_MonitorVerticalEdges;
+        std::vector<SnapEdgeSet::iterator> m_MonitorHorizontalEdges;
+        size_t m_Count = 0;
+    };
+}
+
+#endif
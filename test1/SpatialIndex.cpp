@@ -0,0 +1,192 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "SpatialIndex.h"
+#include "Window.h"
+#include <algorithm>
+
+using namespace Pharaoh;
+using namespace std;
+
+//--------------------------------------------------------------------------------
+// Ctor
+//--------------------------------------------------------------------------------
+
+SpatialIndex::SpatialIndex()
+    : m_Buckets(GRID_SIZE * GRID_SIZE)
+{
+}
+
+//--------------------------------------------------------------------------------
+// Update & Remove
+//--------------------------------------------------------------------------------
+
+void SpatialIndex::Update(PharaohWindow& window)
+{
+    int x, y;
+    unsigned int width, height;
+    unsigned int left, top, right, bottom;
+    window.GetLocation(x, y);
+    window.GetSize(width, height);
+    window.GetFrameExtents(left, top, right, bottom);
+
+    SpatialNode newNode;
+    newNode.indexed = true;
+    newNode.x = x;
+    newNode.y = y;
+    newNode.right = x + (int)(width + left + right);
+    newNode.bottom = y + (int)(height + top + bottom);
+
+    // a window wider or taller than the grid is in every bucket across it anyway
+    newNode.cellLeft = GetCell(newNode.x);
+    newNode.cellTop = GetCell(newNode.y);
+    newNode.cellRight = min(GetCell(newNode.right - 1), newNode.cellLeft + GRID_SIZE - 1);
+    newNode.cellBottom = min(GetCell(newNode.bottom - 1), newNode.cellTop + GRID_SIZE - 1);
+
+    SpatialNode& node = window.GetSpatialNode();
+    newNode.queryStamp = node.queryStamp;
+    if(true == node.indexed &&
+        node.cellLeft == newNode.cellLeft && node.cellTop == newNode.cellTop &&
+        node.cellRight == newNode.cellRight && node.cellBottom == newNode.cellBottom)
+    {
+        node = newNode;
+        return;
+    }
+
+    if(true == node.indexed)
+    {
+        RemoveFromCells(window, node);
+    }
+    else
+    {
+        m_Count++;
+    }
+    node = newNode;
+    AddToCells(window, node);
+}
+
+void SpatialIndex::Remove(PharaohWindow& window)
+{
+    SpatialNode& node = window.GetSpatialNode();
+    if(false == node.indexed)
+    {
+        return;
+    }
+
+    RemoveFromCells(window, node);
+    node.indexed = false;
+    m_Count--;
+}
+
+//--------------------------------------------------------------------------------
+// Queries
+//--------------------------------------------------------------------------------
+
+PharaohWindow* SpatialIndex::FindAt(int x, int y) const
+{
+    // other cells share the bucket, so everything in it is checked against the point
+    PharaohWindow* pTopmost = nullptr;
+    for(PharaohWindow* pWindow : GetBucket(GetCell(x), GetCell(y)))
+    {
+        const SpatialNode& node = pWindow->GetSpatialNode();
+        if(x >= node.x && x < node.right && y >= node.y && y < node.bottom &&
+            (pTopmost == nullptr || pWindow->GetStackingNode().rank > pTopmost->GetStackingNode().rank))
+        {
+            pTopmost = pWindow;
+        }
+    }
+    return pTopmost;
+}
+
+void SpatialIndex::FindOverlapping(int x, int y, unsigned int width, unsigned int height, vector<PharaohWindow*>& windows)
+{
+    windows.clear();
+    if(width == 0 || height == 0)
+    {
+        return;
+    }
+
+    int right = x + (int)width;
+    int bottom = y + (int)height;
+    int cellLeft = GetCell(x);
+    int cellTop = GetCell(y);
+    int cellRight = min(GetCell(right - 1), cellLeft + GRID_SIZE - 1);
+    int cellBottom = min(GetCell(bottom - 1), cellTop + GRID_SIZE - 1);
+
+    m_QueryStamp++;
+    for(int cellY = cellTop; cellY <= cellBottom; cellY++)
+    {
+        for(int cellX = cellLeft; cellX <= cellRight; cellX++)
+        {
+            for(PharaohWindow* pWindow : GetBucket(cellX, cellY))
+            {
+                SpatialNode& node = pWindow->GetSpatialNode();
+                if(node.queryStamp != m_QueryStamp &&
+                    node.x < right && x < node.right && node.y < bottom && y < node.bottom)
+                {
+                    node.queryStamp = m_QueryStamp;
+                    windows.push_back(pWindow);
+                }
+            }
+        }
+    }
+}
+
+size_t SpatialIndex::GetCount() const
+{
+    return m_Count;
+}
+
+//--------------------------------------------------------------------------------
+// Private helpers
+//--------------------------------------------------------------------------------
+
+int SpatialIndex::GetCell(int coordinate)
+{
+    // rounds down for negative coordinates too
+    return coordinate >> CELL_SHIFT;
+}
+
+vector<PharaohWindow*>& SpatialIndex::GetBucket(int cellX, int cellY)
+{
+    return m_Buckets[((cellY & (GRID_SIZE - 1)) << GRID_SHIFT) | (cellX & (GRID_SIZE - 1))];
+}
+
+const vector<PharaohWindow*>& SpatialIndex::GetBucket(int cellX, int cellY) const
+{
+    return m_Buckets[((cellY & (GRID_SIZE - 1)) << GRID_SHIFT) | (cellX & (GRID_SIZE - 1))];
+}
+
+void SpatialIndex::AddToCells(PharaohWindow& window, const SpatialNode& node)
+{
+    for(int cellY = node.cellTop; cellY <= node.cellBottom; cellY++)
+    {
+        for(int cellX = node.cellLeft; cellX <= node.cellRight; cellX++)
+        {
+            GetBucket(cellX, cellY).push_back(&window);
+        }
+    }
+}
+
+void SpatialIndex::RemoveFromCells(PharaohWindow& window, const SpatialNode& node)
+{
+    // buckets are short and unordered, so swap it with the last one
+    for(int cellY = node.cellTop; cellY <= node.cellBottom; cellY++)
+    {
+        for(int cellX = node.cellLeft; cellX <= node.cellRight; cellX++)
+        {
+            vector<PharaohWindow*>& bucket = GetBucket(cellX, cellY);
+            auto it = find(bucket.begin(), bucket.end(), &window);
+            if(it != bucket.end())
+            {
+                *it = bucket.back();
+                bucket.pop_back();
+            }
+        }
+    }
+}
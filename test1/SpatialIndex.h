@@ -0,0 +1,85 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef SPATIALINDEX_H_INCLUDED
+#define SPATIALINDEX_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Pharaoh
+{
+    class PharaohWindow;
+
+    //! \brief  Where a window is in the SpatialIndex. Each PharaohWindow has one.
+    struct SpatialNode
+    {
+        bool indexed = false;
+
+        // the frame, as last indexed
+        int x = 0;
+        int y = 0;
+        int right = 0;      // one past the last column
+        int bottom = 0;     // one past the last row
+
+        // the cells it's filed under
+        int cellLeft = 0;
+        int cellTop = 0;
+        int cellRight = 0;  // inclusive
+        int cellBottom = 0; // inclusive
+
+        // the last query that found it, so a window in several cells is reported once
+        uint32_t queryStamp = 0;
+    };
+
+    //! \brief  The frames of the mapped windows, filed by the screen cells they cover, so
+    //!         "which window is under this point" and "which windows overlap this area"
+    //!         look at the few windows nearby rather than every window, and never ask
+    //!         the server. The cells are hashed into a fixed table, so windows can be
+    //!         anywhere, even off screen, without the table growing.
+    //!         Windows that move within the cells they already cover cost nothing to
+    //!         update, which is most steps of a drag.
+    class SpatialIndex
+    {
+    public:
+        SpatialIndex();
+
+        //! \brief Add a mapped window, or bring an indexed one up to date.
+        void Update(PharaohWindow& window);
+
+        //! \brief Take a window out, before its frame is unmapped.
+        void Remove(PharaohWindow& window);
+
+        //! \brief  Get the topmost window whose frame is under a point, nullptr if there
+        //!         isn't one.
+        PharaohWindow* FindAt(int x, int y) const;
+
+        //! \brief Get every window whose frame overlaps an area, in no particular order.
+        void FindOverlapping(int x, int y, unsigned int width, unsigned int height, std::vector<PharaohWindow*>& windows);
+
+        size_t GetCount() const;
+
+    private:
+        static const int CELL_SHIFT = 8;        // 256 pixel cells
+        static const int GRID_SHIFT = 6;        // 64 x 64 buckets
+        static const int GRID_SIZE = 1 << GRID_SHIFT;
+
+        static int GetCell(int coordinate);
+        std::vector<PharaohWindow*>& GetBucket(int cellX, int cellY);
+        const std::vector<PharaohWindow*>& GetBucket(int cellX, int cellY) const;
+        void AddToCells(PharaohWindow& window, const SpatialNode& node);
+        void RemoveFromCells(PharaohWindow& window, const SpatialNode& node);
+
+        std::vector<std::vector<PharaohWindow*>> m_Buckets;
+        size_t m_Count = 0;
+        uint32_t m_QueryStamp = 0;
+    };
+}
+
+#endif
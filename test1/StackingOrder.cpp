@@ -0,0 +1,228 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "StackingOrder.h"
+#include "Window.h"
+
+using namespace Pharaoh;
+using namespace std;
+
+//--------------------------------------------------------------------------------
+// Add & Remove
+//--------------------------------------------------------------------------------
+
+void StackingOrder::Add(PharaohWindow& window)
+{
+    StackingNode& node = window.GetStackingNode();
+    if(true == node.stacked)
+    {
+        Remove(window);
+    }
+
+    // already on top on the server, there's nothing to send
+    node.pBelow = m_pTop;
+    node.pAbove = nullptr;
+    if(m_pTop != nullptr)
+    {
+        m_pTop->GetStackingNode().pAbove = &window;
+    }
+    else
+    {
+        m_pBottom = &window;
+    }
+    m_pTop = &window;
+    node.rank = ++m_TopRank;
+    node.stacked = true;
+    m_Count++;
+}
+
+void StackingOrder::Remove(PharaohWindow& window)
+{
+    StackingNode& node = window.GetStackingNode();
+    if(false == node.stacked)
+    {
+        return;
+    }
+
+    SetRestack(node, StackingNode::Restack_None);
+    Unlink(window);
+    node.stacked = false;
+    m_Count--;
+}
+
+//--------------------------------------------------------------------------------
+// Raise & Lower
+//--------------------------------------------------------------------------------
+
+void StackingOrder::Raise(PharaohWindow& window)
+{
+    StackingNode& node = window.GetStackingNode();
+    if(false == node.stacked || m_pTop == &window)
+    {
+        return;
+    }
+
+    Unlink(window);
+    node.pBelow = m_pTop;
+    node.pAbove = nullptr;
+    m_pTop->GetStackingNode().pAbove = &window;
+    m_pTop = &window;
+    node.rank = ++m_TopRank;
+    SetRestack(node, StackingNode::Restack_Raised);
+}
+
+void StackingOrder::Lower(PharaohWindow& window)
+{
+    StackingNode& node = window.GetStackingNode();
+    if(false == node.stacked || m_pBottom == &window)
+    {
+        return;
+    }
+
+    Unlink(window);
+    node.pBelow = nullptr;
+    node.pAbove = m_pBottom;
+    m_pBottom->GetStackingNode().pBelow = &window;
+    m_pBottom = &window;
+    node.rank = --m_BottomRank;
+    SetRestack(node, StackingNode::Restack_Lowered);
+}
+
+//--------------------------------------------------------------------------------
+// Queries
+//--------------------------------------------------------------------------------
+
+PharaohWindow* StackingOrder::GetTop() const
+{
+    return m_pTop;
+}
+
+PharaohWindow* StackingOrder::GetBottom() const
+{
+    return m_pBottom;
+}
+
+size_t StackingOrder::GetCount() const
+{
+    return m_Count;
+}
+
+//--------------------------------------------------------------------------------
+// Flush
+//--------------------------------------------------------------------------------
+
+void StackingOrder::Flush(Emperor::XBackend& backend)
+{
+    // Everything that hasn't moved is still in the right order relative to everything
+    // else that hasn't, so only the moved windows are restacked, each one next to a
+    // neighbour that's already in place. Raised windows go bottom up, each above the
+    // one below it, lowered ones top down, each below the one above it.
+    xcb_configure_window_value_list_t values = {};
+    const uint16_t siblingMask = XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE;
+
+    m_Restacking.clear();
+    for(PharaohWindow* pWindow = m_pTop; pWindow != nullptr && m_Restacking.size() < m_RaisedCount; pWindow = pWindow->GetStackingNode().pBelow)
+    {
+        if(pWindow->GetStackingNode().restack == StackingNode::Restack_Raised)
+        {
+            m_Restacking.push_back(pWindow);
+        }
+    }
+    for(auto it = m_Restacking.rbegin(); it != m_Restacking.rend(); ++it)
+    {
+        StackingNode& node = (*it)->GetStackingNode();
+        if(node.pBelow != nullptr)
+        {
+            values.sibling = node.pBelow->GetFrameWindow();
+            values.stack_mode = XCB_STACK_MODE_ABOVE;
+            backend.ConfigureWindow((*it)->GetFrameWindow(), siblingMask, values);
+        }
+        else
+        {
+            values.stack_mode = XCB_STACK_MODE_BELOW;
+            backend.ConfigureWindow((*it)->GetFrameWindow(), XCB_CONFIG_WINDOW_STACK_MODE, values);
+        }
+        node.restack = StackingNode::Restack_None;
+    }
+    m_RaisedCount = 0;
+
+    m_Restacking.clear();
+    for(PharaohWindow* pWindow = m_pBottom; pWindow != nullptr && m_Restacking.size() < m_LoweredCount; pWindow = pWindow->GetStackingNode().pAbove)
+    {
+        if(pWindow->GetStackingNode().restack == StackingNode::Restack_Lowered)
+        {
+            m_Restacking.push_back(pWindow);
+        }
+    }
+    for(auto it = m_Restacking.rbegin(); it != m_Restacking.rend(); ++it)
+    {
+        StackingNode& node = (*it)->GetStackingNode();
+        if(node.pAbove != nullptr)
+        {
+            values.sibling = node.pAbove->GetFrameWindow();
+            values.stack_mode = XCB_STACK_MODE_BELOW;
+            backend.ConfigureWindow((*it)->GetFrameWindow(), siblingMask, values);
+        }
+        else
+        {
+            values.stack_mode = XCB_STACK_MODE_ABOVE;
+            backend.ConfigureWindow((*it)->GetFrameWindow(), XCB_CONFIG_WINDOW_STACK_MODE, values);
+        }
+        node.restack = StackingNode::Restack_None;
+    }
+    m_LoweredCount = 0;
+}
+
+//--------------------------------------------------------------------------------
+// Private helpers
+//--------------------------------------------------------------------------------
+
+void StackingOrder::Unlink(PharaohWindow& window)
+{
+    StackingNode& node = window.GetStackingNode();
+    if(node.pBelow != nullptr)
+    {
+        node.pBelow->GetStackingNode().pAbove = node.pAbove;
+    }
+    else
+    {
+        m_pBottom = node.pAbove;
+    }
+    if(node.pAbove != nullptr)
+    {
+        node.pAbove->GetStackingNode().pBelow = node.pBelow;
+    }
+    else
+    {
+        m_pTop = node.pBelow;
+    }
+    node.pBelow = nullptr;
+    node.pAbove = nullptr;
+}
+
+void StackingOrder::SetRestack(StackingNode& node, StackingNode::Restack restack)
+{
+    if(node.restack == StackingNode::Restack_Raised)
+    {
+        m_RaisedCount--;
+    }
+    else if(node.restack == StackingNode::Restack_Lowered)
+    {
+        m_LoweredCount--;
+    }
+
+    node.restack = restack;
+    if(restack == StackingNode::Restack_Raised)
+    {
+        m_RaisedCount++;
+    }
+    else if(restack == StackingNode::Restack_Lowered)
+    {
+        m_LoweredCount++;
+    }
+}
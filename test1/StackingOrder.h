@@ -0,0 +1,90 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef STACKINGORDER_H_INCLUDED
+#define STACKINGORDER_H_INCLUDED
+
+#include <xcb/xcb.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "XBackend.h"
+
+namespace Pharaoh
+{
+    class PharaohWindow;
+
+    //! \brief  Where a window is in the StackingOrder. Each PharaohWindow has one, so
+    //!         moving a window never has to search for it.
+    struct StackingNode
+    {
+        enum Restack : uint8_t
+        {
+            Restack_None,
+            Restack_Raised,     // to go to the top, or just under windows raised after it
+            Restack_Lowered     // to go to the bottom, or just above windows lowered after it
+        };
+
+        PharaohWindow* pBelow = nullptr;
+        PharaohWindow* pAbove = nullptr;
+
+        // higher is further up. Not consecutive, but always in stacking order, so two
+        // windows can be compared without walking the list.
+        int64_t rank = 0;
+        bool stacked = false;
+        Restack restack = Restack_None;
+    };
+
+    //! \brief  The stacking order of the frames, bottom to top, as the window manager
+    //!         wants it. Raising and lowering only change it here; Flush then sends
+    //!         the server just enough to catch up, once per event batch. A window
+    //!         raised again and again in one batch moves once, a window already where
+    //!         it's wanted doesn't move at all, and every move is relative to a
+    //!         neighbour, so the others are never shuffled.
+    //!         Only mapped PharaohWindows are in the order. Other top-level windows
+    //!         (popups, drag outlines) stack themselves.
+    class StackingOrder
+    {
+    public:
+        //! \brief  Add a window whose frame has just gone on top of its siblings, as
+        //!         newly created and reused frames do.
+        void Add(PharaohWindow& window);
+
+        //! \brief Take a window out, before its frame is unmapped.
+        void Remove(PharaohWindow& window);
+
+        void Raise(PharaohWindow& window);
+        void Lower(PharaohWindow& window);
+
+        PharaohWindow* GetTop() const;
+        PharaohWindow* GetBottom() const;
+        size_t GetCount() const;
+
+        //! \brief Restack the frames on the server to match, if anything has moved.
+        void Flush(Emperor::XBackend& backend);
+
+    private:
+        void Unlink(PharaohWindow& window);
+        void SetRestack(StackingNode& node, StackingNode::Restack restack);
+
+        PharaohWindow* m_pBottom = nullptr;
+        PharaohWindow* m_pTop = nullptr;
+        size_t m_Count = 0;
+        int64_t m_TopRank = 0;
+        int64_t m_BottomRank = 0;
+
+        // how many windows are waiting to be raised or lowered. Raised windows always sit
+        // at the top, lowered ones at the bottom, so Flush only looks that far.
+        size_t m_RaisedCount = 0;
+        size_t m_LoweredCount = 0;
+        std::vector<PharaohWindow*> m_Restacking;
+    };
+}
+
+#endif
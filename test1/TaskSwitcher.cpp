@@ -0,0 +1,321 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "TaskSwitcher.h"
+#include "Window.h"
+#include <algorithm>
+
+using namespace Pharaoh;
+using namespace std;
+
+// the longest side of a thumbnail, and the space round each one and round the lot
+static const unsigned int THUMBNAIL_SIZE = 160;
+static const unsigned int THUMBNAIL_PADDING = 8;
+static const unsigned int CELL_SIZE = THUMBNAIL_SIZE + 2 * THUMBNAIL_PADDING;
+static const unsigned int SWITCHER_MARGIN = 16;
+static const unsigned int MAX_ROWS = 4;
+
+static const uint32_t BACKGROUND_COLOUR = 0x202020;
+static const uint32_t HIGHLIGHT_COLOUR = 0x3c78c8;
+
+const size_t TaskSwitcher::NO_PAGE;
+
+//--------------------------------------------------------------------------------
+// Open & Close
+//--------------------------------------------------------------------------------
+
+xcb_window_t TaskSwitcher::Open(
+    Emperor::XBackend& backend,
+    xcb_window_t rootWindow,
+    const xcb_rectangle_t& monitor,
+    const vector<PharaohWindow*>& windows,
+    bool redirectWindows)
+{
+    m_Windows = windows;
+    m_RedirectWindows = redirectWindows;
+    m_Selected = (m_Windows.size() > 1) ? 1 : 0;
+
+    // as many columns as there are windows, or as fit across the monitor, and as many
+    // rows as that needs, up to a few. Any more windows are on later pages.
+    const unsigned int count = max((unsigned int)m_Windows.size(), 1u);
+    const int across = ((int)monitor.width - 2 * (int)SWITCHER_MARGIN) / (int)CELL_SIZE;
+    const int down = ((int)monitor.height - 2 * (int)SWITCHER_MARGIN) / (int)CELL_SIZE;
+    m_Columns = min(count, (unsigned int)max(across, 1));
+    unsigned int rows = min((count + m_Columns - 1) / m_Columns, (unsigned int)max(min(down, (int)MAX_ROWS), 1));
+    m_PerPage = m_Columns * rows;
+
+    m_Width = (uint16_t)(m_Columns * CELL_SIZE + 2 * SWITCHER_MARGIN);
+    m_Height = (uint16_t)(rows * CELL_SIZE + 2 * SWITCHER_MARGIN);
+    const int16_t x = (int16_t)(monitor.x + ((int)monitor.width - (int)m_Width) / 2);
+    const int16_t y = (int16_t)(monitor.y + ((int)monitor.height - (int)m_Height) / 2);
+
+    uint32_t values[3] =
+    {
+        BACKGROUND_COLOUR,
+        1,
+        XCB_EVENT_MASK_EXPOSURE
+    };
+    m_Window = backend.CreateWindow(
+        rootWindow,
+        x,
+        y,
+        m_Width,
+        m_Height,
+        XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK,
+        values);
+    backend.MapWindow(m_Window);
+    m_Picture = backend.CreateWindowPicture(m_Window);
+
+    // drawn at the end of the batch, and again whenever it's exposed
+    m_Page = NO_PAGE;
+    m_Exposed = true;
+    return m_Window;
+}
+
+PharaohWindow* TaskSwitcher::Close(Emperor::XBackend& backend)
+{
+    if(m_Window == XCB_WINDOW_NONE)
+    {
+        return nullptr;
+    }
+
+    ReleasePage(backend);
+    backend.FreePicture(m_Picture);
+    backend.DestroyWindow(m_Window);
+    m_Picture = 0;
+    m_Window = XCB_WINDOW_NONE;
+
+    PharaohWindow* pSelected = (m_Selected < m_Windows.size()) ? m_Windows[m_Selected] : nullptr;
+    m_Windows.clear();
+    return pSelected;
+}
+
+bool TaskSwitcher::IsOpen() const
+{
+    return m_Window != XCB_WINDOW_NONE;
+}
+
+xcb_window_t TaskSwitcher::GetWindow() const
+{
+    return m_Window;
+}
+
+//--------------------------------------------------------------------------------
+// Changes
+//--------------------------------------------------------------------------------
+
+void TaskSwitcher::SelectNext()
+{
+    if(false == m_Windows.empty())
+    {
+        m_Selected = (m_Selected + 1) % m_Windows.size();
+    }
+}
+
+void TaskSwitcher::Remove(Emperor::XBackend& backend, PharaohWindow& window)
+{
+    vector<PharaohWindow*>::iterator it = find(m_Windows.begin(), m_Windows.end(), &window);
+    if(it == m_Windows.end())
+    {
+        return;
+    }
+
+    // the windows after it all move up a slot, so the page on screen (if it's this one
+    // or a later one) is made again
+    size_t index = (size_t)(it - m_Windows.begin());
+    if(m_Page != NO_PAGE && index < (m_Page + 1) * m_PerPage)
+    {
+        ReleasePage(backend);
+    }
+
+    m_Windows.erase(it);
+    if(index < m_Selected || (m_Selected > 0 && m_Selected == m_Windows.size()))
+    {
+        m_Selected--;
+    }
+}
+
+bool TaskSwitcher::OnDamage(uint32_t damage)
+{
+    for(Thumbnail& thumbnail : m_Thumbnails)
+    {
+        if(thumbnail.damage == damage)
+        {
+            thumbnail.dirty = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskSwitcher::Invalidate()
+{
+    m_Exposed = true;
+}
+
+//--------------------------------------------------------------------------------
+// Drawing
+//--------------------------------------------------------------------------------
+
+void TaskSwitcher::Redraw(Emperor::XBackend& backend)
+{
+    if(m_Window == XCB_WINDOW_NONE)
+    {
+        return;
+    }
+
+    const size_t page = m_Selected / m_PerPage;
+    if(page != m_Page)
+    {
+        ShowPage(backend, page);
+    }
+
+    const size_t slot = m_Selected - page * m_PerPage;
+    if(true == m_Exposed)
+    {
+        xcb_rectangle_t all = { 0, 0, m_Width, m_Height };
+        backend.FillRectangle(m_Picture, BACKGROUND_COLOUR, all);
+        for(Thumbnail& thumbnail : m_Thumbnails)
+        {
+            thumbnail.dirty = true;
+        }
+        m_HighlightedSlot = slot;
+        m_Exposed = false;
+    }
+    else if(slot != m_HighlightedSlot)
+    {
+        // only the cells the highlight has moved between
+        if(m_HighlightedSlot < m_Thumbnails.size())
+        {
+            m_Thumbnails[m_HighlightedSlot].dirty = true;
+        }
+        if(slot < m_Thumbnails.size())
+        {
+            m_Thumbnails[slot].dirty = true;
+        }
+        m_HighlightedSlot = slot;
+    }
+
+    for(size_t i = 0; i < m_Thumbnails.size(); i++)
+    {
+        if(true == m_Thumbnails[i].dirty)
+        {
+            DrawThumbnail(backend, i);
+        }
+    }
+}
+
+void TaskSwitcher::ShowPage(Emperor::XBackend& backend, size_t page)
+{
+    ReleasePage(backend);
+
+    const size_t first = page * m_PerPage;
+    const size_t last = min(first + m_PerPage, m_Windows.size());
+    for(size_t i = first; i < last; i++)
+    {
+        // only while they're shown, the server copies what's on screen so there's
+        // something to draw straight away
+        Thumbnail thumbnail = {};
+        thumbnail.pWindow = m_Windows[i];
+        if(true == m_RedirectWindows)
+        {
+            backend.RedirectWindow(thumbnail.pWindow->GetFrameWindow());
+        }
+        thumbnail.damage = backend.CreateDamage(thumbnail.pWindow->GetFrameWindow());
+        NameContents(backend, thumbnail);
+        m_Thumbnails.push_back(thumbnail);
+    }
+    m_Page = page;
+    m_Exposed = true;
+}
+
+void TaskSwitcher::ReleasePage(Emperor::XBackend& backend)
+{
+    for(const Thumbnail& thumbnail : m_Thumbnails)
+    {
+        backend.DestroyDamage(thumbnail.damage);
+        backend.FreePicture(thumbnail.picture);
+        if(true == m_RedirectWindows)
+        {
+            backend.UnredirectWindow(thumbnail.pWindow->GetFrameWindow());
+        }
+    }
+    m_Thumbnails.clear();
+    m_Page = NO_PAGE;
+}
+
+void TaskSwitcher::NameContents(Emperor::XBackend& backend, Thumbnail& thumbnail)
+{
+    unsigned int width, height;
+    unsigned int left, top, right, bottom;
+    thumbnail.pWindow->GetSize(width, height);
+    thumbnail.pWindow->GetFrameExtents(left, top, right, bottom);
+    thumbnail.frameWidth = width + left + right;
+    thumbnail.frameHeight = height + top + bottom;
+    thumbnail.picture = backend.CreateContentsPicture(thumbnail.pWindow->GetFrameWindow());
+
+    // shrunk to fit, but never enlarged
+    const unsigned int longest = max(max(thumbnail.frameWidth, thumbnail.frameHeight), 1u);
+    if(longest > THUMBNAIL_SIZE)
+    {
+        backend.SetPictureScale(thumbnail.picture, THUMBNAIL_SIZE, longest);
+        thumbnail.width = (uint16_t)max(thumbnail.frameWidth * THUMBNAIL_SIZE / longest, 1u);
+        thumbnail.height = (uint16_t)max(thumbnail.frameHeight * THUMBNAIL_SIZE / longest, 1u);
+    }
+    else
+    {
+        thumbnail.width = (uint16_t)thumbnail.frameWidth;
+        thumbnail.height = (uint16_t)thumbnail.frameHeight;
+    }
+}
+
+void TaskSwitcher::DrawThumbnail(Emperor::XBackend& backend, size_t slot)
+{
+    Thumbnail& thumbnail = m_Thumbnails[slot];
+    thumbnail.dirty = false;
+
+    // a resized window has new contents, the picture still has the old ones
+    unsigned int width, height;
+    unsigned int left, top, right, bottom;
+    thumbnail.pWindow->GetSize(width, height);
+    thumbnail.pWindow->GetFrameExtents(left, top, right, bottom);
+    if(width + left + right != thumbnail.frameWidth || height + top + bottom != thumbnail.frameHeight)
+    {
+        backend.FreePicture(thumbnail.picture);
+        NameContents(backend, thumbnail);
+    }
+
+    // anything the window draws from now on is reported again
+    backend.SubtractDamage(thumbnail.damage);
+
+    const xcb_rectangle_t cell = GetCell(slot);
+    backend.FillRectangle(m_Picture, (slot == m_HighlightedSlot) ? HIGHLIGHT_COLOUR : BACKGROUND_COLOUR, cell);
+    backend.CompositePicture(
+        thumbnail.picture,
+        m_Picture,
+        0,
+        0,
+        (int16_t)(cell.x + (cell.width - thumbnail.width) / 2),
+        (int16_t)(cell.y + (cell.height - thumbnail.height) / 2),
+        thumbnail.width,
+        thumbnail.height);
+}
+
+xcb_rectangle_t TaskSwitcher::GetCell(size_t slot) const
+{
+    const unsigned int column = (unsigned int)(slot % m_Columns);
+    const unsigned int row = (unsigned int)(slot / m_Columns);
+    xcb_rectangle_t cell =
+    {
+        (int16_t)(SWITCHER_MARGIN + column * CELL_SIZE),
+        (int16_t)(SWITCHER_MARGIN + row * CELL_SIZE),
+        (uint16_t)CELL_SIZE,
+        (uint16_t)CELL_SIZE
+    };
+    return cell;
+}
@@ -0,0 +1,111 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef TASKSWITCHER_H_INCLUDED
+#define TASKSWITCHER_H_INCLUDED
+
+#include <xcb/xcb.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "XBackend.h"
+
+namespace Pharaoh
+{
+    class PharaohWindow;
+
+    //! \brief  The Alt+Tab switcher: live thumbnails of the mapped windows in a grid in
+    //!         the middle of a monitor, with the one that'll get the focus highlighted.
+    //!         Window contents are named through Composite and scaled by the server
+    //!         with a Render transform, so no pixels ever come to us, and a thumbnail is
+    //!         only drawn again when Damage says its window has changed. More windows
+    //!         than fit are shown a page at a time, and only the page on screen has
+    //!         pictures and damage, and has its windows redirected off screen.
+    class TaskSwitcher
+    {
+    public:
+        //! \brief  Show the switcher, with the second window selected.
+        //! \param backend The X server to use.
+        //! \param rootWindow The window to put the switcher on.
+        //! \param monitor The monitor to put it in the middle of.
+        //! \param windows The windows to switch between, the current one first.
+        //! \param redirectWindows false if the windows are redirected already, by the
+        //!         compositor.
+        //! \return The switcher's window.
+        xcb_window_t Open(
+            Emperor::XBackend& backend,
+            xcb_window_t rootWindow,
+            const xcb_rectangle_t& monitor,
+            const std::vector<PharaohWindow*>& windows,
+            bool redirectWindows);
+
+        //! \brief  Hide the switcher, giving back everything it made on the server.
+        //! \return The window that was selected, nullptr if there's none left.
+        PharaohWindow* Close(Emperor::XBackend& backend);
+
+        bool IsOpen() const;
+        xcb_window_t GetWindow() const;
+
+        //! \brief Move the selection on to the next window, round to the first after the last.
+        void SelectNext();
+
+        //! \brief Take a window out, before its frame is unmapped.
+        void Remove(Emperor::XBackend& backend, PharaohWindow& window);
+
+        //! \brief  Note that a window's contents have changed.
+        //! \return false if the damage isn't one of the thumbnails'.
+        bool OnDamage(uint32_t damage);
+
+        //! \brief Draw everything again, the switcher's window has been exposed.
+        void Invalidate();
+
+        //! \brief Draw whatever has changed since last time, once per event batch.
+        void Redraw(Emperor::XBackend& backend);
+
+    private:
+        struct Thumbnail
+        {
+            PharaohWindow* pWindow;
+            uint32_t picture;
+            uint32_t damage;
+            unsigned int frameWidth;    // the frame's size when the picture was named
+            unsigned int frameHeight;
+            uint16_t width;             // once scaled
+            uint16_t height;
+            bool dirty;
+        };
+
+        void ShowPage(Emperor::XBackend& backend, size_t page);
+        void ReleasePage(Emperor::XBackend& backend);
+        void NameContents(Emperor::XBackend& backend, Thumbnail& thumbnail);
+        void DrawThumbnail(Emperor::XBackend& backend, size_t slot);
+        xcb_rectangle_t GetCell(size_t slot) const;
+
+        static const size_t NO_PAGE = (size_t)-1;
+
+        xcb_window_t m_Window = XCB_WINDOW_NONE;
+        uint32_t m_Picture = 0;
+        uint16_t m_Width = 0;
+        uint16_t m_Height = 0;
+        unsigned int m_Columns = 1;
+        size_t m_PerPage = 1;
+        bool m_RedirectWindows = true;
+
+        std::vector<PharaohWindow*> m_Windows;
+        size_t m_Selected = 0;
+
+        // the page on screen, slot by slot, and what's drawn on it
+        std::vector<Thumbnail> m_Thumbnails;
+        size_t m_Page = NO_PAGE;
+        size_t m_HighlightedSlot = 0;
+        bool m_Exposed = false;
+    };
+}
+
+#endif
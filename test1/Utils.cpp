@@ -139,5 +139,93 @@ string XRequestCodeToString(unsigned char request_code)
       "GetModifierMapping",
       "NoOperation",
   };
+  if(request_code >= sizeof(X_REQUEST_CODE_NAMES) / sizeof(X_REQUEST_CODE_NAMES[0]))
+  {
+      return "Extension request";
+  }
   return X_REQUEST_CODE_NAMES[request_code];
 }
+
+//--------------------------------------------------------------------------------
+// Convert the X error code to a string.
+//--------------------------------------------------------------------------------
+string XErrorCodeToString(unsigned char error_code)
+{
+  static const char* const X_ERROR_CODE_NAMES[] = 
+  {
+      "Success",
+      "BadRequest",
+      "BadValue",
+      "BadWindow",
+      "BadPixmap",
+      "BadAtom",
+      "BadCursor",
+      "BadFont",
+      "BadMatch",
+      "BadDrawable",
+      "BadAccess",
+      "BadAlloc",
+      "BadColor",
+      "BadGC",
+      "BadIDChoice",
+      "BadName",
+      "BadLength",
+      "BadImplementation",
+  };
+  if(error_code >= sizeof(X_ERROR_CODE_NAMES) / sizeof(X_ERROR_CODE_NAMES[0]))
+  {
+      return "Extension error";
+  }
+  return X_ERROR_CODE_NAMES[error_code];
+}
+
+//--------------------------------------------------------------------------------
+// Convert the X event type to a string.
+//--------------------------------------------------------------------------------
+string XEventTypeToString(unsigned char event_type)
+{
+  static const char* const X_EVENT_TYPE_NAMES[] = 
+  {
+      "Error",
+      "Reply",
+      "KeyPress",
+      "KeyRelease",
+      "ButtonPress",
+      "ButtonRelease",
+      "MotionNotify",
+      "EnterNotify",
+      "LeaveNotify",
+      "FocusIn",
+      "FocusOut",
+      "KeymapNotify",
+      "Expose",
+      "GraphicsExpose",
+      "NoExpose",
+      "VisibilityNotify",
+      "CreateNotify",
+      "DestroyNotify",
+      "UnmapNotify",
+      "MapNotify",
+      "MapRequest",
+      "ReparentNotify",
+      "ConfigureNotify",
+      "ConfigureRequest",
+      "GravityNotify",
+      "ResizeRequest",
+      "CirculateNotify",
+      "CirculateRequest",
+      "PropertyNotify",
+      "SelectionClear",
+      "SelectionRequest",
+      "SelectionNotify",
+      "ColormapNotify",
+      "ClientMessage",
+      "MappingNotify",
+      "GenericEvent",
+  };
+  if(event_type >= sizeof(X_EVENT_TYPE_NAMES) / sizeof(X_EVENT_TYPE_NAMES[0]))
+  {
+      return "Extension event";
+  }
+  return X_EVENT_TYPE_NAMES[event_type];
+}
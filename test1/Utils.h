@@ -12,5 +12,7 @@
 #include <string>
 
 std::string XRequestCodeToString(unsigned char request_code);
+std::string XErrorCodeToString(unsigned char error_code);
+std::string XEventTypeToString(unsigned char event_type);
 
 #endif
\ No newline at end of file
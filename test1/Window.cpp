@@ -7,8 +7,7 @@
 *********************************************************************************/
 
 #include "Window.h"
-#include <X11/Xutil.h>
-#include <iostream>
+#include <string>
 
 using namespace std;
 using namespace Pharaoh;
@@ -25,286 +24,84 @@ const unsigned int CLIENT_HOTCORNER = 12;
 //--------------------------------------------------------------------------------
 // ctor
 //--------------------------------------------------------------------------------
-PharaohWindow::PharaohWindow(Display* pXDisplay, Window rootWindow, Window clientWindow)
-    : m_pXDisplay(pXDisplay)
-    , m_RootWindow(rootWindow)
-    , m_ClientWindow(clientWindow)
+PharaohWindow::PharaohWindow(
+    Emperor::LogCallback& logger,
+    Emperor::XBackend& backend,
+    xcb_window_t rootWindow,
+    xcb_window_t clientWindow)
+    : ReparentingWindow("Window " + to_string(clientWindow), logger, backend, rootWindow, clientWindow)
 {
+    SetFrameExtents(CLIENT_INSET, CLIENT_YOFFSET, CLIENT_INSET, CLIENT_INSET);
 }
 
 PharaohWindow::PharaohWindow(
-    Display* pXDisplay, 
-    Window rootWindow, 
-    Window clientWindow, 
+    Emperor::LogCallback& logger,
+    Emperor::XBackend& backend,
+    xcb_window_t rootWindow,
+    xcb_window_t clientWindow,
     int x, 
     int y, 
     unsigned int width, 
     unsigned int height)
-    : m_pXDisplay(pXDisplay)
-    , m_RootWindow(rootWindow)
-    , m_ClientWindow(clientWindow)
-    , m_X(x)
-    , m_Y(y)
-    , m_Width(width)
-    , m_Height(height)
+    : ReparentingWindow("Window " + to_string(clientWindow), logger, backend, rootWindow, clientWindow, x, y, width, height)
 {
+    SetFrameExtents(CLIENT_INSET, CLIENT_YOFFSET, CLIENT_INSET, CLIENT_INSET);
 }
 
 //--------------------------------------------------------------------------------
-// Configure
+// Decorations
 //--------------------------------------------------------------------------------
-void PharaohWindow::Configure(XWindowChanges& windowChanges, unsigned int valueMask)
+void PharaohWindow::OnFrameCreated()
 {
-    // store position and size
-    m_X = windowChanges.x;
-    m_Y = windowChanges.y;
-    m_Width = windowChanges.width;
-    m_Height = windowChanges.height;
-
-    // if the window is already mapped, re-configure the parent frame
-    if(true == m_IsMapped)
-    {
-        XConfigureWindow(m_pXDisplay, m_FrameWindow, valueMask, &windowChanges);
-        // TODO: check error codes
-    }
-
-    // grant request
-    XConfigureWindow(m_pXDisplay, m_ClientWindow, valueMask, &windowChanges);
-
-}
+    Emperor::XBackend& backend = GetBackend();
+    xcb_window_t frameWindow = GetFrameWindow();
+    xcb_window_t clientWindow = GetClientWindow();
 
-//--------------------------------------------------------------------------------
-// Map & Unmap
-//--------------------------------------------------------------------------------
-void PharaohWindow::Map(set<Window>& decorationWindows)
-{
-    if(true == m_IsMapped)
+    // colour the frame
+    uint32_t frameMask = XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL;
+    uint32_t frameValues[2] =
     {
-        return;
-    }
-
-    // Retrieve attributes of the window to frame
-    XWindowAttributes windowAttributes;
-    XGetWindowAttributes(m_pXDisplay, m_ClientWindow, &windowAttributes); // TODO: check return codes!
-
-    // Create frame
-    m_FrameWindow = XCreateSimpleWindow(
-        m_pXDisplay,
-        m_RootWindow,
-        windowAttributes.x,
-        windowAttributes.y,
-        windowAttributes.width + (CLIENT_INSET * 2),
-        windowAttributes.height + CLIENT_YOFFSET + CLIENT_INSET,
-        BORDER_WIDTH,
-        BORDER_COLOUR,
-        BG_COLOUR);
-    decorationWindows.emplace(m_FrameWindow);
-
-    // save the window size
-    m_Width = windowAttributes.width;
-    m_Height = windowAttributes.height;
-
-    // select events on the frame
-    XSelectInput(
-        m_pXDisplay,
-        m_FrameWindow,
-        SubstructureRedirectMask | SubstructureNotifyMask);
-
-    // Add client to save set, so that it will be restored and kept alive if we crash
-    XAddToSaveSet(m_pXDisplay, m_ClientWindow);
-
-    // reparent the client window to the frame
-    XReparentWindow(
-        m_pXDisplay,
-        m_ClientWindow,
-        m_FrameWindow,
-        CLIENT_INSET, 
-        CLIENT_YOFFSET); // offset of client window within the frame
-
-    // map the frame
-    XMapWindow(m_pXDisplay, m_FrameWindow);
-
-    // grab universal window management actions on the client window
-    //   a. Move windows with alt + left button.
-    // XGrabButton(
-    //     m_pXDisplay,
-    //     Button1,
-    //     Mod1Mask,
-    //     m_ClientWindow,
-    //     false,
-    //     ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-    //     GrabModeAsync,
-    //     GrabModeAsync,
-    //     None,
-    //     None);
-    //   b. Resize windows with alt + right button.
-    // XGrabButton(
-    //     m_pXDisplay,
-    //     Button3,
-    //     Mod1Mask,
-    //     m_ClientWindow,
-    //     false,
-    //     ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-    //     GrabModeAsync,
-    //     GrabModeAsync,
-    //     None,
-    //     None);
-    //   c. Kill windows with alt + f4.
-    XGrabKey(
-        m_pXDisplay,
-        XKeysymToKeycode(m_pXDisplay, XK_F4),
-        Mod1Mask,
-        m_ClientWindow,
-        false,
-        GrabModeAsync,
-        GrabModeAsync);
-    //   d. Switch windows with alt + tab.
-    XGrabKey(
-        m_pXDisplay,
-        XKeysymToKeycode(m_pXDisplay, XK_Tab),
-        Mod1Mask,
-        m_ClientWindow,
-        false,
-        GrabModeAsync,
-        GrabModeAsync);
-
-
-    // // bring the client to the top & focus when clicked
-    // XGrabButton(
-    //     m_pXDisplay,
-    //     Button1,
-    //     None,
-    //     m_ClientWindow,
-    //     false,
-    //     ButtonPressMask,
-    //     GrabModeAsync,
-    //     GrabModeAsync,
-    //     None,
-    //     None);
-
-    // grab input on the frame itself for move and resize
-    XGrabButton(
-        m_pXDisplay,
-        Button1,
-        None,
-        m_FrameWindow,
-        false,
-        ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-        GrabModeAsync,
-        GrabModeAsync,
-        None,
-        None);
-
-    // finally map the client window
-    XMapWindow(m_pXDisplay, m_ClientWindow);
-
-    m_IsMapped = true;
-}
-
-void PharaohWindow::Unmap(set<Window>& decorationWindows)
-{
-    if(false == m_IsMapped)
+        BG_COLOUR,
+        BORDER_COLOUR
+    };
+    backend.ChangeWindowAttributes(frameWindow, frameMask, frameValues);
+    if(BORDER_WIDTH > 0)
     {
-        return;
+        xcb_configure_window_value_list_t borderValues = {};
+        borderValues.border_width = BORDER_WIDTH;
+        backend.ConfigureWindow(frameWindow, XCB_CONFIG_WINDOW_BORDER_WIDTH, borderValues);
     }
 
-    // unmap the frame
-    XUnmapWindow(m_pXDisplay, m_FrameWindow);
-
-    // reprent client window back to root window
-    XReparentWindow(
-        m_pXDisplay,
-        m_ClientWindow,
-        m_RootWindow,
-        0, 0); // offset of client window within root.
-
-    // remove client window from save set, as it is now unrelated to us.
-    XRemoveFromSaveSet(m_pXDisplay, m_ClientWindow);
-
-    // destroy the frame
-    XDestroyWindow(m_pXDisplay, m_FrameWindow);
-    decorationWindows.erase(m_FrameWindow);
-
-    m_IsMapped = false;
+    // a left click anywhere in the frame, the client included, comes to us first and
+    // freezes the pointer, so the window can be raised and focused before the click is
+    // let through to the client. Made once per frame, pooled frames keep it.
+    backend.GrabButton(
+        frameWindow,
+        XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION,
+        XCB_BUTTON_INDEX_1,
+        XCB_MOD_MASK_ANY,
+        XCB_GRAB_MODE_SYNC);
 }
 
-
-bool PharaohWindow::IsMapped() const
+uint32_t PharaohWindow::GetFrameEventMask() const
 {
-    return m_IsMapped;
-}
-
-//--------------------------------------------------------------------------------
-// Location
-//--------------------------------------------------------------------------------
-void PharaohWindow::SetLocation(int x, int y)
-{
-    m_X = x;
-    m_Y = y;
-
-    if(true == m_IsMapped)
-    {
-        XMoveWindow(m_pXDisplay, m_FrameWindow, x, y);
-    }
-}
-
-void PharaohWindow::GetLocation(int& x, int& y) const
-{
-    x = m_X;
-    y = m_Y;
-}
-
-//--------------------------------------------------------------------------------
-// Size
-//--------------------------------------------------------------------------------
-void PharaohWindow::SetSize(const unsigned int width, const unsigned int height)
-{
-    // TODO: have the client window's minimum & maximum sizes and test them before continuing
-
-    m_Width = width;
-    m_Height = height;
-
-    if(true == m_IsMapped)
-    {
-        // Resize frame.
-        XResizeWindow(m_pXDisplay, m_FrameWindow, m_Width + (CLIENT_INSET * 2), m_Height + (CLIENT_INSET + CLIENT_YOFFSET));
-
-        // Resize client window.
-        XResizeWindow(m_pXDisplay, m_ClientWindow, m_Width, m_Height);
-    }
-}
-
-void PharaohWindow::GetSize(unsigned int& width, unsigned int& height) const
-{
-    width = m_Width;
-    height = m_Height;
+    // presses on the frame itself start moves and resizes, with any button
+    return ReparentingWindow::GetFrameEventMask() |
+        XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION;
 }
 
 //--------------------------------------------------------------------------------
 // Others
 //--------------------------------------------------------------------------------
-void PharaohWindow::RaiseAndSetFocus()
-{
-    XRaiseWindow(m_pXDisplay, m_FrameWindow);
-    XSetInputFocus(m_pXDisplay, m_ClientWindow, RevertToPointerRoot, CurrentTime);
-}
-
-void PharaohWindow::Raise()
-{
-    XRaiseWindow(m_pXDisplay, m_FrameWindow);
-}
-
-Window PharaohWindow::GetFrameWindow() const
-{
-    return m_FrameWindow;
-}
-
 PharaohWindow::LocationInFrame PharaohWindow::GetPositionInFrame(const int x, const int y) const
 {
     LocationInFrame location = LocationInFrame_None;
 
-    bool xInsideClient = (x > (int)CLIENT_INSET && x < (int)(m_Width + CLIENT_INSET));
-    bool yInsideClient = (y > (int)CLIENT_YOFFSET && y < (int)(m_Height + CLIENT_YOFFSET));
+    unsigned int width, height;
+    GetSize(width, height);
+
+    bool xInsideClient = (x > (int)CLIENT_INSET && x < (int)(width + CLIENT_INSET));
+    bool yInsideClient = (y > (int)CLIENT_YOFFSET && y < (int)(height + CLIENT_YOFFSET));
     if(false == xInsideClient || false == yInsideClient)
     {
         // cursor is not inside the client frame
@@ -320,9 +117,9 @@ PharaohWindow::LocationInFrame PharaohWindow::GetPositionInFrame(const int x, co
             // cursor is within the resize frame, but where?
             // is it in any of the corners?
             bool xInsideLeftCorners = (x < (int)CLIENT_HOTCORNER);
-            bool xInsideRightCorners = (x > (int)(CLIENT_INSET + m_Width - (CLIENT_HOTCORNER - CLIENT_INSET)));
+            bool xInsideRightCorners = (x > (int)(CLIENT_INSET + width - (CLIENT_HOTCORNER - CLIENT_INSET)));
             bool yInsideTopCorners = (y < (int)CLIENT_HOTCORNER);
-            bool yInsideBottomCorners = (y > (int)(CLIENT_YOFFSET + m_Height - (CLIENT_HOTCORNER - CLIENT_INSET)));
+            bool yInsideBottomCorners = (y > (int)(CLIENT_YOFFSET + height - (CLIENT_HOTCORNER - CLIENT_INSET)));
             if(true == xInsideLeftCorners && true == yInsideTopCorners)
             {
                 location = LocationInFrame_ResizeFrameTopLeft;
@@ -343,9 +140,9 @@ PharaohWindow::LocationInFrame PharaohWindow::GetPositionInFrame(const int x, co
             {
                 // not in a corner, which part of the resize frame is it in?
                 bool xInsideLeftSide = (x < (int)CLIENT_INSET);
-                bool xInsideRightSide = (x > (int)(CLIENT_INSET + m_Width));
+                bool xInsideRightSide = (x > (int)(CLIENT_INSET + width));
                 bool yInsideTopSide = (y < (int)CLIENT_INSET);
-                bool yInsideBottomSide = (y > (int)(CLIENT_YOFFSET + m_Height));
+                bool yInsideBottomSide = (y > (int)(CLIENT_YOFFSET + height));
                 if(true == xInsideLeftSide)
                 {
                     location = LocationInFrame_ResizeFrameLeft;
@@ -368,4 +165,48 @@ PharaohWindow::LocationInFrame PharaohWindow::GetPositionInFrame(const int x, co
     }
 
     return location;
-}
\ No newline at end of file
+}
+
+StackingNode& PharaohWindow::GetStackingNode()
+{
+    return m_StackingNode;
+}
+
+const StackingNode& PharaohWindow::GetStackingNode() const
+{
+    return m_StackingNode;
+}
+
+SpatialNode& PharaohWindow::GetSpatialNode()
+{
+    return m_SpatialNode;
+}
+
+const SpatialNode& PharaohWindow::GetSpatialNode() const
+{
+    return m_SpatialNode;
+}
+
+SnapNode& PharaohWindow::GetSnapNode()
+{
+    return m_SnapNode;
+}
+
+void PharaohWindow::SetRestoreSize(unsigned int width, unsigned int height)
+{
+    m_RestoreWidth = width;
+    m_RestoreHeight = height;
+}
+
+bool PharaohWindow::GetRestoreSize(unsigned int& width, unsigned int& height) const
+{
+    width = m_RestoreWidth;
+    height = m_RestoreHeight;
+    return m_RestoreWidth != 0 && m_RestoreHeight != 0;
+}
+
+void PharaohWindow::ClearRestoreSize()
+{
+    m_RestoreWidth = 0;
+    m_RestoreHeight = 0;
+}
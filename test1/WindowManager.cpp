@@ -6,14 +6,24 @@
 *
 *********************************************************************************/
 
-#include <X11/Xlib.h>
-#include <X11/Xutil.h>
+#include <xcb/xcb.h>
+#include <X11/keysym.h>
 #include "Utils.h"
+#include "AsyncLog.h"
 #include "WindowManager.h"
+#include "FakeXServer.h"
+#include "XcbBackend.h"
 #include <iostream>
 #include <functional>
 #include <algorithm>
 #include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
 
 using namespace Pharaoh;
 using namespace std;
@@ -23,14 +33,6 @@ using namespace std;
 //--------------------------------------------------------------------------------
 struct WindowManager::DragOperation
 {
-    enum DragType
-    {
-        DragType_Move,
-        DragType_ResizeHorizonal,
-        DragType_ResizeVertical,
-        DragType_ResizeAll
-    };
-
     int cursorStartX;
     int cursorStartY;
     int frameStartX;
@@ -41,6 +43,26 @@ struct WindowManager::DragOperation
     unsigned int frameMininumHeight;
 
     DragType dragType;
+    WindowPool::Handle window;
+
+    // the latest pointer position, applied on the next frame
+    int cursorX;
+    int cursorY;
+    bool pending;
+
+    // resizes of clients that support _NET_WM_SYNC_REQUEST wait for the client to
+    // finish painting the last size. 0 if the client doesn't.
+    uint32_t syncCounter = 0;
+    uint32_t syncAlarm = 0;
+    bool awaitingSync = false;
+    chrono::steady_clock::time_point syncRequestTime;
+
+    // only an outline follows the pointer, the window moves when the drag ends
+    bool wireframe = false;
+
+    // the window was snapped to fill some of a monitor, and gets its old size back
+    // when it's next moved
+    bool restoreSize = false;
 };
 
 //--------------------------------------------------------------------------------
@@ -48,7 +70,19 @@ struct WindowManager::DragOperation
 //--------------------------------------------------------------------------------
 
 WindowManager* WindowManager::m_pInstance = nullptr;
-bool WindowManager::m_WMDetected = false;
+
+// how many event batches to process between batch statistics reports
+const unsigned long EVENT_BATCH_REPORT_INTERVAL = 1000;
+
+// used to pace drags when the server can't tell us the real refresh rate
+const unsigned int DEFAULT_REFRESH_RATE = 60;
+
+// how long a resize waits for the client to repaint before carrying on without it
+const chrono::milliseconds SYNC_REQUEST_TIMEOUT(250);
+
+// the wireframe drag outline
+const unsigned int OUTLINE_THICKNESS = 2;
+const unsigned int OUTLINE_COLOUR = 0xffffff;
 
 //--------------------------------------------------------------------------------
 // ctor & dtor
@@ -57,13 +91,76 @@ bool WindowManager::m_WMDetected = false;
 WindowManager::WindowManager(int argc, char** argv)
     : m_argc(argc)
     , m_argv(argv)
+    , m_LogCallback(
+        [](const string& msg) { LOG_DEBUG << msg; },
+        [](const string& msg) { LOG_MESSAGE << msg; },
+        [](const string& msg) { LOG_WARNING << msg; },
+        [](const string& msg) { LOG_ERROR << msg; })
 {
     m_pInstance = this;
+
+    // command line options
+    for(int i = 1; i < m_argc; i++)
+    {
+        string option = m_argv[i];
+        if(option == "--record" && (i + 1) < m_argc)
+        {
+            m_RecordPath = m_argv[++i];
+        }
+        else if(option == "--replay" && (i + 1) < m_argc)
+        {
+            m_ReplayPath = m_argv[++i];
+        }
+        else if(option == "--stats" && (i + 1) < m_argc)
+        {
+            m_StatsPath = m_argv[++i];
+        }
+        else if(option == "--binary-log" && (i + 1) < m_argc)
+        {
+            m_BinaryLogPath = m_argv[++i];
+        }
+        else if(option == "--wireframe" && (i + 1) < m_argc)
+        {
+            // windows of this class (or instance) are dragged as an outline
+            m_WireframeClasses.insert(m_argv[++i]);
+        }
+        else if(option == "--bind" && (i + 1) < m_argc)
+        {
+            // e.g. --bind Super+Tab=next, --bind Alt+F4=none
+            string binding = m_argv[++i];
+            if(false == m_KeyBindings.Add(binding))
+            {
+                LOG_WARNING << "Ignoring key binding " << binding;
+            }
+        }
+        else if(option == "--frame-pool" && (i + 1) < m_argc)
+        {
+            // how many unused frames to keep for reuse, 0 to make every one afresh
+            m_Frames.SetMaxIdle(strtoul(m_argv[++i], nullptr, 10));
+        }
+        else if(option == "--composite")
+        {
+            // draw the windows ourselves, if the server lets us
+            m_Composite = true;
+        }
+        else if(option == "--headless")
+        {
+            m_Headless = true;
+        }
+        else
+        {
+            LOG_WARNING << "Ignoring unknown option " << option;
+        }
+    }
 }
 
 WindowManager::~WindowManager()
 {
-
+    if(m_BinaryLogFd != -1)
+    {
+        Emperor::LogBuffer::SetBinaryOutput(-1);
+        close(m_BinaryLogFd);
+    }
 }
 
 //--------------------------------------------------------------------------------
@@ -72,532 +169,1836 @@ WindowManager::~WindowManager()
 
 int WindowManager::Run()
 {
-    // open the X display to use. By passing nullptr (not specifying a
-    // display name) X will use the DISPLAY environment variable value.
-    m_pXDisplay = XOpenDisplay(nullptr);
-    if(m_pXDisplay == nullptr)
+    // the frame and widget log lines can be kept in binary form, for logdecode to read
+    if(false == m_BinaryLogPath.empty())
     {
-        // failed to open X display
-        cerr << "Failed to open X display" << endl;
-        return -1;
+        m_BinaryLogFd = open(m_BinaryLogPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(m_BinaryLogFd == -1)
+        {
+            LOG_ERROR << "Failed to open " << m_BinaryLogPath << " for the binary log";
+            return -1;
+        }
+        Emperor::LogBuffer::SetBinaryOutput(m_BinaryLogFd);
     }
 
-    // get the root window for the X display.
-    m_RootWindow = DefaultRootWindow(m_pXDisplay);
-
-    // set some protocol things
-    WM_PROTOCOLS = XInternAtom(m_pXDisplay, "WM_PROTOCOLS", false);
-    WM_DELETE_WINDOW = XInternAtom(m_pXDisplay, "WM_DELETE_WINDOW", false);
-
-    // attempt to initialise the window manager with X
-    // we require special permissions that only a single
-    // Window manager can get. Error-out if we're not the
-    // only one. Set the temporary error handler to catch
-    // this event during init.
-    int returnCode = -2;
-    XSetErrorHandler(&WindowManager::OnWMDetected);
-    XSelectInput(m_pXDisplay, m_RootWindow, SubstructureRedirectMask | SubstructureNotifyMask);
-    XSync(m_pXDisplay, false);
-
-    // was another window manager detected on this display?
-    if(false == m_WMDetected)
+    // a replay can run without a display, against an in-memory server
+    bool replaying = (false == m_ReplayPath.empty());
+    if(true == m_Headless && false == replaying)
     {
-        // initialisation successful, set the real error handler.
-        XSetErrorHandler(&WindowManager::OnXError);
-
-        // frame any existing top-level windows
-        XGrabServer(m_pXDisplay);
-
-        Window returnedRoot, returnedParent;
-        Window* pTopLevelWindows = nullptr;
-        unsigned int numberOfTopLevelWindows = -1;
-        XQueryTree(
-            m_pXDisplay,
-            m_RootWindow,
-            &returnedRoot,
-            &returnedParent,
-            &pTopLevelWindows,
-            &numberOfTopLevelWindows);
+        LOG_ERROR << "--headless only works with --replay";
+        return -1;
+    }
+    else if(true == m_Headless)
+    {
+        m_xBackend.reset(new FakeXServer());
+    }
+    else
+    {
+        // connect to the X server. By passing nullptr (not specifying a
+        // display name) XCB will use the DISPLAY environment variable value.
+        Emperor::XcbBackend* pXcbBackend = new Emperor::XcbBackend();
+        m_xBackend.reset(pXcbBackend);
+        if(false == pXcbBackend->Connect(nullptr))
+        {
+            // failed to open X display
+            LOG_ERROR << "Failed to open X display";
+            m_xBackend.reset();
+            return -1;
+        }
+    }
 
-        if(returnedRoot == m_RootWindow)
+    // A replay doesn't manage the display
+    int returnCode = Initialise(*m_xBackend, false == replaying);
+    Emperor::Logger::FlushThreadLog();
+    if(returnCode == 0)
+    {
+        if(true == replaying)
+        {
+            returnCode = ReplayTrace(m_ReplayPath);
+        }
+        else
         {
-            for(unsigned int i = 0; i < numberOfTopLevelWindows; i++)
+            // record the session if asked to
+            if(false == m_RecordPath.empty())
             {
-                // Retrieve attributes of the window to frame
-                XWindowAttributes windowAttributes;
-                XGetWindowAttributes(m_pXDisplay, pTopLevelWindows[i], &windowAttributes); // TODO: check return codes!
-
-                // create a window
-                PharaohWindow* pNewWindow = new PharaohWindow(
-                    m_pXDisplay, 
-                    m_RootWindow, 
-                    pTopLevelWindows[i],
-                    windowAttributes.x,
-                    windowAttributes.y,
-                    windowAttributes.width,
-                    windowAttributes.height);
-                m_Clients[pTopLevelWindows[i]] = unique_ptr<PharaohWindow>(pNewWindow);
-
-                // framing existing top-level windows - only frame if visible and doesn't set override_redirect
-                // TODO: override_redirect check should be moved to PharaohWindow::Map
-                if(windowAttributes.override_redirect || windowAttributes.map_state != IsViewable)
+                if(true == m_TraceWriter.Open(m_RecordPath))
                 {
-                    continue;
+                    LOG_MESSAGE << "Recording events to " << m_RecordPath;
+                }
+                else
+                {
+                    LOG_ERROR << "Failed to open " << m_RecordPath << " for recording";
                 }
-
-                pNewWindow->Map(m_DecorationWindows);
-                m_FramesToClients[pNewWindow->GetFrameWindow()] = pNewWindow;
             }
-        }
-        XFree(pTopLevelWindows);
-
-        XUngrabServer(m_pXDisplay);
 
-        // enter main even loop
-        returnCode = EventLoop();
-    }
-    else
-    {
-        cerr << "Detected another window manager on display " << XDisplayString(m_pXDisplay) << endl;
+            // enter main even loop
+            returnCode = EventLoop();
+        }
     }
-    
 
     // shutdown
-    XCloseDisplay(m_pXDisplay);
+    m_xBackend.reset();
 
     return returnCode;
 }
 
-
-//--------------------------------------------------------------------------------
-// main loop
-//--------------------------------------------------------------------------------
-
-int WindowManager::EventLoop()
+int WindowManager::Initialise(Emperor::XBackend& backend, bool manageDisplay)
 {
-    while(1)
+    m_pBackend = &backend;
+    m_RootWindow = m_pBackend->GetRootWindow();
+
+    // send everything we need to know up-front in one go, then collect the replies.
+    xcb_intern_atom_cookie_t protocolAtomCookie = m_pBackend->RequestAtom("WM_PROTOCOLS");
+    xcb_intern_atom_cookie_t deleteWindowAtomCookie = m_pBackend->RequestAtom("WM_DELETE_WINDOW");
+    xcb_intern_atom_cookie_t syncRequestAtomCookie = m_pBackend->RequestAtom("_NET_WM_SYNC_REQUEST");
+    xcb_intern_atom_cookie_t syncRequestCounterAtomCookie = m_pBackend->RequestAtom("_NET_WM_SYNC_REQUEST_COUNTER");
+    xcb_get_keyboard_mapping_cookie_t keyboardMappingCookie = m_KeySymbols.RequestMapping(*m_pBackend);
+    Emperor::XBackend::ExtensionCookie refreshRateCookie = m_pBackend->RequestRefreshRate();
+    Emperor::XBackend::ExtensionCookie monitorsCookie = m_pBackend->RequestMonitors();
+    xcb_get_geometry_cookie_t rootGeometryCookie = m_pBackend->RequestGeometry(m_RootWindow);
+
+    // attempt to initialise the window manager with X
+    // we require special permissions that only a single
+    // Window manager can get. Error-out if we're not the
+    // only one.
+    xcb_void_cookie_t redirectCookie = {};
+    if(true == manageDisplay)
     {
-        // wait for the next XEvent
-        XEvent event;
-        XNextEvent(m_pXDisplay, &event);
+        uint32_t rootEventMask = XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY;
+        redirectCookie = m_pBackend->RequestChangeWindowAttributesChecked(
+            m_RootWindow,
+            XCB_CW_EVENT_MASK,
+            &rootEventMask);
+    }
 
-        // dispatch
-        switch(event.type)
-        {
-    case CreateNotify:
-        OnCreateNotify(event.xcreatewindow);
-        break;
-        case ConfigureRequest:
-        OnConfigureRequest(event.xconfigurerequest);
-        break;
-    case MapRequest:
-        OnMapRequest(event.xmaprequest);
-        break;
-    case ReparentNotify:
-        OnReparentNotify(event.xreparent);
-        break;
-    case MapNotify:
-        OnMapNotify(event.xmap);
-        break;
-    case ConfigureNotify:
-        OnConfigureNotify(event.xconfigure);
-        break;
-    case UnmapNotify:
-        OnUnmapNotify(event.xunmap);
-        break;
-    case DestroyNotify:
-        OnDestroyNotify(event.xdestroywindow);
-        break;
-    case ButtonPress:
-        OnButtonPress(event.xbutton);
-            break;
-    case ButtonRelease:
-        OnButtonRelease(event.xbutton);
-            break;
-    case MotionNotify:
-        // skip any already pending motion events
-        while(XCheckTypedWindowEvent(
-        m_pXDisplay, event.xmotion.window, MotionNotify, &event)){}
-        OnMotionNotify(event.xmotion);
-            break;
-    case KeyPress:
-        OnKeyPress(event.xkey);
-            break;
-    case KeyRelease:
-        OnKeyRelease(event.xkey);
-        break;
-        default:
-            cout << "Event ignored." << endl;
-        break;
-        }
+    // set some protocol things
+    WM_PROTOCOLS = m_pBackend->ReceiveAtom(protocolAtomCookie);
+    WM_DELETE_WINDOW = m_pBackend->ReceiveAtom(deleteWindowAtomCookie);
+    _NET_WM_SYNC_REQUEST = m_pBackend->ReceiveAtom(syncRequestAtomCookie);
+    _NET_WM_SYNC_REQUEST_COUNTER = m_pBackend->ReceiveAtom(syncRequestCounterAtomCookie);
 
+    if(false == m_KeySymbols.ReceiveMapping(*m_pBackend, keyboardMappingCookie))
+    {
+        LOG_ERROR << "Failed to get the keyboard mapping";
     }
+    m_KeyBindings.Compile(m_KeySymbols);
 
+    // there's no point moving a window more often than the screen is redrawn
+    unsigned int refreshRate = m_pBackend->ReceiveRefreshRate(refreshRateCookie);
+    if(refreshRate == 0)
+    {
+        refreshRate = DEFAULT_REFRESH_RATE;
+    }
+    m_FramePeriod = chrono::duration_cast<MainLoop::Clock::duration>(chrono::nanoseconds(1000000000 / refreshRate));
+    LOG_MESSAGE << "Drawing drags at " << refreshRate << "Hz";
+
+    // where windows can be snapped to. Without RandR the whole screen is one monitor.
+    vector<xcb_rectangle_t> monitors;
+    bool haveMonitors = m_pBackend->ReceiveMonitors(monitorsCookie, monitors);
+    Emperor::XBackend::WindowGeometry rootGeometry;
+    bool haveRootGeometry = m_pBackend->ReceiveGeometry(rootGeometryCookie, rootGeometry);
+    if(true == haveRootGeometry && false == haveMonitors)
+    {
+        monitors.push_back({ 0, 0, rootGeometry.width, rootGeometry.height });
+    }
+    m_Snap.SetMonitors(monitors);
+    LOG_MESSAGE << "Snapping windows to " << monitors.size() << " monitor(s)";
 
-    return 0;
-}
-
-void WindowManager::OnCreateNotify(const XCreateWindowEvent& e)
-{
-    // we need to ignore this if it's a result of framing a window
-    if(m_DecorationWindows.find(e.window) == m_DecorationWindows.end() &&
-        m_Clients.find(e.window) == m_Clients.end())
+    if(false == manageDisplay)
     {
-        PharaohWindow* pNewWindow = new PharaohWindow(m_pXDisplay, m_RootWindow, e.window);
-        m_Clients[e.window] = unique_ptr<PharaohWindow>(pNewWindow);
+        m_StartupRoundTrips = m_pBackend->GetRoundTripCount();
+        return 0;
     }
-}
 
-void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e)
-{
-    XWindowChanges changes;
+    // was another window manager detected on this display?
+    uint8_t redirectError = m_pBackend->ReceiveErrorCode(redirectCookie);
+    if(redirectError != 0)
+    {
+        if(redirectError == XCB_ACCESS)
+        {
+            LOG_ERROR << "Detected another window manager on display";
+        }
+        else
+        {
+            LOG_ERROR << "Failed to select the root window events: " << XErrorCodeToString(redirectError);
+        }
+        return -2;
+    }
 
-    // copy fields from e to changes
-    changes.x = e.x;
-    changes.y = e.y;
-    changes.width = e.width;
-    changes.height = e.height;
-    changes.border_width = e.border_width;
-    changes.sibling = e.above;
-    changes.stack_mode = e.detail;
+    GrabRootInput();
 
-    auto it = m_Clients.find(e.window);
-    if(it != m_Clients.end())
+    // the window contents Alt+Tab shows. Windows are only redirected off screen while
+    // they're in the switcher, or by the compositor.
+    m_Thumbnails = m_pBackend->InitialiseThumbnails();
+    if(false == m_Thumbnails)
     {
-        it->second->Configure(changes, e.value_mask);
+        LOG_MESSAGE << "No Composite, Render or Damage, Alt+Tab won't show thumbnails";
     }
-    else
+
+    // and, if asked, the windows themselves, from the overlay
+    if(true == m_Composite)
     {
-        XConfigureWindow(m_pXDisplay, e.window, e.value_mask, &changes);
+        xcb_window_t overlay = XCB_WINDOW_NONE;
+        if(true == m_Thumbnails && true == haveRootGeometry)
+        {
+            overlay = m_pBackend->StartCompositing();
+        }
+        if(overlay == XCB_WINDOW_NONE)
+        {
+            LOG_WARNING << "Can't composite on this display, the server will go on drawing the windows";
+        }
+        else
+        {
+            m_xCompositor.reset(new Compositor(*m_pBackend, m_RootWindow, overlay, rootGeometry.width, rootGeometry.height));
+            LOG_MESSAGE << "Compositing";
+        }
     }
-}
 
-void WindowManager::OnConfigureNotify(const XConfigureEvent& e)
-{
+    // frame any existing top-level windows
+    AdoptExistingWindows();
+    m_StartupRoundTrips = m_pBackend->GetRoundTripCount();
+    return 0;
 }
 
-void WindowManager::OnMapRequest(const XMapRequestEvent& e)
+void WindowManager::GrabRootInput()
 {
-    auto it = m_Clients.find(e.window);
-    if(it != m_Clients.end())
+    // the shortcuts work whichever window has the focus, and alt + left or right button
+    // moves or resizes whichever window is under the pointer. Grabbed once on the root,
+    // so windows cost nothing to map.
+    m_KeyBindings.Grab(*m_pBackend, m_RootWindow);
+    for(uint8_t button : { XCB_BUTTON_INDEX_1, XCB_BUTTON_INDEX_3 })
     {
-        it->second->Map(m_DecorationWindows);
-        m_FramesToClients[it->second->GetFrameWindow()] = it->second.get();
+        for(uint16_t lockModifiers : KeyBindings::LOCK_MODIFIERS)
+        {
+            m_pBackend->GrabButton(
+                m_RootWindow,
+                XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION,
+                button,
+                XCB_MOD_MASK_1 | lockModifiers,
+                XCB_GRAB_MODE_ASYNC);
+        }
     }
 }
 
-void WindowManager::OnReparentNotify(const XReparentEvent& e)
-{
-}
-
-void WindowManager::OnMapNotify(const XMapEvent& e)
-{
-}
-
-void WindowManager::OnUnmapNotify(const XUnmapEvent& e)
+void WindowManager::AdoptExistingWindows()
 {
-    // ignore if we don't manage this window
-    auto frameIt = m_Clients.find(e.window);
-    if(frameIt == m_Clients.end())
+    // Nothing in here waits on the server more than twice, once for the list of windows
+    // and once for everything about them, however many there are. The framing requests
+    // and the ungrab then go out together in one flush, so the display is frozen for
+    // as little time as it can be.
+    auto startTime = chrono::steady_clock::now();
+    m_pBackend->GrabServer();
+
+    vector<xcb_window_t> topLevelWindows;
+    if(false == m_pBackend->ReceiveChildren(m_pBackend->RequestChildren(m_RootWindow), topLevelWindows))
     {
-        cout << "Ignore UnmapNotify for non-client window " << e.window << endl;
+        m_pBackend->UngrabServer();
+        m_pBackend->Flush();
         return;
     }
 
-    // ignore the event if it was triggered by reparenting a window that was mapped
-    // before the window manager started.
-    if(e.event == m_RootWindow)
+    // Request the attributes and geometry of every window before waiting on any of them,
+    // so the whole lot costs a single round trip.
+    vector<xcb_get_window_attributes_cookie_t> attributeCookies(topLevelWindows.size());
+    vector<xcb_get_geometry_cookie_t> geometryCookies(topLevelWindows.size());
+    for(size_t i = 0; i < topLevelWindows.size(); i++)
     {
-        cout << "Ignore UnmapNotify for reparented pre-existing window " << e.window << endl;
-        return;
+        attributeCookies[i] = m_pBackend->RequestAttributes(topLevelWindows[i]);
+        geometryCookies[i] = m_pBackend->RequestGeometry(topLevelWindows[i]);
     }
 
-    // unframe the window if we do manage it
-    m_FramesToClients.erase(frameIt->second->GetFrameWindow());
-    frameIt->second->Unmap(m_DecorationWindows);
-}
-
-void WindowManager::OnDestroyNotify(const XDestroyWindowEvent& e)
-{
-    auto it = m_Clients.find(e.window);
-    if(it != m_Clients.end())
+    for(size_t i = 0; i < topLevelWindows.size(); i++)
     {
-        if(it->second->IsMapped())
+        Emperor::XBackend::WindowAttributes attributes;
+        Emperor::XBackend::WindowGeometry geometry;
+        bool gotAttributes = m_pBackend->ReceiveAttributes(attributeCookies[i], attributes);
+        bool gotGeometry = m_pBackend->ReceiveGeometry(geometryCookies[i], geometry);
+        if(false == gotAttributes || false == gotGeometry)
+        {
+            // window has gone away in the meantime
+            continue;
+        }
+
+        // the compositor draws all of them, bottom to top, framed or not
+        if(m_xCompositor.get() != nullptr)
+        {
+            m_xCompositor->AddExisting(topLevelWindows[i], geometry, attributes.mapState == XCB_MAP_STATE_VIEWABLE);
+        }
+
+        // only frame windows that are visible and don't set override_redirect. The others
+        // are taken on if they ever ask to be mapped.
+        if(true == attributes.overrideRedirect)
+        {
+            continue;
+        }
+        if(attributes.mapState != XCB_MAP_STATE_VIEWABLE)
         {
-            m_FramesToClients.erase(it->second->GetFrameWindow());
-            it->second->Unmap(m_DecorationWindows);
+            m_UnmanagedGeometry[topLevelWindows[i]] = geometry;
+            continue;
         }
-        m_Clients.erase(it);
+
+        PharaohWindow* pNewWindow = m_WindowPool.Create(
+            m_LogCallback,
+            *m_pBackend,
+            m_RootWindow,
+            topLevelWindows[i],
+            geometry.x,
+            geometry.y,
+            geometry.width,
+            geometry.height);
+        m_Windows.Insert(topLevelWindows[i], WindowRole_Client, pNewWindow);
+        MapWindow(*pNewWindow);
+        m_AdoptedWindows++;
     }
+
+    m_pBackend->UngrabServer();
+    m_pBackend->Flush();
+
+    m_AdoptionTime = chrono::steady_clock::now() - startTime;
+    LOG_MESSAGE << "Adopted " << m_AdoptedWindows << " of " << topLevelWindows.size() << " existing windows in "
+        << chrono::duration<double, milli>(m_AdoptionTime).count() << "ms";
 }
 
+
 //--------------------------------------------------------------------------------
-// User input events
+// main loop
 //--------------------------------------------------------------------------------
 
-void WindowManager::OnButtonPress(const XButtonEvent& e)
+int WindowManager::EventLoop()
 {
-    auto frameIt = m_Clients.find(e.window);
-    if(frameIt != m_Clients.end())
+    int returnCode = 0;
+
+    // from here on drags are drawn by a timer, rather than after each batch
+    m_FramePacing = true;
+
+    // X events. The connection's descriptor only wakes us, the events are read in
+    // ProcessEvents before the loop goes back to sleep.
+    m_MainLoop.AddFileDescriptor(
+        m_pBackend->GetFileDescriptor(),
+        EPOLLIN,
+        [this](uint32_t events) { ProcessEvents(); });
+
+    // XCB may have queued events while waiting for a reply outside of ProcessEvents
+    // (in a timer, say), and those won't make the descriptor readable. Always drain
+    // and flush before sleeping.
+    m_MainLoop.SetPrepareCallback([this, &returnCode]()
     {
-        // get the frame & save the start position
-        m_DragCursorStartX = e.x_root;
-        m_DragCursorStartY = e.y_root;
-
-        cout << "Mouse start pos (x, y) = " << to_string(m_DragCursorStartX) << ", " << to_string(m_DragCursorStartY) << endl;
+        ProcessEvents();
+        if(true == m_pBackend->HasError())
+        {
+            // the connection has gone
+            LOG_ERROR << "Lost the connection to the X server";
+            returnCode = -3;
+            m_MainLoop.Stop();
+        }
+    });
 
-        // save the initial window information
-        int x, y;
-        unsigned int width, height;
+    // shut down cleanly when asked. The save-set hands our clients back to the root
+    // window once the connection closes.
+    for(int signalNumber : { SIGTERM, SIGINT, SIGHUP })
+    {
+        m_MainLoop.AddSignal(signalNumber, [this, signalNumber]()
+        {
+            LOG_MESSAGE << "Received signal " << signalNumber << ", shutting down";
+            m_MainLoop.Stop();
+        });
+    }
 
-        frameIt->second->GetLocation(x, y);
-        frameIt->second->GetSize(width, height);
+    // dump the statistics on demand
+    m_MainLoop.AddSignal(SIGUSR1, [this]()
+    {
+        DumpStatistics();
+    });
 
-        m_DragFrameStartX = x;
-        m_DragFrameStartY = y;
-        m_DragFrameStartWidth = width;
-        m_DragFrameStartHeight = height;
-        cout << "    (x, y, width, height) = " << x << ", " << y << ", " << width << ", " << height << endl;
+    if(false == m_MainLoop.Run())
+    {
+        returnCode = -4;
+    }
 
-        cout << "Mouse pressed on client" << endl;
+    DumpStatistics();
+    m_TraceWriter.Close();
+    return returnCode;
+}
 
-        // raise the window to the top
-        frameIt->second->RaiseAndSetFocus();
-    }
-    else
+void WindowManager::ProcessEvents()
+{
+    // drain everything the server has already sent us. Polling reads whatever is
+    // waiting on the socket but never blocks or flushes, so requests made by the
+    // handlers accumulate in the output buffer.
+    xcb_generic_event_t* pEvent;
+    while((pEvent = m_pBackend->PollForEvent()) != nullptr)
     {
-        auto frameWindowIt = m_FramesToClients.find(e.window);
-        if(frameWindowIt != m_FramesToClients.end())
-        {
-            PharaohWindow::LocationInFrame cursorLocation = frameWindowIt->second->GetPositionInFrame(e.x, e.y);
-            if(cursorLocation != PharaohWindow::LocationInFrame_None)
-            {
-                // save the drag start position
-                // start a drag operation on this window
-                int x, y;
-                unsigned int width, height;
+        m_TraceWriter.Write(pEvent, m_EventBatch.empty());
+        m_EventBatch.push_back(pEvent);
+    }
 
-                frameWindowIt->second->GetLocation(x, y);
-                frameWindowIt->second->GetSize(width, height);
+    DispatchEventBatch();
 
-                DragOperation::DragType theDragType;
+    // send everything generated by this batch in one write
+    m_pBackend->Flush();
+}
 
-                switch(cursorLocation)
-                {
-                case PharaohWindow::LocationInFrame_DragBar:
-                    cout << "button press on client frame drag bar" << endl;
-                    theDragType = DragOperation::DragType_Move;
-                    break;
-                case PharaohWindow::LocationInFrame_ResizeFrameLeft:
-                case PharaohWindow::LocationInFrame_ResizeFrameRight:
-                    cout << "button press on client frame resize frame horizontal" << endl;
-                    theDragType = DragOperation::DragType_ResizeHorizonal;
-                    break;
-                case PharaohWindow::LocationInFrame_ResizeFrameTop:
-                case PharaohWindow::LocationInFrame_ResizeFrameBottom:
-                    cout << "button press on client frame resize frame vertical" << endl;
-                    theDragType = DragOperation::DragType_ResizeVertical;
-                    break;
-                case PharaohWindow::LocationInFrame_ResizeFrameTopRight:
-                case PharaohWindow::LocationInFrame_ResizeFrameBottomLeft:
-                    cout << "button press on client frame resize frame diagonal top right/bottom left" << endl;
-                    theDragType = DragOperation::DragType_ResizeAll;
-                    break;
-                case PharaohWindow::LocationInFrame_ResizeFrameTopLeft:
-                case PharaohWindow::LocationInFrame_ResizeFrameBottomRight:
-                    cout << "button press on client frame resize frame diagonal top left/bottom right" << endl;
-                    theDragType = DragOperation::DragType_ResizeAll;
-                    break;
-                default:
-                    break;
-                }
+void WindowManager::DispatchEventBatch()
+{
+    if(true == m_EventBatch.empty())
+    {
+        return;
+    }
 
-                m_xCurrentDragOperation.reset(new DragOperation
-                {
-                   e.x_root,
-                   e.y_root,
-                   x,
-                   y,
-                   width,
-                   height,
-                   10,
-                   10,
-                   theDragType
-                });
-
-                // raise the window to the top
-                frameWindowIt->second->RaiseAndSetFocus();
-            }
+    CompressMotionEvents();
+    DropStaleMapRequests();
+
+    for(xcb_generic_event_t* pEvent : m_EventBatch)
+    {
+        if(pEvent != nullptr)
+        {
+            DispatchEvent(pEvent);
+            free(pEvent);
         }
     }
-}
+    RecordEventBatch(m_EventBatch.size());
+    m_EventBatch.clear();
 
-void WindowManager::OnButtonRelease(const XButtonEvent& e)
-{
-    auto frameWindowIt = m_FramesToClients.find(e.window);
-    if(frameWindowIt != m_FramesToClients.end())
+    // whatever the handlers raised or lowered goes out in one go, and whatever changed
+    // in the switcher is drawn once
+    m_Stacking.Flush(*m_pBackend);
+    m_Switcher.Redraw(*m_pBackend);
+
+    // and then what's changed on screen is painted, once, if we're compositing
+    if(m_xCompositor.get() != nullptr)
     {
-        cout << "mouse released on client window" << endl;
-        m_xCurrentDragOperation.release();
+        m_xCompositor->Repaint();
+    }
 
-        frameWindowIt->second->RaiseAndSetFocus();
+    // without the main loop's timer (replays, benchmarks) each batch is a frame
+    if(false == m_FramePacing)
+    {
+        ApplyDragOperation(false);
     }
+
+    // the windows only buffer their log lines, send them on once per batch
+    Emperor::Logger::FlushThreadLog();
 }
 
-void WindowManager::OnMotionNotify(const XMotionEvent& e)
+int WindowManager::ReplayTrace(const string& path)
 {
-    auto frameIt = m_Clients.find(e.window);
-    if(frameIt != m_Clients.end())
+    vector<EventTraceRecord> records;
+    if(false == ReadEventTrace(path, records))
     {
-        // int dragPosX = e.x_root;
-        // int dragPosY = e.y_root;
-        // int deltaX = dragPosX - m_DragCursorStartX;
-        // int deltaY = dragPosY - m_DragCursorStartY;
+        LOG_ERROR << "Failed to read event trace " << path;
+        return -5;
+    }
 
-        // cout << "Mouse delta (x, y) = " << to_string(deltaX) << ", " << to_string(deltaY) << endl;
+    // rebuild the batches up-front, so only the handlers are timed. The events are
+    // allocated the same way XCB allocates them, the batch dispatch frees them.
+    vector<vector<xcb_generic_event_t*>> batches;
+    for(const EventTraceRecord& record : records)
+    {
+        if((record.flags & EventTraceRecord::Flags_BatchStart) != 0 || batches.empty())
+        {
+            batches.emplace_back();
+        }
 
-        // if(e.state & Button1Mask) 
-        // {
-        //     // alt + left button: Move window.
-        //     const int destFramePosX = m_DragFrameStartX + deltaX;
-        //     const int destFramePosY = m_DragFrameStartY + deltaY;
-        //     frameIt->second->SetLocation(destFramePosX, destFramePosY);
-        // } 
-        // else if (e.state & Button3Mask) 
-        // {
-        //     // alt + right button: Resize window.
-        //     // Window dimensions cannot be negative.
-        //     const int sizeDeltaX = max(deltaX, -m_DragFrameStartWidth);
-        //     const int sizeDeltaY = max(deltaY, -m_DragFrameStartHeight);
-        //     const int destFrameSizeWidth = m_DragFrameStartWidth + sizeDeltaX;
-        //     const int destFrameSizeHeight = m_DragFrameStartHeight + sizeDeltaY;
-        //     cout << "    Resize window to (x, y) = " << destFrameSizeWidth << ", " << destFrameSizeHeight << endl;
-        //     frameIt->second->SetSize(destFrameSizeWidth, destFrameSizeHeight);        
-        // }
+        xcb_generic_event_t* pEvent = (xcb_generic_event_t*)malloc(sizeof(xcb_generic_event_t));
+        memcpy(pEvent, record.event, sizeof(record.event));
+        pEvent->full_sequence = record.sequence;
+        batches.back().push_back(pEvent);
     }
-    else
+
+    // feed the trace through the handlers as fast as they'll go, flushing after each
+    // batch just like the live event loop.
+    auto startTime = chrono::steady_clock::now();
+    for(vector<xcb_generic_event_t*>& batch : batches)
     {
-        auto frameWindowIt = m_FramesToClients.find(e.window);
-        if(frameWindowIt != m_FramesToClients.end())
-        {
-            // is a drag operation in progress?
-            if((e.state & Button1Mask) > 0 && m_xCurrentDragOperation.get() != nullptr)
-            {
-                // get mouse delta since the drag started
-                const int deltaX = e.x_root - m_xCurrentDragOperation->cursorStartX;
-                const int deltaY = e.y_root - m_xCurrentDragOperation->cursorStartY;
+        m_EventBatch.swap(batch);
+        DispatchEventBatch();
+        m_pBackend->Flush();
+    }
+    auto handlerEndTime = chrono::steady_clock::now();
 
-                // what is the drag operation?
-                switch(m_xCurrentDragOperation->dragType)
-                {
-                case DragOperation::DragType_Move:
-                    frameWindowIt->second->SetLocation(
-                        m_xCurrentDragOperation->frameStartX + deltaX, 
-                        m_xCurrentDragOperation->frameStartY + deltaY);
-                    break;
-                case DragOperation::DragType_ResizeAll:
-                    frameWindowIt->second->SetSize(
-                        (unsigned int)max((int)m_xCurrentDragOperation->frameStartWidth + deltaX, (int)m_xCurrentDragOperation->frameMininumWidth),
-                        (unsigned int)max((int)m_xCurrentDragOperation->frameStartHeight + deltaY, (int)m_xCurrentDragOperation->frameMininumHeight));
-                    break;
-                case DragOperation::DragType_ResizeHorizonal:
-                    break;
-                case DragOperation::DragType_ResizeVertical:
-                    break;
-                default:
-                    break;
-                }
-            }
-        }
+    // wait for the server to get through everything we sent
+    m_pBackend->Sync();
+    auto serverEndTime = chrono::steady_clock::now();
+
+    // the replayed windows don't exist on this display, throw away the resulting errors
+    xcb_generic_event_t* pEvent;
+    while((pEvent = m_pBackend->PollForEvent()) != nullptr)
+    {
+        free(pEvent);
     }
+
+    double handlerSeconds = chrono::duration<double>(handlerEndTime - startTime).count();
+    double totalSeconds = chrono::duration<double>(serverEndTime - startTime).count();
+    double recordedSeconds = records.empty() ? 0.0 : (double)records.back().timestamp / 1e9;
+    LOG_MESSAGE << "Replayed " << records.size() << " events in " << batches.size() << " batches";
+    LOG_MESSAGE << "    Recorded over: " << recordedSeconds << "s";
+    LOG_MESSAGE << "    Handlers: " << handlerSeconds << "s, " << (double)records.size() / handlerSeconds << " events/s";
+    LOG_MESSAGE << "    Including server: " << totalSeconds << "s, " << (double)records.size() / totalSeconds << " events/s";
+    DumpStatistics();
+
+    return 0;
 }
 
-void WindowManager::OnKeyPress(const XKeyEvent& e)
+void WindowManager::DropStaleMapRequests()
 {
-    if ((e.state & Mod1Mask) && (e.keycode == XKeysymToKeycode(m_pXDisplay, XK_F4))) 
+    // A window that asks to be mapped and is destroyed in the same batch isn't worth
+    // framing. Mapping no longer asks the server anything, so nothing else would
+    // notice it had gone before the frame was made.
+    vector<xcb_window_t> destroyedWindows;
+    for(auto it = m_EventBatch.rbegin(); it != m_EventBatch.rend(); ++it)
     {
-        // alt + f4: Close window.
-        //
-        // There are two ways to tell an X window to close. The first is to send it
-        // a message of type WM_PROTOCOLS and value WM_DELETE_WINDOW. If the client
-        // has not explicitly marked itself as supporting this more civilized
-        // behavior (using XSetWMProtocols()), we kill it with XKillClient().
-        Atom* supported_protocols;
-        int num_supported_protocols;
-        if (XGetWMProtocols(m_pXDisplay, e.window, &supported_protocols, &num_supported_protocols) &&
-                (::std::find(supported_protocols, supported_protocols + num_supported_protocols,
-                        WM_DELETE_WINDOW) !=
-            supported_protocols + num_supported_protocols)) 
+        if(*it == nullptr)
         {
-            cout << "Gracefully deleting window " << e.window << endl;
-
-            // 1. Construct message.
-            XEvent msg;
-            memset(&msg, 0, sizeof(msg));
-            msg.xclient.type = ClientMessage;
-            msg.xclient.message_type = WM_PROTOCOLS;
-            msg.xclient.window = e.window;
-            msg.xclient.format = 32;
-            msg.xclient.data.l[0] = WM_DELETE_WINDOW;
+            continue;
+        }
 
-            // 2. Send message to window to be closed.
-            XSendEvent(m_pXDisplay, e.window, false, 0, &msg);
-        } 
-        else 
+        uint8_t responseType = (*it)->response_type & ~0x80;
+        if(responseType == XCB_DESTROY_NOTIFY)
         {
-            cout << "Killing window " << e.window << endl;;
-            XKillClient(m_pXDisplay, e.window);
+            destroyedWindows.push_back(((xcb_destroy_notify_event_t*)*it)->window);
         }
-    } 
-    else if ((e.state & Mod1Mask) && (e.keycode == XKeysymToKeycode(m_pXDisplay, XK_Tab))) 
-    {
-        // alt + tab: Switch window.
-        // 1. Find next window.
-        auto i = m_Clients.find(e.window);
-        if(i != m_Clients.end())
+        else if(responseType == XCB_MAP_REQUEST && false == destroyedWindows.empty())
         {
-            ++i;
-            if (i == m_Clients.end()) 
+            xcb_window_t window = ((xcb_map_request_event_t*)*it)->window;
+            if(find(destroyedWindows.begin(), destroyedWindows.end(), window) != destroyedWindows.end())
             {
-                i = m_Clients.begin();
+                free(*it);
+                *it = nullptr;
             }
-            // 2. Raise and set focus.
-            i->second->RaiseAndSetFocus();
         }
     }
 }
 
-void WindowManager::OnKeyRelease(const XKeyEvent& e)
-{
-}
-
-//--------------------------------------------------------------------------------
-// Error handling
-//--------------------------------------------------------------------------------
-
-int WindowManager::OnXError(Display* pDisplay, XErrorEvent* e)
+void WindowManager::CompressMotionEvents()
 {
-    const int MAX_ERROR_TEXT_LENGTH = 1024;
-    char error_text[MAX_ERROR_TEXT_LENGTH];
-
-    XGetErrorText(pDisplay, e->error_code, error_text, sizeof(error_text));
-    cout << "Received X error:\n"
-         << "    Request: " << int(e->request_code)
-         << " - " << XRequestCodeToString(e->request_code) << "\n"
-         << "    Error code: " << int(e->error_code)
-         << " - " << error_text << "\n"
-         << "    Resource ID: " << e->resourceid << endl;
+    // Only the latest motion event for a window matters, skip any earlier ones
+    // in this batch. Walk backwards, so the first one seen for a window is the latest.
+    // A button event in between starts a new run: the motion before a release belongs
+    // to that drag, and must not be merged into the next one.
+    // Batches are small, so a linear search of the windows seen is fine.
+    vector<xcb_window_t> motionWindows;
+    for(auto it = m_EventBatch.rbegin(); it != m_EventBatch.rend(); ++it)
+    {
+        uint8_t eventType = (*it)->response_type & ~0x80;
+        if(eventType == XCB_BUTTON_PRESS || eventType == XCB_BUTTON_RELEASE)
+        {
+            motionWindows.clear();
+            continue;
+        }
+        if(eventType != XCB_MOTION_NOTIFY)
+        {
+            continue;
+        }
 
-    // The return value is ignored.
-    return 0;
+        xcb_window_t window = ((xcb_motion_notify_event_t*)*it)->event;
+        if(find(motionWindows.begin(), motionWindows.end(), window) != motionWindows.end())
+        {
+            free(*it);
+            *it = nullptr;
+        }
+        else
+        {
+            motionWindows.push_back(window);
+        }
+    }
 }
 
-int WindowManager::OnWMDetected(Display* pDisplay, XErrorEvent* pEvent)
+void WindowManager::DispatchEvent(const xcb_generic_event_t* pEvent)
 {
-    if(pEvent->error_code == BadAccess)
+    uint8_t eventType = pEvent->response_type & ~0x80;
+    uint64_t roundTripsBefore = m_pBackend->GetRoundTripCount();
+
+    chrono::steady_clock::time_point handlerStart = chrono::steady_clock::now();
+    unique_ptr<EventLatency>& xLatency = m_EventLatency[eventType];
+    if(xLatency.get() == nullptr)
+    {
+        xLatency.reset(new EventLatency());
+    }
+    xcb_timestamp_t serverTime;
+    if(true == GetEventTime(pEvent, serverTime))
     {
-        m_WMDetected = true;
+        RecordQueueDelay(*xLatency, serverTime, handlerStart);
     }
 
-    return 0;
+    switch(eventType)
+    {
+    case 0:
+        OnXError(*(const xcb_generic_error_t*)pEvent);
+        break;
+    case XCB_CREATE_NOTIFY:
+        OnCreateNotify(*(const xcb_create_notify_event_t*)pEvent);
+        break;
+    case XCB_CONFIGURE_REQUEST:
+        OnConfigureRequest(*(const xcb_configure_request_event_t*)pEvent);
+        break;
+    case XCB_MAP_REQUEST:
+        OnMapRequest(*(const xcb_map_request_event_t*)pEvent);
+        break;
+    case XCB_REPARENT_NOTIFY:
+        OnReparentNotify(*(const xcb_reparent_notify_event_t*)pEvent);
+        break;
+    case XCB_MAP_NOTIFY:
+        OnMapNotify(*(const xcb_map_notify_event_t*)pEvent);
+        break;
+    case XCB_CONFIGURE_NOTIFY:
+        OnConfigureNotify(*(const xcb_configure_notify_event_t*)pEvent);
+        break;
+    case XCB_UNMAP_NOTIFY:
+        OnUnmapNotify(*(const xcb_unmap_notify_event_t*)pEvent);
+        break;
+    case XCB_DESTROY_NOTIFY:
+        OnDestroyNotify(*(const xcb_destroy_notify_event_t*)pEvent);
+        break;
+    case XCB_BUTTON_PRESS:
+        OnButtonPress(*(const xcb_button_press_event_t*)pEvent);
+        break;
+    case XCB_BUTTON_RELEASE:
+        OnButtonRelease(*(const xcb_button_release_event_t*)pEvent);
+        break;
+    case XCB_MOTION_NOTIFY:
+        OnMotionNotify(*(const xcb_motion_notify_event_t*)pEvent);
+        break;
+    case XCB_KEY_PRESS:
+        OnKeyPress(*(const xcb_key_press_event_t*)pEvent);
+        break;
+    case XCB_KEY_RELEASE:
+        OnKeyRelease(*(const xcb_key_release_event_t*)pEvent);
+        break;
+    case XCB_MAPPING_NOTIFY:
+        OnMappingNotify(*(const xcb_mapping_notify_event_t*)pEvent);
+        break;
+    case XCB_EXPOSE:
+        OnExpose(*(const xcb_expose_event_t*)pEvent);
+        break;
+    default:
+    {
+        uint32_t alarm;
+        uint32_t damage;
+        xcb_rectangle_t area;
+        if(true == m_pBackend->IsCounterAlarmEvent(pEvent, alarm))
+        {
+            OnCounterAlarm(alarm);
+        }
+        else if(true == m_pBackend->IsDamageEvent(pEvent, damage, area))
+        {
+            // a window has drawn something, on screen or in a thumbnail
+            if(m_xCompositor.get() == nullptr || false == m_xCompositor->OnDamage(damage, area))
+            {
+                m_Switcher.OnDamage(damage);
+            }
+        }
+        else
+        {
+            LOG_DEBUG << "Event ignored.";
+        }
+        break;
+    }
+    }
+
+    xLatency->handler.Record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - handlerStart).count());
+
+    HandlerRoundTrips& handlerRoundTrips = m_HandlerRoundTrips[eventType];
+    handlerRoundTrips.events++;
+    handlerRoundTrips.roundTrips += m_pBackend->GetRoundTripCount() - roundTripsBefore;
+}
+
+void WindowManager::RecordEventBatch(unsigned int batchSize)
+{
+    m_EventBatchCount++;
+    m_EventBatchEventCount += batchSize;
+    m_LargestEventBatch = max(m_LargestEventBatch, batchSize);
+
+    // report every so often rather than per batch, the report itself shouldn't
+    // become a per-event cost.
+    if((m_EventBatchCount % EVENT_BATCH_REPORT_INTERVAL) == 0)
+    {
+        ReportEventBatches();
+    }
+}
+
+void WindowManager::ReportEventBatches() const
+{
+    if(m_EventBatchCount > 0)
+    {
+        LOG_MESSAGE << "Event batches: " << m_EventBatchCount
+             << ", events: " << m_EventBatchEventCount
+             << ", average batch: " << (double)m_EventBatchEventCount / (double)m_EventBatchCount
+             << ", largest batch: " << m_LargestEventBatch;
+    }
+}
+
+bool WindowManager::GetEventTime(const xcb_generic_event_t* pEvent, xcb_timestamp_t& time)
+{
+    switch(pEvent->response_type & ~0x80)
+    {
+    case XCB_KEY_PRESS:
+    case XCB_KEY_RELEASE:
+    case XCB_BUTTON_PRESS:
+    case XCB_BUTTON_RELEASE:
+    case XCB_MOTION_NOTIFY:
+    case XCB_ENTER_NOTIFY:
+    case XCB_LEAVE_NOTIFY:
+        // these all share a layout
+        time = ((const xcb_key_press_event_t*)pEvent)->time;
+        return true;
+    case XCB_PROPERTY_NOTIFY:
+        time = ((const xcb_property_notify_event_t*)pEvent)->time;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void WindowManager::RecordQueueDelay(EventLatency& latency, xcb_timestamp_t serverTime, chrono::steady_clock::time_point handlerStart)
+{
+    // The server's clock isn't ours (and may not even be on this machine), so take the
+    // smallest difference seen between the two as the point of no delay. X timestamps
+    // are 32-bit milliseconds, compare them in the same wrapping arithmetic.
+    uint32_t localTime = (uint32_t)chrono::duration_cast<chrono::milliseconds>(handlerStart.time_since_epoch()).count();
+    int32_t clockDifference = (int32_t)(localTime - serverTime);
+    if(false == m_HaveServerClockOffset || clockDifference < m_ServerClockOffset)
+    {
+        m_ServerClockOffset = clockDifference;
+        m_HaveServerClockOffset = true;
+    }
+
+    latency.queueDelay.Record((uint64_t)(clockDifference - m_ServerClockOffset) * 1000000);
+}
+
+void WindowManager::ReportLatency(ostream& out) const
+{
+    // one JSON object, on one line
+    out << "{\"latency_ns\":[";
+    bool first = true;
+    for(size_t eventType = 0; eventType < m_EventLatency.size(); eventType++)
+    {
+        const EventLatency* pLatency = m_EventLatency[eventType].get();
+        if(pLatency == nullptr)
+        {
+            continue;
+        }
+
+        for(const auto& measure : { make_pair("handler", &pLatency->handler), make_pair("queue_delay", &pLatency->queueDelay) })
+        {
+            const LatencyHistogram& histogram = *measure.second;
+            if(histogram.GetCount() == 0)
+            {
+                continue;
+            }
+
+            out << (first ? "" : ",")
+                << "{\"event\":\"" << GetEventTypeName(eventType) << "\""
+                << ",\"type\":" << eventType
+                << ",\"measure\":\"" << measure.first << "\""
+                << ",\"count\":" << histogram.GetCount()
+                << ",\"p50\":" << histogram.GetPercentile(0.5)
+                << ",\"p90\":" << histogram.GetPercentile(0.9)
+                << ",\"p99\":" << histogram.GetPercentile(0.99)
+                << ",\"max\":" << histogram.GetMax() << "}";
+            first = false;
+        }
+    }
+    out << "]}" << endl;
+}
+
+void WindowManager::DumpStatistics() const
+{
+    ReportEventBatches();
+    ReportRoundTrips();
+    ReportWindowPool();
+    ReportCompositing();
+
+    if(true == m_StatsPath.empty())
+    {
+        // after everything logged so far
+        AsyncLog::GetInstance().Flush();
+        ReportLatency(cout);
+        return;
+    }
+
+    ofstream statsFile(m_StatsPath, ios::trunc);
+    if(false == statsFile.is_open())
+    {
+        LOG_ERROR << "Failed to open " << m_StatsPath << " for the latency statistics";
+        return;
+    }
+    ReportLatency(statsFile);
+}
+
+string WindowManager::GetEventTypeName(size_t eventType) const
+{
+    // every extension event looks the same to XEventTypeToString, and they'd run
+    // together in the reports
+    const char* pExtensionEventName = (m_pBackend != nullptr) ? m_pBackend->GetExtensionEventName(eventType) : nullptr;
+    if(pExtensionEventName != nullptr)
+    {
+        return pExtensionEventName;
+    }
+    if(eventType >= XCB_GE_GENERIC + 1)
+    {
+        return "Extension event " + to_string(eventType);
+    }
+    return XEventTypeToString(eventType);
+}
+
+void WindowManager::ReportRoundTrips() const
+{
+    LOG_MESSAGE << "Round trips to the X server:";
+    LOG_MESSAGE << "    Startup: " << m_StartupRoundTrips << ", adopting " << m_AdoptedWindows << " windows in "
+        << chrono::duration<double, milli>(m_AdoptionTime).count() << "ms";
+    for(size_t eventType = 0; eventType < m_HandlerRoundTrips.size(); eventType++)
+    {
+        const HandlerRoundTrips& handlerRoundTrips = m_HandlerRoundTrips[eventType];
+        if(handlerRoundTrips.events > 0)
+        {
+            LOG_MESSAGE << "    " << GetEventTypeName(eventType) << ": " << handlerRoundTrips.roundTrips
+                 << " in " << handlerRoundTrips.events << " events, "
+                 << (double)handlerRoundTrips.roundTrips / (double)handlerRoundTrips.events << " per event";
+        }
+    }
+}
+
+void WindowManager::ReportCompositing() const
+{
+    if(m_xCompositor.get() == nullptr)
+    {
+        return;
+    }
+
+    uint64_t repaints = m_xCompositor->GetRepaintCount();
+    uint64_t area = m_xCompositor->GetRepaintedArea();
+    LOG_MESSAGE << "Compositing: " << repaints << " repaints, " << area << " pixels, "
+         << ((repaints > 0) ? area / repaints : 0) << " pixels per repaint";
+}
+
+void WindowManager::ReportWindowPool() const
+{
+    const WindowPool::Statistics& statistics = m_WindowPool.GetStatistics();
+    LOG_MESSAGE << "Window pool: " << statistics.live << " windows (peak " << statistics.peakLive << ") in "
+         << statistics.slabs << " slabs, " << statistics.bytesReserved << " bytes reserved, "
+         << statistics.allocations << " allocations, " << statistics.frees << " frees";
+
+    const FramePool::Statistics& frameStatistics = m_Frames.GetStatistics();
+    LOG_MESSAGE << "Frame pool: " << m_Frames.GetIdleCount() << " idle (at most " << m_Frames.GetMaxIdle() << "), "
+         << frameStatistics.hits << " reused, " << frameStatistics.misses << " created, "
+         << frameStatistics.kept << " kept, " << frameStatistics.discarded << " destroyed";
+}
+
+void WindowManager::OnCreateNotify(const xcb_create_notify_event_t& e)
+{
+    if(m_xCompositor.get() != nullptr)
+    {
+        m_xCompositor->OnCreateNotify(e);
+    }
+
+    // No PharaohWindow until it asks to be mapped, see OnMapRequest, but remember where
+    // it is so we don't have to ask. Menus, tooltips and other override-redirect popups
+    // never ask, so they cost us nothing at all.
+    if(e.parent != m_RootWindow || 0 != e.override_redirect)
+    {
+        return;
+    }
+
+    Emperor::XBackend::WindowGeometry& geometry = m_UnmanagedGeometry[e.window];
+    geometry.x = e.x;
+    geometry.y = e.y;
+    geometry.width = e.width;
+    geometry.height = e.height;
+    geometry.borderWidth = e.border_width;
+}
+
+void WindowManager::OnConfigureRequest(const xcb_configure_request_event_t& e)
+{
+    xcb_configure_window_value_list_t changes = {};
+
+    // copy fields from e to changes
+    changes.x = e.x;
+    changes.y = e.y;
+    changes.width = e.width;
+    changes.height = e.height;
+    changes.border_width = e.border_width;
+    changes.sibling = e.sibling;
+    changes.stack_mode = e.stack_mode;
+
+    PharaohWindow* pWindow = m_Windows.Find(e.window, WindowRole_Client);
+    if(pWindow != nullptr && true == pWindow->IsMapped())
+    {
+        // a framed window is restacked with the others, at the end of the batch
+        uint16_t valueMask = e.value_mask;
+        if(valueMask & XCB_CONFIG_WINDOW_STACK_MODE)
+        {
+            if(e.stack_mode == XCB_STACK_MODE_ABOVE)
+            {
+                m_Stacking.Raise(*pWindow);
+            }
+            else if(e.stack_mode == XCB_STACK_MODE_BELOW)
+            {
+                m_Stacking.Lower(*pWindow);
+            }
+            valueMask &= ~(XCB_CONFIG_WINDOW_STACK_MODE | XCB_CONFIG_WINDOW_SIBLING);
+        }
+        if(valueMask != 0)
+        {
+            pWindow->Configure(valueMask, changes);
+            m_Spatial.Update(*pWindow);
+            m_Snap.Update(*pWindow);
+        }
+    }
+    else if(pWindow != nullptr)
+    {
+        pWindow->Configure(e.value_mask, changes);
+    }
+    else
+    {
+        // granted as asked, the ConfigureNotify updates the cached geometry
+        m_pBackend->ConfigureWindow(e.window, e.value_mask, changes);
+    }
+}
+
+void WindowManager::OnConfigureNotify(const xcb_configure_notify_event_t& e)
+{
+    if(m_xCompositor.get() != nullptr)
+    {
+        m_xCompositor->OnConfigureNotify(e);
+    }
+
+    // managed windows keep their own geometry, this is for the ones still to be taken on
+    auto it = m_UnmanagedGeometry.find(e.window);
+    if(it != m_UnmanagedGeometry.end())
+    {
+        it->second.x = e.x;
+        it->second.y = e.y;
+        it->second.width = e.width;
+        it->second.height = e.height;
+        it->second.borderWidth = e.border_width;
+    }
+}
+
+void WindowManager::OnMapRequest(const xcb_map_request_event_t& e)
+{
+    // override-redirect windows are mapped without asking, so this is a window to
+    // manage. It's taken on the first time it asks.
+    const WindowTable::Entry* pEntry = m_Windows.Find(e.window);
+    if(pEntry == nullptr)
+    {
+        // we should have seen it created, if not the window has to ask the server
+        PharaohWindow* pNewWindow;
+        auto it = m_UnmanagedGeometry.find(e.window);
+        if(it != m_UnmanagedGeometry.end())
+        {
+            const Emperor::XBackend::WindowGeometry& geometry = it->second;
+            pNewWindow = m_WindowPool.Create(
+                m_LogCallback,
+                *m_pBackend,
+                m_RootWindow,
+                e.window,
+                geometry.x,
+                geometry.y,
+                geometry.width,
+                geometry.height);
+            m_UnmanagedGeometry.erase(it);
+        }
+        else
+        {
+            pNewWindow = m_WindowPool.Create(m_LogCallback, *m_pBackend, m_RootWindow, e.window);
+        }
+        m_Windows.Insert(e.window, WindowRole_Client, pNewWindow);
+        MapWindow(*pNewWindow);
+    }
+    else if(pEntry->role == WindowRole_Client)
+    {
+        MapWindow(*pEntry->pWindow);
+    }
+}
+
+void WindowManager::OnReparentNotify(const xcb_reparent_notify_event_t& e)
+{
+    if(m_xCompositor.get() != nullptr)
+    {
+        m_xCompositor->OnReparentNotify(e);
+    }
+}
+
+void WindowManager::OnMapNotify(const xcb_map_notify_event_t& e)
+{
+    if(m_xCompositor.get() != nullptr)
+    {
+        m_xCompositor->OnMapNotify(e);
+    }
+}
+
+void WindowManager::OnUnmapNotify(const xcb_unmap_notify_event_t& e)
+{
+    if(m_xCompositor.get() != nullptr)
+    {
+        m_xCompositor->OnUnmapNotify(e);
+    }
+
+    // ignore if we don't manage this window
+    PharaohWindow* pWindow = m_Windows.Find(e.window, WindowRole_Client);
+    if(pWindow == nullptr)
+    {
+        LOG_DEBUG << "Ignore UnmapNotify for non-client window " << e.window;
+        return;
+    }
+
+    // ignore the event if it was triggered by reparenting a window that was mapped
+    // before the window manager started.
+    if(e.event == m_RootWindow)
+    {
+        LOG_DEBUG << "Ignore UnmapNotify for reparented pre-existing window " << e.window;
+        return;
+    }
+
+    // unframe the window if we do manage it
+    UnmapWindow(*pWindow);
+}
+
+void WindowManager::OnDestroyNotify(const xcb_destroy_notify_event_t& e)
+{
+    if(m_xCompositor.get() != nullptr)
+    {
+        m_xCompositor->OnDestroyNotify(e);
+    }
+
+    m_UnmanagedGeometry.erase(e.window);
+
+    PharaohWindow* pWindow = m_Windows.Find(e.window, WindowRole_Client);
+    if(pWindow != nullptr)
+    {
+        if(pWindow->IsMapped())
+        {
+            UnmapWindow(*pWindow);
+        }
+        m_Windows.Erase(e.window);
+        m_WindowPool.Destroy(pWindow);
+    }
+}
+
+//--------------------------------------------------------------------------------
+// User input events
+//--------------------------------------------------------------------------------
+
+void WindowManager::OnButtonPress(const xcb_button_press_event_t& e)
+{
+    if(e.event == m_RootWindow)
+    {
+        // alt + button, grabbed on the root. The window under the pointer is moved with
+        // the left button or resized with the right, wherever on it the press was. Found
+        // from the frames themselves, so a popup or outline over one doesn't hide it.
+        PharaohWindow* pWindow = m_Spatial.FindAt(e.root_x, e.root_y);
+        if(pWindow != nullptr)
+        {
+            LOG_DEBUG << "alt + button " << int(e.detail) << " press on client";
+            StartDragOperation(*pWindow, e, (e.detail == XCB_BUTTON_INDEX_3) ? DragType_ResizeAll : DragType_Move);
+        }
+        return;
+    }
+
+    PharaohWindow* pWindow = m_Windows.Find(e.event, WindowRole_Frame);
+    if(pWindow == nullptr)
+    {
+        // a frame on its way out still has its grab, the pointer mustn't stay frozen
+        m_pBackend->AllowEvents(XCB_ALLOW_REPLAY_POINTER, e.time);
+        return;
+    }
+
+    // a press in the client's contents raises and focuses it, then goes on to the
+    // client as if we'd never seen it. One on the frame is ours, and the pointer is let
+    // go so the drag's motion comes straight through.
+    PharaohWindow::LocationInFrame cursorLocation = pWindow->GetPositionInFrame(e.event_x, e.event_y);
+    if(cursorLocation == PharaohWindow::LocationInFrame_None)
+    {
+        LOG_DEBUG << "button press on client";
+        Focus(*pWindow);
+        m_pBackend->AllowEvents(XCB_ALLOW_REPLAY_POINTER, e.time);
+        return;
+    }
+    m_pBackend->AllowEvents(XCB_ALLOW_ASYNC_POINTER, e.time);
+
+    DragType dragType = DragType_Move;
+    switch(cursorLocation)
+    {
+    case PharaohWindow::LocationInFrame_DragBar:
+        LOG_DEBUG << "button press on client frame drag bar";
+        dragType = DragType_Move;
+        break;
+    case PharaohWindow::LocationInFrame_ResizeFrameLeft:
+    case PharaohWindow::LocationInFrame_ResizeFrameRight:
+        LOG_DEBUG << "button press on client frame resize frame horizontal";
+        dragType = DragType_ResizeHorizonal;
+        break;
+    case PharaohWindow::LocationInFrame_ResizeFrameTop:
+    case PharaohWindow::LocationInFrame_ResizeFrameBottom:
+        LOG_DEBUG << "button press on client frame resize frame vertical";
+        dragType = DragType_ResizeVertical;
+        break;
+    case PharaohWindow::LocationInFrame_ResizeFrameTopRight:
+    case PharaohWindow::LocationInFrame_ResizeFrameBottomLeft:
+        LOG_DEBUG << "button press on client frame resize frame diagonal top right/bottom left";
+        dragType = DragType_ResizeAll;
+        break;
+    case PharaohWindow::LocationInFrame_ResizeFrameTopLeft:
+    case PharaohWindow::LocationInFrame_ResizeFrameBottomRight:
+        LOG_DEBUG << "button press on client frame resize frame diagonal top left/bottom right";
+        dragType = DragType_ResizeAll;
+        break;
+    default:
+        break;
+    }
+
+    // the drag type has to be known before the drag starts, it decides which of the
+    // client's properties are read
+    StartDragOperation(*pWindow, e, dragType);
+}
+
+void WindowManager::StartDragOperation(PharaohWindow& window, const xcb_button_press_event_t& e, DragType dragType)
+{
+    // save the drag start position
+    int x, y;
+    unsigned int width, height;
+    window.GetLocation(x, y);
+    window.GetSize(width, height);
+
+    m_xCurrentDragOperation.reset(new DragOperation
+    {
+       e.root_x,
+       e.root_y,
+       x,
+       y,
+       width,
+       height,
+       10,
+       10,
+       dragType,
+       m_WindowPool.GetHandle(&window),
+       e.root_x,
+       e.root_y,
+       false
+    });
+
+    ReadDragProperties(window.GetClientWindow(), *m_xCurrentDragOperation);
+
+    // move the frame once per screen refresh for as long as the drag lasts
+    if(true == m_FramePacing)
+    {
+        m_MainLoop.CancelTimer(m_DragTimer);
+        m_DragTimer = m_MainLoop.AddTimer(m_FramePeriod, m_FramePeriod, [this]() { ApplyDragOperation(false); });
+    }
+
+    // raise the window to the top
+    Focus(window);
+}
+
+void WindowManager::OnButtonRelease(const xcb_button_release_event_t& e)
+{
+    if(m_xCurrentDragOperation.get() != nullptr)
+    {
+        // the window ends up exactly where the pointer was let go, which needn't be
+        // where the last motion event put it. Its edges were left where they were
+        // while it was dragged, nothing snaps to a window on the move.
+        if(e.root_x != m_xCurrentDragOperation->cursorX || e.root_y != m_xCurrentDragOperation->cursorY)
+        {
+            m_xCurrentDragOperation->cursorX = e.root_x;
+            m_xCurrentDragOperation->cursorY = e.root_y;
+            m_xCurrentDragOperation->pending = true;
+        }
+        ApplyDragOperation(true);
+        PharaohWindow* pDragged = m_WindowPool.Get(m_xCurrentDragOperation->window);
+        if(pDragged != nullptr && true == pDragged->IsMapped())
+        {
+            m_Snap.Update(*pDragged);
+        }
+        m_MainLoop.CancelTimer(m_DragTimer);
+        m_DragTimer = 0;
+        if(m_xCurrentDragOperation->syncAlarm != 0)
+        {
+            m_pBackend->DestroyCounterAlarm(m_xCurrentDragOperation->syncAlarm);
+        }
+        m_xCurrentDragOperation.reset();
+    }
+
+    PharaohWindow* pWindow = m_Windows.Find(e.event, WindowRole_Frame);
+    if(pWindow != nullptr)
+    {
+        LOG_DEBUG << "mouse released on client window";
+
+        Focus(*pWindow);
+    }
+}
+
+void WindowManager::OnMotionNotify(const xcb_motion_notify_event_t& e)
+{
+    // motion only comes while a button is held, from the root's grab or a frame's
+    if(m_xCurrentDragOperation.get() != nullptr)
+    {
+        // only note where the pointer is, the frame catches up on the next frame
+        m_xCurrentDragOperation->cursorX = e.root_x;
+        m_xCurrentDragOperation->cursorY = e.root_y;
+        m_xCurrentDragOperation->pending = true;
+    }
+}
+
+void WindowManager::ApplyDragOperation(bool finished)
+{
+    // a wireframe drag always puts the window in place at the end, even if the
+    // outline is already where the pointer is
+    DragOperation* pDrag = m_xCurrentDragOperation.get();
+    if(pDrag == nullptr || (false == pDrag->pending && false == (finished && m_OutlineShown)))
+    {
+        return;
+    }
+
+    PharaohWindow* pWindow = m_WindowPool.Get(pDrag->window);
+    if(pWindow == nullptr || false == pWindow->IsMapped())
+    {
+        // the window went away mid-drag
+        pDrag->pending = false;
+        HideOutline();
+        return;
+    }
+
+    // get mouse delta since the drag started
+    const int deltaX = pDrag->cursorX - pDrag->cursorStartX;
+    const int deltaY = pDrag->cursorY - pDrag->cursorStartY;
+    const bool moved = (deltaX != 0 || deltaY != 0);
+    unsigned int left, top, right, bottom;
+    pWindow->GetFrameExtents(left, top, right, bottom);
+
+    // a snapped window gets its old size back as soon as it's dragged away, with the
+    // pointer the same way across the title bar as it was
+    unsigned int restoreWidth, restoreHeight;
+    if(pDrag->dragType == DragType_Move && true == moved &&
+        true == pWindow->GetRestoreSize(restoreWidth, restoreHeight))
+    {
+        int grabOffset = pDrag->cursorStartX - pDrag->frameStartX;
+        int snappedWidth = (int)(pDrag->frameStartWidth + left + right);
+        int restoredWidth = (int)(restoreWidth + left + right);
+        pDrag->frameStartX = pDrag->cursorStartX - (grabOffset * restoredWidth) / snappedWidth;
+        pDrag->frameStartWidth = restoreWidth;
+        pDrag->frameStartHeight = restoreHeight;
+        pDrag->restoreSize = true;
+        pWindow->ClearRestoreSize();
+    }
+
+    // where does the window go?
+    int x = pDrag->frameStartX;
+    int y = pDrag->frameStartY;
+    unsigned int width = pDrag->frameStartWidth;
+    unsigned int height = pDrag->frameStartHeight;
+    switch(pDrag->dragType)
+    {
+    case DragType_Move:
+        x += deltaX;
+        y += deltaY;
+        break;
+    case DragType_ResizeAll:
+        width = (unsigned int)max((int)pDrag->frameStartWidth + deltaX, (int)pDrag->frameMininumWidth);
+        height = (unsigned int)max((int)pDrag->frameStartHeight + deltaY, (int)pDrag->frameMininumHeight);
+        break;
+    case DragType_ResizeHorizonal:
+        break;
+    case DragType_ResizeVertical:
+        break;
+    default:
+        break;
+    }
+
+    // Aero snap: dragged against the top of a monitor the window fills it, against the
+    // left or right it fills that half. Until it's let go an outline shows where it
+    // would go. Anywhere else its edges snap to those of the monitors and other windows.
+    xcb_rectangle_t snapArea;
+    bool edgeSnap = (pDrag->dragType == DragType_Move && true == moved &&
+        true == GetEdgeSnapArea(pDrag->cursorX, pDrag->cursorY, snapArea));
+    unsigned int snapWidth = 0;
+    unsigned int snapHeight = 0;
+    if(true == edgeSnap)
+    {
+        snapWidth = (unsigned int)max((int)snapArea.width - (int)(left + right), (int)pDrag->frameMininumWidth);
+        snapHeight = (unsigned int)max((int)snapArea.height - (int)(top + bottom), (int)pDrag->frameMininumHeight);
+    }
+    else
+    {
+        SnapToEdges(*pWindow, *pDrag, x, y, width, height);
+    }
+
+    // in wireframe mode only the outline follows the pointer
+    if(true == edgeSnap && false == finished)
+    {
+        ShowOutline(*pWindow, snapArea.x, snapArea.y, snapWidth, snapHeight);
+    }
+    else if(true == pDrag->wireframe && false == finished)
+    {
+        ShowOutline(*pWindow, x, y, width, height);
+    }
+    else
+    {
+        HideOutline();
+    }
+    if(true == pDrag->wireframe && false == finished)
+    {
+        pDrag->pending = false;
+        return;
+    }
+
+    // let go at an edge, the window is snapped, remembering its size from before
+    bool snapped = (true == edgeSnap && true == finished);
+    if(true == snapped)
+    {
+        if(false == pWindow->GetRestoreSize(restoreWidth, restoreHeight))
+        {
+            pWindow->SetRestoreSize(width, height);
+        }
+        x = snapArea.x;
+        y = snapArea.y;
+        width = snapWidth;
+        height = snapHeight;
+    }
+
+    // a client that's still painting the last size gets the new one once it's done,
+    // unless it has taken so long it probably never will
+    if(pDrag->dragType != DragType_Move && pDrag->syncCounter != 0)
+    {
+        if(true == pDrag->awaitingSync && false == finished)
+        {
+            if(chrono::steady_clock::now() - pDrag->syncRequestTime < SYNC_REQUEST_TIMEOUT)
+            {
+                return;
+            }
+            LOG_DEBUG << "Window " << pWindow->GetClientWindow() << " didn't answer a sync request, resizing without";
+            pDrag->syncCounter = 0;
+        }
+        else
+        {
+            SendSyncRequest(pWindow->GetClientWindow(), *pDrag);
+        }
+    }
+    pDrag->pending = false;
+
+    if(pDrag->dragType == DragType_Move)
+    {
+        pWindow->SetLocation(x, y);
+        if(true == pDrag->restoreSize || true == snapped)
+        {
+            pWindow->SetSize(width, height);
+            pDrag->restoreSize = false;
+        }
+    }
+    else if(pDrag->dragType == DragType_ResizeAll)
+    {
+        pWindow->SetSize(width, height);
+    }
+    m_Spatial.Update(*pWindow);
+}
+
+bool WindowManager::GetEdgeSnapArea(int cursorX, int cursorY, xcb_rectangle_t& area) const
+{
+    // the pointer has to be right against the edge, with no other monitor beyond it for
+    // the pointer to carry on into
+    const xcb_rectangle_t* pMonitor = m_Snap.FindMonitor(cursorX, cursorY);
+    if(pMonitor == nullptr)
+    {
+        return false;
+    }
+
+    area = *pMonitor;
+    if(cursorY == pMonitor->y && m_Snap.FindMonitor(cursorX, cursorY - 1) == nullptr)
+    {
+        return true;
+    }
+    if(cursorX == pMonitor->x && m_Snap.FindMonitor(cursorX - 1, cursorY) == nullptr)
+    {
+        area.width = pMonitor->width / 2;
+        return true;
+    }
+    if(cursorX == pMonitor->x + pMonitor->width - 1 && m_Snap.FindMonitor(cursorX + 1, cursorY) == nullptr)
+    {
+        area.x = pMonitor->x + pMonitor->width / 2;
+        area.width = pMonitor->width - pMonitor->width / 2;
+        return true;
+    }
+    return false;
+}
+
+void WindowManager::SnapToEdges(const PharaohWindow& window, const DragOperation& drag, int& x, int& y, unsigned int& width, unsigned int& height) const
+{
+    // whichever side of the frame is nearest an edge snaps to it. Moving, that's any
+    // side, resizing from the bottom right corner only the right and the bottom.
+    unsigned int left, top, right, bottom;
+    window.GetFrameExtents(left, top, right, bottom);
+    const int frameRight = x + (int)(width + left + right);
+    const int frameBottom = y + (int)(height + top + bottom);
+    int edge;
+
+    if(drag.dragType == DragType_Move)
+    {
+        int offsetX = SnapEdges::SNAP_DISTANCE + 1;
+        if(true == m_Snap.FindVertical(x, y, frameBottom, &window, edge))
+        {
+            offsetX = edge - x;
+        }
+        if(true == m_Snap.FindVertical(frameRight, y, frameBottom, &window, edge) && abs(edge - frameRight) < abs(offsetX))
+        {
+            offsetX = edge - frameRight;
+        }
+
+        int offsetY = SnapEdges::SNAP_DISTANCE + 1;
+        if(true == m_Snap.FindHorizontal(y, x, frameRight, &window, edge))
+        {
+            offsetY = edge - y;
+        }
+        if(true == m_Snap.FindHorizontal(frameBottom, x, frameRight, &window, edge) && abs(edge - frameBottom) < abs(offsetY))
+        {
+            offsetY = edge - frameBottom;
+        }
+
+        if(abs(offsetX) <= SnapEdges::SNAP_DISTANCE)
+        {
+            x += offsetX;
+        }
+        if(abs(offsetY) <= SnapEdges::SNAP_DISTANCE)
+        {
+            y += offsetY;
+        }
+    }
+    else if(drag.dragType == DragType_ResizeAll)
+    {
+        if(true == m_Snap.FindVertical(frameRight, y, frameBottom, &window, edge) &&
+            edge - x - (int)(left + right) >= (int)drag.frameMininumWidth)
+        {
+            width = (unsigned int)(edge - x - (int)(left + right));
+        }
+        if(true == m_Snap.FindHorizontal(frameBottom, x, frameRight, &window, edge) &&
+            edge - y - (int)(top + bottom) >= (int)drag.frameMininumHeight)
+        {
+            height = (unsigned int)(edge - y - (int)(top + bottom));
+        }
+    }
+}
+
+void WindowManager::ShowOutline(const PharaohWindow& window, int x, int y, unsigned int width, unsigned int height)
+{
+    // four thin override-redirect windows, only there for the length of the drag
+    if(m_OutlineWindows[0] == XCB_WINDOW_NONE)
+    {
+        uint32_t values[2] =
+        {
+            OUTLINE_COLOUR,
+            1
+        };
+        for(xcb_window_t& outline : m_OutlineWindows)
+        {
+            outline = m_pBackend->CreateWindow(m_RootWindow, 0, 0, 1, 1, XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT, values);
+            m_Windows.Insert(outline, WindowRole_Decoration, nullptr);
+        }
+    }
+
+    // the outline goes round the frame, not the client
+    unsigned int left, top, right, bottom;
+    window.GetFrameExtents(left, top, right, bottom);
+    int frameWidth = (int)(width + left + right);
+    int frameHeight = (int)(height + top + bottom);
+    const int thickness = (int)OUTLINE_THICKNESS;
+    const int sideHeight = max(frameHeight - 2 * thickness, 1);
+    const int edges[4][4] =
+    {
+        { x, y, frameWidth, thickness },
+        { x, y + frameHeight - thickness, frameWidth, thickness },
+        { x, y + thickness, thickness, sideHeight },
+        { x + frameWidth - thickness, y + thickness, thickness, sideHeight }
+    };
+
+    for(size_t i = 0; i < m_OutlineWindows.size(); i++)
+    {
+        xcb_configure_window_value_list_t values = {};
+        values.x = edges[i][0];
+        values.y = edges[i][1];
+        values.width = edges[i][2];
+        values.height = edges[i][3];
+        m_pBackend->ConfigureWindow(
+            m_OutlineWindows[i],
+            XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+            values);
+        if(false == m_OutlineShown)
+        {
+            m_pBackend->MapWindow(m_OutlineWindows[i]);
+        }
+    }
+    m_OutlineShown = true;
+}
+
+void WindowManager::HideOutline()
+{
+    if(false == m_OutlineShown)
+    {
+        return;
+    }
+
+    for(xcb_window_t& outline : m_OutlineWindows)
+    {
+        m_pBackend->DestroyWindow(outline);
+        m_Windows.Erase(outline);
+        outline = XCB_WINDOW_NONE;
+    }
+    m_OutlineShown = false;
+}
+
+void WindowManager::OnCounterAlarm(uint32_t alarm)
+{
+    // the client has painted the size it was last given
+    if(m_xCurrentDragOperation.get() != nullptr && m_xCurrentDragOperation->syncAlarm == alarm)
+    {
+        m_xCurrentDragOperation->awaitingSync = false;
+    }
+}
+
+void WindowManager::ReadDragProperties(xcb_window_t window, DragOperation& drag)
+{
+    // everything is asked for before waiting on any of it, so this costs one round
+    // trip at most. Moving a window when there are no wireframe classes costs none.
+    bool readClass = (false == m_WireframeClasses.empty());
+    bool readSync = (drag.dragType != DragType_Move);
+    if(false == readClass && false == readSync)
+    {
+        return;
+    }
+
+    xcb_get_property_cookie_t classCookie = {};
+    xcb_get_property_cookie_t protocolsCookie = {};
+    xcb_get_property_cookie_t counterCookie = {};
+    if(true == readClass)
+    {
+        classCookie = m_pBackend->RequestProperty(window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING);
+    }
+    if(true == readSync)
+    {
+        protocolsCookie = m_pBackend->RequestProperty(window, WM_PROTOCOLS, XCB_ATOM_ATOM);
+        counterCookie = m_pBackend->RequestProperty(window, _NET_WM_SYNC_REQUEST_COUNTER, XCB_ATOM_CARDINAL);
+    }
+
+    // WM_CLASS is the instance name then the class name, each null terminated.
+    // Either can pick wireframe mode.
+    string windowClass;
+    if(true == readClass && true == m_pBackend->ReceiveStringProperty(classCookie, windowClass))
+    {
+        size_t start = 0;
+        while(start < windowClass.length() && false == drag.wireframe)
+        {
+            size_t end = windowClass.find('\0', start);
+            if(end == string::npos)
+            {
+                end = windowClass.length();
+            }
+            drag.wireframe = (m_WireframeClasses.find(windowClass.substr(start, end - start)) != m_WireframeClasses.end());
+            start = end + 1;
+        }
+    }
+
+    if(true == readSync)
+    {
+        vector<uint32_t> protocols;
+        vector<uint32_t> counters;
+        bool haveProtocols = m_pBackend->ReceiveProperty(protocolsCookie, protocols);
+        bool haveCounter = m_pBackend->ReceiveProperty(counterCookie, counters);
+
+        // a wireframe resize only configures the client once, there's nothing to throttle
+        if(false == drag.wireframe && true == haveProtocols && true == haveCounter && false == counters.empty()
+            && find(protocols.begin(), protocols.end(), _NET_WM_SYNC_REQUEST) != protocols.end())
+        {
+            drag.syncCounter = counters[0];
+        }
+    }
+}
+
+void WindowManager::SendSyncRequest(xcb_window_t window, DragOperation& drag)
+{
+    // the client sets its counter to this value once it has redrawn at the new size.
+    // One value for all windows keeps each window's values increasing.
+    m_SyncRequestValue++;
+
+    xcb_client_message_event_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.response_type = XCB_CLIENT_MESSAGE;
+    msg.type = WM_PROTOCOLS;
+    msg.window = window;
+    msg.format = 32;
+    msg.data.data32[0] = _NET_WM_SYNC_REQUEST;
+    msg.data.data32[1] = XCB_CURRENT_TIME;
+    msg.data.data32[2] = (uint32_t)m_SyncRequestValue;
+    msg.data.data32[3] = (uint32_t)(m_SyncRequestValue >> 32);
+    m_pBackend->SendEvent(window, XCB_EVENT_MASK_NO_EVENT, &msg);
+
+    if(drag.syncAlarm == 0)
+    {
+        drag.syncAlarm = m_pBackend->CreateCounterAlarm(drag.syncCounter, m_SyncRequestValue);
+        if(drag.syncAlarm == 0)
+        {
+            // no SYNC on this server, there'd be nothing to wait on
+            drag.syncCounter = 0;
+            return;
+        }
+    }
+    else
+    {
+        m_pBackend->ChangeCounterAlarm(drag.syncAlarm, m_SyncRequestValue);
+    }
+    drag.awaitingSync = true;
+    drag.syncRequestTime = chrono::steady_clock::now();
+}
+
+void WindowManager::OnKeyPress(const xcb_key_press_event_t& e)
+{
+    // while the switcher is up the whole keyboard is ours. Tab moves along, Escape puts
+    // it away without switching.
+    KeyAction action = m_KeyBindings.GetAction(e.detail, e.state);
+    if(true == m_Switcher.IsOpen())
+    {
+        if(action == KeyAction_NextWindow)
+        {
+            m_Switcher.SelectNext();
+        }
+        else if(m_KeySymbols.GetKeysym(e.detail) == XK_Escape)
+        {
+            CloseSwitcher(false);
+        }
+        return;
+    }
+
+    if(action == KeyAction_None)
+    {
+        return;
+    }
+
+    // the keys are grabbed on the root, so work out which window they're for: the one
+    // we last focused, or failing that the one under the pointer
+    PharaohWindow* pWindow = m_WindowPool.Get(m_FocusedWindow);
+    if(pWindow == nullptr || false == pWindow->IsMapped())
+    {
+        pWindow = m_Spatial.FindAt(e.root_x, e.root_y);
+    }
+    if(pWindow == nullptr)
+    {
+        return;
+    }
+
+    switch(action)
+    {
+    case KeyAction_CloseWindow:
+        CloseWindow(pWindow->GetClientWindow());
+        break;
+    case KeyAction_NextWindow:
+        if(true == m_Thumbnails)
+        {
+            OpenSwitcher(*pWindow, KeyBindings::GetBoundModifiers(e.state));
+        }
+        else
+        {
+            FocusNextWindow(*pWindow);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void WindowManager::OnMappingNotify(const xcb_mapping_notify_event_t& e)
+{
+    if(e.request != XCB_MAPPING_KEYBOARD)
+    {
+        return;
+    }
+
+    // the keys have moved, bind the new ones and grab them instead of the old ones
+    if(false == m_KeySymbols.ReceiveMapping(*m_pBackend, m_KeySymbols.RequestMapping(*m_pBackend)))
+    {
+        LOG_ERROR << "Failed to get the new keyboard mapping";
+        return;
+    }
+    m_KeyBindings.Compile(m_KeySymbols);
+    KeyBindings::Ungrab(*m_pBackend, m_RootWindow);
+    m_KeyBindings.Grab(*m_pBackend, m_RootWindow);
+    LOG_MESSAGE << "Keyboard mapping changed, key bindings updated";
+}
+
+void WindowManager::CloseWindow(xcb_window_t window)
+{
+    // There are two ways to tell an X window to close. The first is to send it
+    // a message of type WM_PROTOCOLS and value WM_DELETE_WINDOW. If the client
+    // has not explicitly marked itself as supporting this more civilized
+    // behavior (by listing it in its WM_PROTOCOLS property), we kill it with xcb_kill_client.
+    vector<uint32_t> supportedProtocols;
+    bool supportsDelete = false;
+    if(true == m_pBackend->ReceiveProperty(m_pBackend->RequestProperty(window, WM_PROTOCOLS, XCB_ATOM_ATOM), supportedProtocols))
+    {
+        supportsDelete = (::std::find(supportedProtocols.begin(), supportedProtocols.end(),
+                    WM_DELETE_WINDOW) != supportedProtocols.end());
+    }
+
+    if (supportsDelete)
+    {
+        LOG_DEBUG << "Gracefully deleting window " << window;
+
+        // 1. Construct message.
+        xcb_client_message_event_t msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.response_type = XCB_CLIENT_MESSAGE;
+        msg.type = WM_PROTOCOLS;
+        msg.window = window;
+        msg.format = 32;
+        msg.data.data32[0] = WM_DELETE_WINDOW;
+        msg.data.data32[1] = XCB_CURRENT_TIME;
+
+        // 2. Send message to window to be closed.
+        m_pBackend->SendEvent(window, XCB_EVENT_MASK_NO_EVENT, &msg);
+    }
+    else
+    {
+        LOG_DEBUG << "Killing window " << window;
+        m_pBackend->KillClient(window);
+    }
+}
+
+void WindowManager::FocusNextWindow(PharaohWindow& window)
+{
+    // the windows are taken in the order they sit in the pool, skipping any that are
+    // withdrawn. Comes back round to this one if it's the only one on screen.
+    PharaohWindow* pNext = m_WindowPool.GetNext(&window);
+    while(false == pNext->IsMapped() && pNext != &window)
+    {
+        pNext = m_WindowPool.GetNext(pNext);
+    }
+    Focus(*pNext);
+}
+
+void WindowManager::OpenSwitcher(PharaohWindow& window, uint16_t modifiers)
+{
+    // the windows top to bottom, which is the order they were last used in, starting
+    // with the one the keys were for, on the monitor it's on
+    vector<PharaohWindow*> windows;
+    windows.reserve(m_Stacking.GetCount());
+    windows.push_back(&window);
+    for(PharaohWindow* pWindow = m_Stacking.GetTop(); pWindow != nullptr; pWindow = pWindow->GetStackingNode().pBelow)
+    {
+        if(pWindow != &window)
+        {
+            windows.push_back(pWindow);
+        }
+    }
+
+    int x, y;
+    unsigned int width, height;
+    window.GetLocation(x, y);
+    window.GetSize(width, height);
+    const xcb_rectangle_t* pMonitor = m_Snap.FindMonitor(x + (int)width / 2, y + (int)height / 2);
+    if(pMonitor == nullptr && false == m_Snap.GetMonitors().empty())
+    {
+        pMonitor = &m_Snap.GetMonitors().front();
+    }
+    if(pMonitor == nullptr || modifiers == 0)
+    {
+        FocusNextWindow(window);
+        return;
+    }
+
+    // the switcher stays up until the modifiers are let go, which only a keyboard grab
+    // gets to hear about. The modifiers are looked at once the grab has been made, so
+    // if they were let go before it, it's simply the next window. So it is if the
+    // keyboard can't be had. Both are answered in one round trip.
+    xcb_grab_keyboard_cookie_t grabCookie = m_pBackend->RequestKeyboardGrab(m_RootWindow);
+    xcb_query_pointer_cookie_t pointerCookie = m_pBackend->RequestPointerState(m_RootWindow);
+    uint8_t grabStatus = m_pBackend->ReceiveKeyboardGrab(grabCookie);
+    uint16_t state = 0;
+    bool held = (true == m_pBackend->ReceivePointerState(pointerCookie, state) && (state & modifiers) != 0);
+    if(grabStatus != XCB_GRAB_STATUS_SUCCESS || false == held)
+    {
+        LOG_DEBUG << "switcher not shown, grab status " << int(grabStatus) << ", modifiers " << state;
+        if(grabStatus == XCB_GRAB_STATUS_SUCCESS)
+        {
+            m_pBackend->UngrabKeyboard();
+        }
+        FocusNextWindow(window);
+        return;
+    }
+
+    m_SwitcherModifiers = modifiers;
+    xcb_window_t switcherWindow = m_Switcher.Open(*m_pBackend, m_RootWindow, *pMonitor, windows, m_xCompositor.get() == nullptr);
+    m_Windows.Insert(switcherWindow, WindowRole_Decoration, nullptr);
+}
+
+void WindowManager::CloseSwitcher(bool switchWindow)
+{
+    xcb_window_t switcherWindow = m_Switcher.GetWindow();
+    PharaohWindow* pSelected = m_Switcher.Close(*m_pBackend);
+    m_Windows.Erase(switcherWindow);
+    m_pBackend->UngrabKeyboard();
+    if(true == switchWindow && pSelected != nullptr)
+    {
+        Focus(*pSelected);
+    }
+}
+
+void WindowManager::Focus(PharaohWindow& window)
+{
+    // the frame is raised at the end of the batch, however many times it's asked for
+    m_Stacking.Raise(window);
+    window.SetFocus();
+    m_FocusedWindow = m_WindowPool.GetHandle(&window);
+}
+
+void WindowManager::MapWindow(PharaohWindow& window)
+{
+    window.Map(m_Frames);
+    if(true == window.IsMapped())
+    {
+        m_Stacking.Add(window);
+        m_Spatial.Update(window);
+        m_Snap.Update(window);
+    }
+}
+
+void WindowManager::UnmapWindow(PharaohWindow& window)
+{
+    m_Switcher.Remove(*m_pBackend, window);
+    m_Stacking.Remove(window);
+    m_Spatial.Remove(window);
+    m_Snap.Remove(window);
+    window.Unmap(m_Frames);
+}
+
+void WindowManager::OnKeyRelease(const xcb_key_release_event_t& e)
+{
+    // letting go of the last of the binding's modifiers switches to the selected window.
+    // The state is from before the release, so it still has the key's own modifier.
+    // Shift can come and go while Alt is held for Alt+Shift+Tab.
+    if(true == m_Switcher.IsOpen())
+    {
+        uint16_t held = e.state & ~m_KeySymbols.GetModifierMask(e.detail);
+        if((held & m_SwitcherModifiers) == 0)
+        {
+            CloseSwitcher(true);
+        }
+    }
+}
+
+void WindowManager::OnExpose(const xcb_expose_event_t& e)
+{
+    // drawn at the end of the batch, however many pieces of it were exposed
+    if(true == m_Switcher.IsOpen() && e.window == m_Switcher.GetWindow())
+    {
+        m_Switcher.Invalidate();
+    }
+}
+
+//--------------------------------------------------------------------------------
+// Error handling
+//--------------------------------------------------------------------------------
+
+void WindowManager::OnXError(const xcb_generic_error_t& e)
+{
+    LOG_WARNING << "Received X error:"
+         << " request " << int(e.major_code)
+         << " - " << XRequestCodeToString(e.major_code)
+         << ", error code " << int(e.error_code)
+         << " - " << XErrorCodeToString(e.error_code)
+         << ", resource ID " << e.resource_id;
 }
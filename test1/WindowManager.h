@@ -9,11 +9,33 @@
 #ifndef WINDOWMANAGER_H_INCLUDED
 #define WINDOWMANAGER_H_INCLUDED
 
-#include <X11/Xlib.h>
-#include <map>
+#include <xcb/xcb.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <set>
+#include <string>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
+#include "Logger.h"
+#include "XBackend.h"
+#include "Compositor.h"
+#include "EventTrace.h"
+#include "FramePool.h"
+#include "KeyBindings.h"
+#include "KeySymbols.h"
+#include "LatencyHistogram.h"
+#include "MainLoop.h"
+#include "SlabPool.h"
+#include "SnapEdges.h"
+#include "SpatialIndex.h"
+#include "StackingOrder.h"
+#include "TaskSwitcher.h"
 #include "Window.h"
+#include "WindowTable.h"
 
 namespace Pharaoh
 {
@@ -25,54 +47,208 @@ namespace Pharaoh
 
         int Run();
 
+        //! \brief  Take over the display, and frame the windows already on it.
+        //!         Run does this itself, it's public so a benchmark can drive the
+        //!         window manager against a FakeXServer.
+        //! \param backend The X server to use. Must outlive the window manager.
+        //! \param manageDisplay false to skip selecting the root window events and
+        //!         adopting existing windows, for replays.
+        //! \return 0 on success, -2 if another window manager is running.
+        int Initialise(Emperor::XBackend& backend, bool manageDisplay = true);
+
+        //! \brief  Handle every event the server has sent so far as one batch, then
+        //!         flush the requests they generated.
+        void ProcessEvents();
+
+        //! \brief  Print how many times each event handler has had to wait on the server.
+        //!         Also printed on SIGUSR1 and at exit.
+        void ReportRoundTrips() const;
+
+        //! \brief  Log how many windows there are and how much memory holds them, and
+        //!         how often a frame was reused. Also logged on SIGUSR1 and at exit.
+        void ReportWindowPool() const;
+
+        //! \brief  Log how often the compositor repainted and how much, when it's on.
+        //!         Also logged on SIGUSR1 and at exit.
+        void ReportCompositing() const;
+
+        //! \brief  Write the handler latency and queue delay percentiles of each event
+        //!         type, as a single line of JSON. On SIGUSR1 and at exit they go to the
+        //!         --stats file if there is one.
+        void ReportLatency(std::ostream& out) const;
+
     private:
-        void OnCreateNotify(const XCreateWindowEvent& e);
-        void OnConfigureRequest(const XConfigureRequestEvent& e);
-        void OnConfigureNotify(const XConfigureEvent& e);
-        void OnMapRequest(const XMapRequestEvent& e);
-        void OnReparentNotify(const XReparentEvent& e);
-        void OnMapNotify(const XMapEvent& e);
-        void OnUnmapNotify(const XUnmapEvent& e);
-        void OnDestroyNotify(const XDestroyWindowEvent& e);
-        void OnButtonPress(const XButtonEvent& e);
-        void OnButtonRelease(const XButtonEvent& e);
-        void OnMotionNotify(const XMotionEvent& e);
-        void OnKeyPress(const XKeyEvent& e);
-        void OnKeyRelease(const XKeyEvent& e);
-
-        static int OnXError(Display* pDisplay, XErrorEvent* pEvent);
-        static int OnWMDetected(Display* pDisplay, XErrorEvent* pEvent);
+        void OnCreateNotify(const xcb_create_notify_event_t& e);
+        void OnConfigureRequest(const xcb_configure_request_event_t& e);
+        void OnConfigureNotify(const xcb_configure_notify_event_t& e);
+        void OnMapRequest(const xcb_map_request_event_t& e);
+        void OnReparentNotify(const xcb_reparent_notify_event_t& e);
+        void OnMapNotify(const xcb_map_notify_event_t& e);
+        void OnUnmapNotify(const xcb_unmap_notify_event_t& e);
+        void OnDestroyNotify(const xcb_destroy_notify_event_t& e);
+        void OnButtonPress(const xcb_button_press_event_t& e);
+        void OnButtonRelease(const xcb_button_release_event_t& e);
+        void OnMotionNotify(const xcb_motion_notify_event_t& e);
+        void OnCounterAlarm(uint32_t alarm);
+        void ApplyDragOperation(bool finished);
+        void OnKeyPress(const xcb_key_press_event_t& e);
+        void OnKeyRelease(const xcb_key_release_event_t& e);
+        void OnMappingNotify(const xcb_mapping_notify_event_t& e);
+        void OnExpose(const xcb_expose_event_t& e);
+        void CloseWindow(xcb_window_t window);
+        void FocusNextWindow(PharaohWindow& window);
+        void OpenSwitcher(PharaohWindow& window, uint16_t modifiers);
+        void CloseSwitcher(bool switchWindow);
+        void Focus(PharaohWindow& window);
+        void MapWindow(PharaohWindow& window);
+        void UnmapWindow(PharaohWindow& window);
+
+        void OnXError(const xcb_generic_error_t& e);
+        void GrabRootInput();
+        void AdoptExistingWindows();
         int EventLoop();
+        void DispatchEventBatch();
+        int ReplayTrace(const std::string& path);
+        void DispatchEvent(const xcb_generic_event_t* pEvent);
+        void CompressMotionEvents();
+        void DropStaleMapRequests();
+        void RecordEventBatch(unsigned int batchSize);
+        void ReportEventBatches() const;
 
-        Display* m_pXDisplay;
-        Window m_RootWindow;
+        struct EventLatency;
+        static bool GetEventTime(const xcb_generic_event_t* pEvent, xcb_timestamp_t& time);
+        void RecordQueueDelay(EventLatency& latency, xcb_timestamp_t serverTime, std::chrono::steady_clock::time_point handlerStart);
+        void DumpStatistics() const;
+        std::string GetEventTypeName(size_t eventType) const;
+
+        enum DragType
+        {
+            DragType_Move,
+            DragType_ResizeHorizonal,
+            DragType_ResizeVertical,
+            DragType_ResizeAll
+        };
+
+        struct DragOperation;
+        void StartDragOperation(PharaohWindow& window, const xcb_button_press_event_t& e, DragType dragType);
+        void ReadDragProperties(xcb_window_t window, DragOperation& drag);
+        void ShowOutline(const PharaohWindow& window, int x, int y, unsigned int width, unsigned int height);
+        void HideOutline();
+        void SendSyncRequest(xcb_window_t window, DragOperation& drag);
+        bool GetEdgeSnapArea(int cursorX, int cursorY, xcb_rectangle_t& area) const;
+        void SnapToEdges(const PharaohWindow& window, const DragOperation& drag, int& x, int& y, unsigned int& width, unsigned int& height) const;
+
+        // the backend Run created, if it created one
+        std::unique_ptr<Emperor::XBackend> m_xBackend;
+        Emperor::XBackend* m_pBackend = nullptr;
+        xcb_window_t m_RootWindow;
         int m_argc;
         char** m_argv;
 
-        // map the XWindows to their handler classes 
-        // (the Window key is the handle for the un-framed client window)
-        std::map<Window, std::unique_ptr<PharaohWindow>> m_Clients;
-        std::map<Window, PharaohWindow*> m_FramesToClients;
-        std::set<Window> m_DecorationWindows;
+        Emperor::LogCallback m_LogCallback;
+        KeySymbols m_KeySymbols;
+        KeyBindings m_KeyBindings;
+        MainLoop m_MainLoop;
 
-        int m_DragCursorStartX = 0;
-        int m_DragCursorStartY = 0;
-        int m_DragFrameStartX = 0;
-        int m_DragFrameStartY = 0;
-        int m_DragFrameStartWidth = 0;
-        int m_DragFrameStartHeight = 0;
+        // event tracing
+        std::string m_RecordPath;
+        std::string m_ReplayPath;
+        bool m_Headless = false;
+        std::string m_BinaryLogPath;
+        int m_BinaryLogFd = -1;
+        EventTraceWriter m_TraceWriter;
+
+        // the events read in the current batch
+        std::vector<xcb_generic_event_t*> m_EventBatch;
+
+        // the PharaohWindows, and every window we know about: clients, their frames
+        // and our own decorations
+        typedef SlabPool<PharaohWindow> WindowPool;
+        WindowPool m_WindowPool;
+        WindowTable m_Windows;
+
+        // where windows get their frames, and give them back. Windows are mapped and
+        // unmapped through this rather than the table.
+        static const size_t DEFAULT_IDLE_FRAMES = 16;
+        FramePool m_Frames { m_Windows, DEFAULT_IDLE_FRAMES };
+
+        // the mapped windows, bottom to top, by where their frames are on screen, and
+        // the edges of their frames and the monitors for dragged windows to snap to
+        StackingOrder m_Stacking;
+        SpatialIndex m_Spatial;
+        SnapEdges m_Snap;
+
+        // where the top-level windows we don't manage yet are, kept up to date from
+        // their events so taking one on needs no round trip. Override-redirect windows
+        // are left out, they never ask to be mapped.
+        std::unordered_map<xcb_window_t, Emperor::XBackend::WindowGeometry> m_UnmanagedGeometry;
+
+        // the window we last gave the focus to, which the keyboard shortcuts act on
+        WindowPool::Handle m_FocusedWindow;
 
-        struct DragOperation;
         std::unique_ptr<DragOperation> m_xCurrentDragOperation;
 
-        int m_NewDragCursorStartX = 0;
-        int m_NewDragCursorStartY = 0;
-        
-        Atom WM_PROTOCOLS;
-        Atom WM_DELETE_WINDOW;
+        // Alt+Tab shows thumbnails when the server can draw them for us, and just moves
+        // the focus on when it can't
+        bool m_Thumbnails = false;
+        TaskSwitcher m_Switcher;
+
+        // the modifiers of the binding that opened the switcher, which close it when
+        // they're let go
+        uint16_t m_SwitcherModifiers = 0;
+
+        // with --composite, and a server that can, we draw the windows ourselves
+        bool m_Composite = false;
+        std::unique_ptr<Compositor> m_xCompositor;
+
+        // drags are drawn once per screen refresh when the main loop is running
+        bool m_FramePacing = false;
+        MainLoop::Clock::duration m_FramePeriod;
+        MainLoop::TimerId m_DragTimer = 0;
+
+        // the last value asked for in a _NET_WM_SYNC_REQUEST
+        uint64_t m_SyncRequestValue = 0;
+
+        // window classes that are dragged as an outline (--wireframe), and the outline
+        // while one is being dragged
+        std::set<std::string> m_WireframeClasses;
+        std::array<xcb_window_t, 4> m_OutlineWindows = {{ XCB_WINDOW_NONE, XCB_WINDOW_NONE, XCB_WINDOW_NONE, XCB_WINDOW_NONE }};
+        bool m_OutlineShown = false;
+
+        // event batching statistics
+        unsigned long m_EventBatchCount = 0;
+        unsigned long m_EventBatchEventCount = 0;
+        unsigned int m_LargestEventBatch = 0;
+
+        // round trips made by each event handler, indexed by event type
+        struct HandlerRoundTrips
+        {
+            uint64_t events = 0;
+            uint64_t roundTrips = 0;
+        };
+        std::array<HandlerRoundTrips, 128> m_HandlerRoundTrips;
+        uint64_t m_StartupRoundTrips = 0;
+        size_t m_AdoptedWindows = 0;
+        std::chrono::steady_clock::duration m_AdoptionTime = std::chrono::steady_clock::duration::zero();
+
+        // how long each event type waited to be handled, and how long handling took.
+        // Indexed by event type, created on first use.
+        struct EventLatency
+        {
+            LatencyHistogram handler;
+            LatencyHistogram queueDelay;
+        };
+        std::array<std::unique_ptr<EventLatency>, 128> m_EventLatency;
+        int32_t m_ServerClockOffset = 0;
+        bool m_HaveServerClockOffset = false;
+        std::string m_StatsPath;
+
+        xcb_atom_t WM_PROTOCOLS;
+        xcb_atom_t WM_DELETE_WINDOW;
+        xcb_atom_t _NET_WM_SYNC_REQUEST;
+        xcb_atom_t _NET_WM_SYNC_REQUEST_COUNTER;
 
         static WindowManager* m_pInstance;
-        static bool m_WMDetected;
     };
 }
 
@@ -0,0 +1,164 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "WindowTable.h"
+#include "Window.h"
+
+using namespace Pharaoh;
+using namespace std;
+
+const size_t WindowTable::INITIAL_CAPACITY;
+
+//--------------------------------------------------------------------------------
+// Ctor
+//--------------------------------------------------------------------------------
+
+WindowTable::WindowTable()
+    : m_xEntries(new Entry[INITIAL_CAPACITY]())
+    , m_Capacity(INITIAL_CAPACITY)
+    , m_HashShift(32 - 6) // 2^6 == INITIAL_CAPACITY
+{
+}
+
+//--------------------------------------------------------------------------------
+// Lookup
+//--------------------------------------------------------------------------------
+
+const WindowTable::Entry* WindowTable::Find(xcb_window_t window) const
+{
+    if(window == XCB_WINDOW_NONE)
+    {
+        return nullptr;
+    }
+
+    const Entry& entry = m_xEntries[FindSlot(window)];
+    return (entry.window == window) ? &entry : nullptr;
+}
+
+PharaohWindow* WindowTable::Find(xcb_window_t window, WindowRole role) const
+{
+    const Entry* pEntry = Find(window);
+    return (pEntry != nullptr && pEntry->role == role) ? pEntry->pWindow : nullptr;
+}
+
+size_t WindowTable::GetCount() const
+{
+    return m_Count;
+}
+
+//--------------------------------------------------------------------------------
+// Insert & Erase
+//--------------------------------------------------------------------------------
+
+void WindowTable::Insert(xcb_window_t window, WindowRole role, PharaohWindow* pWindow)
+{
+    // keep the table at most three quarters full, so probe runs stay short
+    if((m_Count + 1) * 4 > m_Capacity * 3)
+    {
+        Grow();
+    }
+
+    Entry& entry = m_xEntries[FindSlot(window)];
+    if(entry.window != window)
+    {
+        entry.window = window;
+        m_Count++;
+    }
+    entry.role = role;
+    entry.pWindow = pWindow;
+}
+
+void WindowTable::Erase(xcb_window_t window)
+{
+    size_t hole = FindSlot(window);
+    if(m_xEntries[hole].window != window || window == XCB_WINDOW_NONE)
+    {
+        return;
+    }
+
+    // move any later entries of the probe run back into the hole, if they can
+    // legitimately live there, so that no lookup ever has to skip a deleted slot
+    const size_t mask = m_Capacity - 1;
+    size_t slot = hole;
+    for(;;)
+    {
+        slot = (slot + 1) & mask;
+        const Entry& entry = m_xEntries[slot];
+        if(entry.window == XCB_WINDOW_NONE)
+        {
+            break;
+        }
+
+        // distance from the entry's home slot to the hole, and to where it is now
+        size_t home = GetHomeSlot(entry.window);
+        if(((hole - home) & mask) < ((slot - home) & mask))
+        {
+            m_xEntries[hole] = entry;
+            hole = slot;
+        }
+    }
+
+    m_xEntries[hole] = Entry();
+    m_Count--;
+}
+
+//--------------------------------------------------------------------------------
+// FrameRegistry
+//--------------------------------------------------------------------------------
+
+void WindowTable::AddFrame(xcb_window_t frame, Emperor::ReparentingWindow& window)
+{
+    Insert(frame, WindowRole_Frame, static_cast<PharaohWindow*>(&window));
+}
+
+void WindowTable::RemoveFrame(xcb_window_t frame)
+{
+    Erase(frame);
+}
+
+//--------------------------------------------------------------------------------
+// Private helpers
+//--------------------------------------------------------------------------------
+
+size_t WindowTable::GetHomeSlot(xcb_window_t window) const
+{
+    // XIDs from one client are sequential, multiplying by 2^32 / phi spreads
+    // them over the table, and the top bits are the best mixed
+    return (size_t)((uint32_t)(window * 0x9E3779B9u) >> m_HashShift);
+}
+
+size_t WindowTable::FindSlot(xcb_window_t window) const
+{
+    // the slot holding the window, or the empty slot where it would go
+    const size_t mask = m_Capacity - 1;
+    size_t slot = GetHomeSlot(window);
+    while(m_xEntries[slot].window != window && m_xEntries[slot].window != XCB_WINDOW_NONE)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void WindowTable::Grow()
+{
+    unique_ptr<Entry[]> xOldEntries(move(m_xEntries));
+    size_t oldCapacity = m_Capacity;
+
+    m_Capacity *= 2;
+    m_HashShift--;
+    m_xEntries.reset(new Entry[m_Capacity]());
+
+    for(size_t i = 0; i < oldCapacity; i++)
+    {
+        const Entry& entry = xOldEntries[i];
+        if(entry.window != XCB_WINDOW_NONE)
+        {
+            m_xEntries[FindSlot(entry.window)] = entry;
+        }
+    }
+}
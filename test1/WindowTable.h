@@ -0,0 +1,81 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#ifndef WINDOWTABLE_H_INCLUDED
+#define WINDOWTABLE_H_INCLUDED
+
+#include <xcb/xcb.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "ReparentingWindow.h"
+
+namespace Pharaoh
+{
+    class PharaohWindow;
+
+    enum WindowRole : uint8_t
+    {
+        WindowRole_None,
+        WindowRole_Client,      // a client's own window
+        WindowRole_Frame,       // the frame we put around a client
+        WindowRole_Decoration   // any other window of ours (drag outlines, etc)
+    };
+
+    //! \brief  Every X window the window manager knows about, in one open addressing hash
+    //!         table keyed by XID. Each entry says what the window is to us, so any event
+    //!         is resolved to its PharaohWindow with a single lookup, usually one cache
+    //!         line. Linear probing, with backward shift deletion so there are no
+    //!         tombstones to slow lookups down as windows come and go.
+    //!         The table doesn't own the PharaohWindows.
+    class WindowTable : public Emperor::FrameRegistry
+    {
+    public:
+        struct Entry
+        {
+            xcb_window_t window;    // XCB_WINDOW_NONE for an empty slot
+            WindowRole role;
+            PharaohWindow* pWindow; // nullptr for decorations
+        };
+
+        WindowTable();
+
+        //! \brief Find a window, nullptr if it isn't in the table.
+        const Entry* Find(xcb_window_t window) const;
+
+        //! \brief Find a window in a particular role, nullptr if it isn't there or has a different role.
+        PharaohWindow* Find(xcb_window_t window, WindowRole role) const;
+
+        //! \brief Add a window, or change what an existing one is.
+        void Insert(xcb_window_t window, WindowRole role, PharaohWindow* pWindow);
+
+        //! \brief Remove a window. Does nothing if it isn't there.
+        void Erase(xcb_window_t window);
+
+        size_t GetCount() const;
+
+        // FrameRegistry - only PharaohWindows are ever mapped, so that's what these are
+        void AddFrame(xcb_window_t frame, Emperor::ReparentingWindow& window) override;
+        void RemoveFrame(xcb_window_t frame) override;
+
+    private:
+        size_t GetHomeSlot(xcb_window_t window) const;
+        size_t FindSlot(xcb_window_t window) const;
+        void Grow();
+
+        static const size_t INITIAL_CAPACITY = 64; // must be a power of two
+
+        std::unique_ptr<Entry[]> m_xEntries;
+        size_t m_Capacity = 0;
+        size_t m_Count = 0;
+        unsigned int m_HashShift = 0;
+    };
+}
+
+#endif
@@ -200,7 +200,7 @@ Button::~Button()
 		if(pError != nullptr)
 		{
 			// failed to free pixmap
-            LogError("Failed to free button pixmap " + to_string(i));
+            LogError("Failed to free button pixmap ", i);
 			free(pError);
 		}
 
@@ -0,0 +1,75 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "Logger.h"
+
+using namespace std;
+using namespace Emperor;
+
+// Turns a binary log, written through LogBuffer::SetBinaryOutput, back into text.
+//
+//   logdecode FILE
+
+int main(int argc, char** argv)
+{
+	if(argc != 2)
+	{
+		cerr << "usage: " << argv[0] << " FILE" << endl;
+		return -1;
+	}
+
+	ifstream file(argv[1], ios::binary);
+	if(false == file.is_open())
+	{
+		cerr << "Failed to open " << argv[1] << endl;
+		return -1;
+	}
+	vector<uint8_t> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+	if(data.size() < sizeof(LogBuffer::FILE_MAGIC) || memcmp(data.data(), LogBuffer::FILE_MAGIC, sizeof(LogBuffer::FILE_MAGIC)) != 0)
+	{
+		cerr << argv[1] << " is not a binary log" << endl;
+		return -1;
+	}
+
+	const char* const levelPrefixes[] =
+	{
+		"[ DEBUG ]",
+		"[MESSAGE]",
+		"[WARNING]",
+		"[ ERROR ]",
+	};
+
+	// times are shown relative to the first record
+	bool haveStartTime = false;
+	uint64_t startTime = 0;
+	LogBuffer::Decode(
+		data.data() + sizeof(LogBuffer::FILE_MAGIC),
+		data.size() - sizeof(LogBuffer::FILE_MAGIC),
+		[&](LogLevel level, uint64_t time, uint64_t callback, const string& text)
+		{
+			if(false == haveStartTime)
+			{
+				startTime = time;
+				haveStartTime = true;
+			}
+
+			char timestamp[32];
+			snprintf(timestamp, sizeof(timestamp), "%12.6f ", (double)(time - startTime) / 1e9);
+			cout << timestamp << levelPrefixes[(level <= LogLevel_Error) ? level : LogLevel_Error] << text << "\n";
+		});
+
+	return 0;
+}
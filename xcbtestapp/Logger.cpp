@@ -1,16 +1,47 @@
 /********************************************************************************
 *
-* WARNING This file is subject to the termsand conditions defined in the file
-* 'LICENSE.txt', which is part of this source code package.Please ensure you
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
 * have read the 'LICENSE.txt' file before using this software.
 *
 *********************************************************************************/
 
 #include "Logger.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
 
 using namespace std;
 using namespace Emperor;
 
+//--------------------------------------------------------------------------------
+// static data
+//--------------------------------------------------------------------------------
+
+const size_t LogBuffer::MAX_STRING_LENGTH;
+const size_t LogBuffer::BUFFER_SIZE;
+const char LogBuffer::FILE_MAGIC[8] = { 'E', 'M', 'P', 'L', 'O', 'G', '1', '\n' };
+
+// where records go in binary form, -1 to turn them into text in-process
+static atomic<int> s_BinaryOutputFd(-1);
+
+static void WriteAll(int fd, const void* pData, size_t size)
+{
+	const uint8_t* pBytes = (const uint8_t*)pData;
+	while(size > 0)
+	{
+		ssize_t result = write(fd, pBytes, size);
+		if(result <= 0)
+		{
+			// nowhere to put it, carry on regardless
+			return;
+		}
+		pBytes += result;
+		size -= result;
+	}
+}
+
 //--------------------------------------------------------------------------------
 // LogCallback
 //--------------------------------------------------------------------------------
@@ -28,6 +59,11 @@ LogCallback::LogCallback(
 
 }
 
+LogCallback::~LogCallback()
+{
+	LogBuffer::GetThreadBuffer().Flush();
+}
+
 void LogCallback::LogDebug(const string& msg) const
 {
 	m_LogDebug(msg);
@@ -48,42 +84,246 @@ void LogCallback::LogError(const string& msg) const
 	m_LogError(msg);
 }
 
+void LogCallback::Log(LogLevel level, const string& msg) const
+{
+	switch(level)
+	{
+	case LogLevel_Debug:
+		LogDebug(msg);
+		break;
+	case LogLevel_Message:
+		LogMessage(msg);
+		break;
+	case LogLevel_Warning:
+		LogWarning(msg);
+		break;
+	default:
+		LogError(msg);
+		break;
+	}
+}
+
 //--------------------------------------------------------------------------------
-// Logger
+// LogBuffer
 //--------------------------------------------------------------------------------
 
-Logger::Logger(LogCallback& logger)
-	: m_LogCallback(logger)
+LogBuffer& LogBuffer::GetThreadBuffer()
+{
+	static thread_local LogBuffer buffer;
+	return buffer;
+}
+
+LogBuffer::LogBuffer()
 {
 
 }
 
-LogCallback& Logger::GetLogger() const
+LogBuffer::~LogBuffer()
 {
-	return const_cast<LogCallback&>(m_LogCallback);
+	Flush();
 }
 
-void Logger::SetLoggingName(const string& name)
+bool LogBuffer::BeginRecord(LogLevel level, const LogCallback& callback, const string& name, unsigned int argumentCount, size_t argumentsSize)
 {
-	m_LoggingName = name;
+	// anything logged by the callbacks while we're flushing is lost, rather than
+	// written into the buffer being read
+	if(true == m_Flushing)
+	{
+		return false;
+	}
+
+	size_t nameLength = min(name.length(), MAX_STRING_LENGTH);
+	size_t recordSize = sizeof(RecordHeader) + nameLength + argumentsSize;
+	if(recordSize > BUFFER_SIZE || argumentCount > 255)
+	{
+		return false;
+	}
+	if(m_Used + recordSize > BUFFER_SIZE)
+	{
+		Flush();
+	}
+
+	RecordHeader header;
+	header.size = (uint32_t)recordSize;
+	header.level = level;
+	header.argumentCount = (uint8_t)argumentCount;
+	header.nameLength = (uint16_t)nameLength;
+	header.time = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+	header.callback = (uint64_t)(uintptr_t)&callback;
+
+	m_RecordStart = m_Used;
+	m_RecordLevel = level;
+	Write(&header, sizeof(header));
+	Write(name.data(), nameLength);
+	return true;
 }
 
-void Logger::LogDebug(const string& msg) const
+void LogBuffer::Write(const void* pData, size_t size)
 {
-	m_LogCallback.LogDebug("[" + m_LoggingName + "] " + msg);
+	memcpy(m_Buffer + m_Used, pData, size);
+	m_Used += size;
 }
 
-void Logger::LogMessage(const string& msg) const
+void LogBuffer::EndRecord()
 {
-	m_LogCallback.LogMessage("[" + m_LoggingName + "] " + msg);
+	// errors go straight out - they're what you want to see if we're about to die
+	if(m_RecordLevel == LogLevel_Error)
+	{
+		Flush();
+	}
 }
 
-void Logger::LogWarning(const string& msg) const
+void LogBuffer::Flush()
 {
-	m_LogCallback.LogWarning("[" + m_LoggingName + "] " + msg);
+	if(m_Used == 0 || true == m_Flushing)
+	{
+		return;
+	}
+
+	m_Flushing = true;
+	int fd = s_BinaryOutputFd.load();
+	if(fd != -1)
+	{
+		WriteAll(fd, m_Buffer, m_Used);
+	}
+	else
+	{
+		Decode(m_Buffer, m_Used, [](LogLevel level, uint64_t time, uint64_t callback, const string& text)
+		{
+			((const LogCallback*)(uintptr_t)callback)->Log(level, text);
+		});
+	}
+	m_Used = 0;
+	m_Flushing = false;
+}
+
+void LogBuffer::SetBinaryOutput(int fd)
+{
+	// what's already here was logged under the old setting
+	GetThreadBuffer().Flush();
+	if(fd != -1)
+	{
+		WriteAll(fd, FILE_MAGIC, sizeof(FILE_MAGIC));
+	}
+	s_BinaryOutputFd.store(fd);
+}
+
+void LogBuffer::Decode(
+	const uint8_t* pData,
+	size_t size,
+	const function<void(LogLevel, uint64_t, uint64_t, const string&)>& output)
+{
+	size_t offset = 0;
+	while(offset + sizeof(RecordHeader) <= size)
+	{
+		RecordHeader header;
+		memcpy(&header, pData + offset, sizeof(header));
+		if(header.size < sizeof(header) + header.nameLength || offset + header.size > size)
+		{
+			// corrupt or cut short, nothing after this can be trusted
+			return;
+		}
+
+		const uint8_t* pRecord = pData + offset + sizeof(header);
+		const uint8_t* pEnd = pData + offset + header.size;
+		string text = "[";
+		text.append((const char*)pRecord, header.nameLength);
+		text += "] ";
+		pRecord += header.nameLength;
+
+		for(unsigned int i = 0; i < header.argumentCount && pRecord < pEnd; i++)
+		{
+			ArgumentTag tag = (ArgumentTag)*pRecord++;
+			size_t remaining = pEnd - pRecord;
+			char number[32];
+			switch(tag)
+			{
+			case ArgumentTag_Signed:
+			{
+				int64_t value = 0;
+				memcpy(&value, pRecord, min(sizeof(value), remaining));
+				snprintf(number, sizeof(number), "%lld", (long long)value);
+				text += number;
+				pRecord += sizeof(value);
+				break;
+			}
+			case ArgumentTag_Unsigned:
+			{
+				uint64_t value = 0;
+				memcpy(&value, pRecord, min(sizeof(value), remaining));
+				snprintf(number, sizeof(number), "%llu", (unsigned long long)value);
+				text += number;
+				pRecord += sizeof(value);
+				break;
+			}
+			case ArgumentTag_Double:
+			{
+				double value = 0.0;
+				memcpy(&value, pRecord, min(sizeof(value), remaining));
+				snprintf(number, sizeof(number), "%g", value);
+				text += number;
+				pRecord += sizeof(value);
+				break;
+			}
+			case ArgumentTag_Char:
+				if(remaining > 0)
+				{
+					text += (char)*pRecord;
+				}
+				pRecord += 1;
+				break;
+			case ArgumentTag_Bool:
+				if(remaining > 0)
+				{
+					text += (*pRecord != 0) ? "true" : "false";
+				}
+				pRecord += 1;
+				break;
+			case ArgumentTag_String:
+			{
+				uint16_t length = 0;
+				memcpy(&length, pRecord, min(sizeof(length), remaining));
+				pRecord += sizeof(length);
+				if(pRecord + length <= pEnd)
+				{
+					text.append((const char*)pRecord, length);
+				}
+				pRecord += length;
+				break;
+			}
+			default:
+				// unknown tag, the rest of the record can't be read
+				pRecord = pEnd;
+				break;
+			}
+		}
+
+		output(header.level, header.time, header.callback, text);
+		offset += header.size;
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Logger
+//--------------------------------------------------------------------------------
+
+Logger::Logger(LogCallback& logger)
+	: m_LogCallback(logger)
+{
+
+}
+
+LogCallback& Logger::GetLogger() const
+{
+	return const_cast<LogCallback&>(m_LogCallback);
+}
+
+void Logger::SetLoggingName(const string& name)
+{
+	m_LoggingName = name;
 }
 
-void Logger::LogError(const string& msg) const
+void Logger::FlushThreadLog()
 {
-	m_LogCallback.LogError("[" + m_LoggingName + "] " + msg);
+	LogBuffer::GetThreadBuffer().Flush();
 }
@@ -8,11 +8,32 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <functional>
 
+// Log calls below this level compile to nothing. Debug builds keep everything.
+#ifndef EMPEROR_LOG_LEVEL
+#ifdef DEBUG
+#define EMPEROR_LOG_LEVEL 0
+#else
+#define EMPEROR_LOG_LEVEL 1
+#endif
+#endif
+
 namespace Emperor
 {
+	enum LogLevel : uint8_t
+	{
+		LogLevel_Debug,
+		LogLevel_Message,
+		LogLevel_Warning,
+		LogLevel_Error
+	};
+
 	class LogCallback
 	{
 	public:
@@ -22,11 +43,16 @@ namespace Emperor
 			std::function<void(const std::string&)> logWarning,
 			std::function<void(const std::string&)> logError);
 
+		//! Flushes this thread's log buffer, which may hold lines for this callback.
+		~LogCallback();
+
 		void LogDebug(const std::string& msg) const;
 		void LogMessage(const std::string& msg) const;
 		void LogWarning(const std::string& msg) const;
 		void LogError(const std::string& msg) const;
 
+		void Log(LogLevel level, const std::string& msg) const;
+
 	private:
 		std::function<void(const std::string&)> m_LogDebug;
 		std::function<void(const std::string&)> m_LogMessage;
@@ -34,15 +60,135 @@ namespace Emperor
 		std::function<void(const std::string&)> m_LogError;
 	};
 
+	// Log lines are kept in binary form - the arguments as they were passed, not text -
+	// in a fixed buffer per thread. They're only turned into text when the buffer is
+	// flushed: when it fills, after an error, when the owner of the thread asks, or
+	// never, if the binary form is being written out for logdecode to read later.
+	class LogBuffer
+	{
+	public:
+		// every record starts with this
+		struct RecordHeader
+		{
+			uint32_t size;          // including this header
+			LogLevel level;
+			uint8_t argumentCount;
+			uint16_t nameLength;    // the logging name follows the header
+			uint64_t time;          // nanoseconds, steady clock
+			uint64_t callback;      // the LogCallback to send it to, meaningless outside this process
+		};
+
+		// and is followed by its arguments, each a tag and then the value
+		enum ArgumentTag : uint8_t
+		{
+			ArgumentTag_Signed,     // int64_t
+			ArgumentTag_Unsigned,   // uint64_t
+			ArgumentTag_Double,     // double
+			ArgumentTag_Char,       // char
+			ArgumentTag_Bool,       // uint8_t
+			ArgumentTag_String      // uint16_t length, then the characters
+		};
+
+		// strings longer than this are cut short
+		static const size_t MAX_STRING_LENGTH = 1024;
+
+		// written at the start of a binary log file
+		static const char FILE_MAGIC[8];
+
+		static LogBuffer& GetThreadBuffer();
+
+		~LogBuffer();
+
+		//! \brief  Start a record. Flushes first if it won't fit.
+		//! \return false if the record can't be taken, and shouldn't be written.
+		bool BeginRecord(LogLevel level, const LogCallback& callback, const std::string& name, unsigned int argumentCount, size_t argumentsSize);
+		void Write(const void* pData, size_t size);
+		void EndRecord();
+
+		//! \brief Send everything in the buffer on, as text or to the binary output.
+		void Flush();
+
+		//! \brief  Write records to this file descriptor in binary form instead of
+		//!         sending them to the callbacks as text. -1 to go back to text.
+		static void SetBinaryOutput(int fd);
+
+		//! \brief Turn a run of records back into text.
+		//! \param output Called for every record with its level, time, callback and text.
+		static void Decode(
+			const uint8_t* pData,
+			size_t size,
+			const std::function<void(LogLevel, uint64_t, uint64_t, const std::string&)>& output);
+
+	private:
+		LogBuffer();
+
+		static const size_t BUFFER_SIZE = 64 * 1024;
+
+		uint8_t m_Buffer[BUFFER_SIZE];
+		size_t m_Used = 0;
+		size_t m_RecordStart = 0;
+		bool m_Flushing = false;
+		LogLevel m_RecordLevel = LogLevel_Debug;
+	};
+
+	// how much space each argument type takes, and how it's written
+	namespace LogArgument
+	{
+		inline size_t GetSize(long long) { return 1 + sizeof(int64_t); }
+		inline size_t GetSize(long) { return 1 + sizeof(int64_t); }
+		inline size_t GetSize(int) { return 1 + sizeof(int64_t); }
+		inline size_t GetSize(unsigned long long) { return 1 + sizeof(uint64_t); }
+		inline size_t GetSize(unsigned long) { return 1 + sizeof(uint64_t); }
+		inline size_t GetSize(unsigned int) { return 1 + sizeof(uint64_t); }
+		inline size_t GetSize(double) { return 1 + sizeof(double); }
+		inline size_t GetSize(char) { return 1 + sizeof(char); }
+		inline size_t GetSize(bool) { return 1 + sizeof(uint8_t); }
+		inline size_t GetSize(const char* pText) { return 1 + sizeof(uint16_t) + std::min(strlen(pText), LogBuffer::MAX_STRING_LENGTH); }
+		inline size_t GetSize(const std::string& text) { return 1 + sizeof(uint16_t) + std::min(text.length(), LogBuffer::MAX_STRING_LENGTH); }
+
+		template<typename T>
+		inline void WriteTagged(LogBuffer& buffer, LogBuffer::ArgumentTag tag, T value)
+		{
+			buffer.Write(&tag, 1);
+			buffer.Write(&value, sizeof(value));
+		}
+
+		inline void WriteString(LogBuffer& buffer, const char* pText, size_t length)
+		{
+			uint16_t storedLength = (uint16_t)std::min(length, LogBuffer::MAX_STRING_LENGTH);
+			LogBuffer::ArgumentTag tag = LogBuffer::ArgumentTag_String;
+			buffer.Write(&tag, 1);
+			buffer.Write(&storedLength, sizeof(storedLength));
+			buffer.Write(pText, storedLength);
+		}
+
+		inline void Write(LogBuffer& buffer, long long value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Signed, (int64_t)value); }
+		inline void Write(LogBuffer& buffer, long value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Signed, (int64_t)value); }
+		inline void Write(LogBuffer& buffer, int value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Signed, (int64_t)value); }
+		inline void Write(LogBuffer& buffer, unsigned long long value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Unsigned, (uint64_t)value); }
+		inline void Write(LogBuffer& buffer, unsigned long value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Unsigned, (uint64_t)value); }
+		inline void Write(LogBuffer& buffer, unsigned int value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Unsigned, (uint64_t)value); }
+		inline void Write(LogBuffer& buffer, double value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Double, value); }
+		inline void Write(LogBuffer& buffer, char value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Char, value); }
+		inline void Write(LogBuffer& buffer, bool value) { WriteTagged(buffer, LogBuffer::ArgumentTag_Bool, (uint8_t)value); }
+		inline void Write(LogBuffer& buffer, const char* pText) { WriteString(buffer, pText, strlen(pText)); }
+		inline void Write(LogBuffer& buffer, const std::string& text) { WriteString(buffer, text.data(), text.length()); }
+	}
+
 	class Logger
 	{
 	public:
 		Logger(LogCallback& logger);
 
-		void LogDebug(const std::string& msg) const;
-		void LogMessage(const std::string& msg) const;
-		void LogWarning(const std::string& msg) const;
-		void LogError(const std::string& msg) const;
+		// Each argument is stored as it is, and they're joined up into text later.
+		// Numbers, characters, bools and strings can be passed.
+		template<typename... Args> void LogDebug(const Args&... args) const { Log<LogLevel_Debug>(args...); }
+		template<typename... Args> void LogMessage(const Args&... args) const { Log<LogLevel_Message>(args...); }
+		template<typename... Args> void LogWarning(const Args&... args) const { Log<LogLevel_Warning>(args...); }
+		template<typename... Args> void LogError(const Args&... args) const { Log<LogLevel_Error>(args...); }
+
+		//! \brief Turn this thread's buffered log lines into text.
+		static void FlushThreadLog();
 
 	protected:
 		void SetLoggingName(const std::string& name);
@@ -50,6 +196,27 @@ namespace Emperor
 		LogCallback& GetLogger() const;
 
 	private:
+		template<LogLevel level, typename... Args>
+		void Log(const Args&... args) const
+		{
+			// a constant, so the whole call disappears for disabled levels
+			if(level < EMPEROR_LOG_LEVEL)
+			{
+				return;
+			}
+
+			size_t argumentsSize = 0;
+			using expand = int[];
+			(void)expand{ 0, (argumentsSize += LogArgument::GetSize(args), 0)... };
+
+			LogBuffer& buffer = LogBuffer::GetThreadBuffer();
+			if(true == buffer.BeginRecord(level, m_LogCallback, m_LoggingName, sizeof...(args), argumentsSize))
+			{
+				(void)expand{ 0, (LogArgument::Write(buffer, args), 0)... };
+				buffer.EndRecord();
+			}
+		}
+
 		std::string m_LoggingName;
 		const LogCallback& m_LogCallback;
 	};
@@ -0,0 +1,378 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "ReparentingWindow.h"
+
+using namespace std;
+using namespace Emperor;
+
+//---------------------------------------------------------------------------------
+// Ctor & Dtor
+//---------------------------------------------------------------------------------
+
+ReparentingWindow::ReparentingWindow(
+    const string& name,
+    LogCallback& logger,
+    XBackend& backend,
+    xcb_window_t rootWindow,
+    xcb_window_t clientWindow)
+    : Logger(logger)
+    , m_Backend(backend)
+    , m_RootWindow(rootWindow)
+    , m_ClientWindow(clientWindow)
+{
+    SetLoggingName(name);
+}
+
+ReparentingWindow::ReparentingWindow(
+    const string& name,
+    LogCallback& logger,
+    XBackend& backend,
+    xcb_window_t rootWindow,
+    xcb_window_t clientWindow,
+    int x,
+    int y,
+    unsigned int width,
+    unsigned int height)
+    : Logger(logger)
+    , m_Backend(backend)
+    , m_RootWindow(rootWindow)
+    , m_ClientWindow(clientWindow)
+    , m_X(x)
+    , m_Y(y)
+    , m_Width(width)
+    , m_Height(height)
+    , m_GeometryKnown(true)
+{
+    SetLoggingName(name);
+}
+
+ReparentingWindow::~ReparentingWindow()
+{
+}
+
+//---------------------------------------------------------------------------------
+// Configure
+//---------------------------------------------------------------------------------
+
+void ReparentingWindow::Configure(uint16_t valueMask, const xcb_configure_window_value_list_t& values)
+{
+    // store position and size
+    if(valueMask & XCB_CONFIG_WINDOW_X)
+    {
+        m_X = values.x;
+    }
+    if(valueMask & XCB_CONFIG_WINDOW_Y)
+    {
+        m_Y = values.y;
+    }
+    if(valueMask & XCB_CONFIG_WINDOW_WIDTH)
+    {
+        m_Width = values.width;
+    }
+    if(valueMask & XCB_CONFIG_WINDOW_HEIGHT)
+    {
+        m_Height = values.height;
+    }
+
+    if(false == m_IsMapped)
+    {
+        // not framed yet, grant the request as-is
+        m_Backend.ConfigureWindow(m_ClientWindow, valueMask, values);
+        return;
+    }
+
+    // the frame takes the position and stacking, sized to fit around the client.
+    // The sibling (if any) is a sibling of the client, not the frame, so it's dropped.
+    xcb_configure_window_value_list_t frameValues = {};
+    frameValues.x = m_X;
+    frameValues.y = m_Y;
+    frameValues.width = m_Width + m_FrameLeft + m_FrameRight;
+    frameValues.height = m_Height + m_FrameTop + m_FrameBottom;
+    frameValues.stack_mode = values.stack_mode;
+    uint16_t frameMask = valueMask & (
+        XCB_CONFIG_WINDOW_X |
+        XCB_CONFIG_WINDOW_Y |
+        XCB_CONFIG_WINDOW_WIDTH |
+        XCB_CONFIG_WINDOW_HEIGHT |
+        XCB_CONFIG_WINDOW_STACK_MODE);
+    m_Backend.ConfigureWindow(m_FrameWindow, frameMask, frameValues);
+
+    // the client stays where it is within the frame, it only takes the size
+    uint16_t clientMask = valueMask & (
+        XCB_CONFIG_WINDOW_WIDTH |
+        XCB_CONFIG_WINDOW_HEIGHT |
+        XCB_CONFIG_WINDOW_BORDER_WIDTH);
+    m_Backend.ConfigureWindow(m_ClientWindow, clientMask, values);
+}
+
+//---------------------------------------------------------------------------------
+// Map & Unmap
+//---------------------------------------------------------------------------------
+
+void ReparentingWindow::Map(FrameRegistry& frames)
+{
+    if(true == m_IsMapped)
+    {
+        return;
+    }
+
+    // Configure and Unmap keep the geometry up to date once we have it
+    XBackend::WindowGeometry geometry;
+    if(true == m_GeometryKnown)
+    {
+        geometry.x = (int16_t)m_X;
+        geometry.y = (int16_t)m_Y;
+        geometry.width = (uint16_t)m_Width;
+        geometry.height = (uint16_t)m_Height;
+        geometry.borderWidth = 0;
+    }
+    else if(false == m_Backend.ReceiveGeometry(m_Backend.RequestGeometry(m_ClientWindow), geometry))
+    {
+        // the window has most likely been destroyed already
+        LogError("Failed to get the client geometry, not mapping.");
+        return;
+    }
+
+    Map(frames, geometry);
+}
+
+void ReparentingWindow::Map(FrameRegistry& frames, const XBackend::WindowGeometry& geometry)
+{
+    if(true == m_IsMapped)
+    {
+        return;
+    }
+
+    m_X = geometry.x;
+    m_Y = geometry.y;
+    m_Width = geometry.width;
+    m_Height = geometry.height;
+    m_GeometryKnown = true;
+
+    // Create frame, unless there's one going spare. A spare is already decorated, it
+    // just needs to be put in place and on top, like a new one would be.
+    m_FrameWindow = frames.ReuseFrame();
+    if(m_FrameWindow != XCB_WINDOW_NONE)
+    {
+        xcb_configure_window_value_list_t frameValues = {};
+        frameValues.x = m_X;
+        frameValues.y = m_Y;
+        frameValues.width = m_Width + m_FrameLeft + m_FrameRight;
+        frameValues.height = m_Height + m_FrameTop + m_FrameBottom;
+        frameValues.stack_mode = XCB_STACK_MODE_ABOVE;
+        m_Backend.ConfigureWindow(
+            m_FrameWindow,
+            XCB_CONFIG_WINDOW_X |
+                XCB_CONFIG_WINDOW_Y |
+                XCB_CONFIG_WINDOW_WIDTH |
+                XCB_CONFIG_WINDOW_HEIGHT |
+                XCB_CONFIG_WINDOW_STACK_MODE,
+            frameValues);
+        frames.AddFrame(m_FrameWindow, *this);
+    }
+    else
+    {
+        uint32_t frameMask = XCB_CW_EVENT_MASK;
+        uint32_t frameValues[1] =
+        {
+            GetFrameEventMask()
+        };
+        m_FrameWindow = m_Backend.CreateWindow(
+            m_RootWindow,                           // parent window
+            m_X, m_Y,                               // x, y
+            m_Width + m_FrameLeft + m_FrameRight,   // width
+            m_Height + m_FrameTop + m_FrameBottom,  // height
+            frameMask,                              // masks bitmap
+            frameValues);                           // masks value array
+        frames.AddFrame(m_FrameWindow, *this);
+
+        // let the derived class decorate the frame
+        OnFrameCreated();
+    }
+
+    // Add client to save set, so that it will be restored and kept alive if we crash
+    m_Backend.ChangeSaveSet(XCB_SET_MODE_INSERT, m_ClientWindow);
+
+    // reparent the client window to the frame
+    m_Backend.ReparentWindow(
+        m_ClientWindow,
+        m_FrameWindow,
+        m_FrameLeft,
+        m_FrameTop); // offset of client window within the frame
+
+    // map the frame, then the client
+    m_Backend.MapWindow(m_FrameWindow);
+    m_Backend.MapWindow(m_ClientWindow);
+
+    m_IsMapped = true;
+}
+
+void ReparentingWindow::Unmap(FrameRegistry& frames)
+{
+    if(false == m_IsMapped)
+    {
+        return;
+    }
+
+    // unmap the frame
+    m_Backend.UnmapWindow(m_FrameWindow);
+
+    // reparent client window back to root window, where the frame was, so it's still
+    // where we think it is if it's mapped again
+    m_Backend.ReparentWindow(
+        m_ClientWindow,
+        m_RootWindow,
+        m_X, m_Y); // offset of client window within root.
+
+    // remove client window from save set, as it is now unrelated to us.
+    m_Backend.ChangeSaveSet(XCB_SET_MODE_DELETE, m_ClientWindow);
+
+    // destroy the frame, unless it's wanted for another window
+    frames.RemoveFrame(m_FrameWindow);
+    if(false == frames.KeepFrame(m_FrameWindow))
+    {
+        m_Backend.DestroyWindow(m_FrameWindow);
+    }
+    m_FrameWindow = XCB_WINDOW_NONE;
+
+    m_IsMapped = false;
+}
+
+bool ReparentingWindow::IsMapped() const
+{
+    return m_IsMapped;
+}
+
+//---------------------------------------------------------------------------------
+// Location
+//---------------------------------------------------------------------------------
+
+void ReparentingWindow::SetLocation(int x, int y)
+{
+    m_X = x;
+    m_Y = y;
+
+    if(true == m_IsMapped)
+    {
+        xcb_configure_window_value_list_t values = {};
+        values.x = x;
+        values.y = y;
+        m_Backend.ConfigureWindow(m_FrameWindow, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values);
+    }
+}
+
+void ReparentingWindow::GetLocation(int& x, int& y) const
+{
+    x = m_X;
+    y = m_Y;
+}
+
+//---------------------------------------------------------------------------------
+// Size
+//---------------------------------------------------------------------------------
+
+void ReparentingWindow::SetSize(const unsigned int width, const unsigned int height)
+{
+    // TODO: have the client window's minimum & maximum sizes and test them before continuing
+
+    m_Width = width;
+    m_Height = height;
+
+    if(true == m_IsMapped)
+    {
+        // Resize frame.
+        xcb_configure_window_value_list_t values = {};
+        values.width = m_Width + m_FrameLeft + m_FrameRight;
+        values.height = m_Height + m_FrameTop + m_FrameBottom;
+        m_Backend.ConfigureWindow(m_FrameWindow, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+
+        // Resize client window.
+        values.width = m_Width;
+        values.height = m_Height;
+        m_Backend.ConfigureWindow(m_ClientWindow, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+    }
+}
+
+void ReparentingWindow::GetSize(unsigned int& width, unsigned int& height) const
+{
+    width = m_Width;
+    height = m_Height;
+}
+
+void ReparentingWindow::GetFrameExtents(unsigned int& left, unsigned int& top, unsigned int& right, unsigned int& bottom) const
+{
+    left = m_FrameLeft;
+    top = m_FrameTop;
+    right = m_FrameRight;
+    bottom = m_FrameBottom;
+}
+
+//---------------------------------------------------------------------------------
+// Others
+//---------------------------------------------------------------------------------
+
+void ReparentingWindow::RaiseAndSetFocus()
+{
+    Raise();
+    SetFocus();
+}
+
+void ReparentingWindow::Raise()
+{
+    if(true == m_IsMapped)
+    {
+        xcb_configure_window_value_list_t values = {};
+        values.stack_mode = XCB_STACK_MODE_ABOVE;
+        m_Backend.ConfigureWindow(m_FrameWindow, XCB_CONFIG_WINDOW_STACK_MODE, values);
+    }
+}
+
+void ReparentingWindow::SetFocus()
+{
+    if(true == m_IsMapped)
+    {
+        m_Backend.SetInputFocus(m_ClientWindow);
+    }
+}
+
+xcb_window_t ReparentingWindow::GetFrameWindow() const
+{
+    return m_FrameWindow;
+}
+
+xcb_window_t ReparentingWindow::GetClientWindow() const
+{
+    return m_ClientWindow;
+}
+
+//---------------------------------------------------------------------------------
+// Derived class support
+//---------------------------------------------------------------------------------
+
+void ReparentingWindow::SetFrameExtents(unsigned int left, unsigned int top, unsigned int right, unsigned int bottom)
+{
+    m_FrameLeft = left;
+    m_FrameTop = top;
+    m_FrameRight = right;
+    m_FrameBottom = bottom;
+}
+
+void ReparentingWindow::OnFrameCreated()
+{
+}
+
+uint32_t ReparentingWindow::GetFrameEventMask() const
+{
+    return XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY;
+}
+
+XBackend& ReparentingWindow::GetBackend() const
+{
+    return m_Backend;
+}
@@ -9,18 +9,177 @@
 #pragma once
 
 #include "Logger.h"
+#include "XBackend.h"
 #include <xcb/xcb.h>
+#include <string>
 
 // represents the base class for any reparenting windows
 // this window class has no decorations and doesn't respond to dragging, etc directly.
 
 namespace Emperor
 {
+    class ReparentingWindow;
+
+    //! \brief  Wherever the window manager keeps track of its windows. Frames are added
+    //!         as they're created and removed as they're destroyed, so that events on
+    //!         them can be told apart from events on clients.
+    //!         A registry may also hold on to frames that are no longer needed and hand
+    //!         them out again, decorations and all, so they aren't made from scratch.
+    //!         It must only hand them to windows of the same kind they came from.
+    class FrameRegistry
+    {
+    public:
+        virtual ~FrameRegistry() {}
+
+        //! \brief A frame has been created, or reused, for a window.
+        virtual void AddFrame(xcb_window_t frame, ReparentingWindow& window) = 0;
+
+        //! \brief A frame is no longer a window's.
+        virtual void RemoveFrame(xcb_window_t frame) = 0;
+
+        //! \brief Get an unmapped frame that was kept earlier, XCB_WINDOW_NONE to make a new one.
+        virtual xcb_window_t ReuseFrame() { return XCB_WINDOW_NONE; }
+
+        //! \brief  Offer an empty, unmapped frame to keep for later.
+        //! \return true if it was kept, false to destroy it.
+        virtual bool KeepFrame(xcb_window_t frame) { return false; }
+    };
+
     class ReparentingWindow : public Logger
     {
     public:
-        ReparentingWindow(xcb_window_t* pWindow);
+        //! \brief ctor - Create a ReparentingWindow object. Represents a top-level window.
+        //! \param name The name to log with.
+        //! \param logger The log callbacks to use.
+        //! \param backend The X server to use.
+        //! \param rootWindow The root window of the screen the client lives on.
+        //! \param clientWindow The actual X window to handle.
+        ReparentingWindow(
+            const std::string& name,
+            LogCallback& logger,
+            XBackend& backend,
+            xcb_window_t rootWindow,
+            xcb_window_t clientWindow);
+
+        //! \brief ctor - Create a ReparentingWindow object with a known geometry.
+        //! \param name The name to log with.
+        //! \param logger The log callbacks to use.
+        //! \param backend The X server to use.
+        //! \param rootWindow The root window of the screen the client lives on.
+        //! \param clientWindow The actual X window to handle.
+        //! \param x Initial x-position.
+        //! \param y Initial y-position.
+        //! \param width Initial width.
+        //! \param height Initial height.
+        ReparentingWindow(
+            const std::string& name,
+            LogCallback& logger,
+            XBackend& backend,
+            xcb_window_t rootWindow,
+            xcb_window_t clientWindow,
+            int x,
+            int y,
+            unsigned int width,
+            unsigned int height);
+
+        virtual ~ReparentingWindow();
+
+        //! \brief Configure the window.
+        //! \param valueMask Which of the values are set, as passed to xcb_configure_window.
+        //! \param values The requested configuration.
+        void Configure(uint16_t valueMask, const xcb_configure_window_value_list_t& values);
+
+        //! \brief  Show the window. This reparents the client into a newly created frame.
+        //!         The frame goes where the client was last known to be, the server is only
+        //!         asked if this object has never been told.
+        //! \param frames Where the new frame is recorded.
+        void Map(FrameRegistry& frames);
+
+        //! \brief  Show the window, framing it where the caller says the client is.
+        //! \param frames Where the new frame is recorded.
+        //! \param geometry The client's current geometry.
+        void Map(FrameRegistry& frames, const XBackend::WindowGeometry& geometry);
+
+        //! \brief Hide the window. This will destroy the frame.
+        //! \param frames Where the frame is removed from.
+        void Unmap(FrameRegistry& frames);
+
+        //! \brief Return true if the window is mapped (on-screen), false if not.
+        bool IsMapped() const;
+
+        //! \brief Move the window to a new location.
+        //! \param destinationX The new X-coordinate for the window frame.
+        //! \param destinationY The new Y-coordinate for the window frame.
+        void SetLocation(const int destinationX, const int destinationY);
+
+        //! \brief Get the window location.
+        //! \param x Output variable for the x-coordinate.
+        //! \param y Output variable for the y-coordinate.
+        void GetLocation(int& x, int &y) const;
+
+        //! \brief  Resize the window. Note that this is the size of the client area,
+        //!         the frame is resized to fit around it.
+        //! \param width The new width.
+        //! \param height The new height.
+        void SetSize(const unsigned int width, const unsigned int height);
+
+        //! \brief Get the window size.
+        //! \param width The output variable for the window width.
+        //! \param height The output variable for the window height.
+        void GetSize(unsigned int& width, unsigned int& height) const;
+
+        //! \brief Get how far the client sits inside the frame on each side.
+        void GetFrameExtents(unsigned int& left, unsigned int& top, unsigned int& right, unsigned int& bottom) const;
+
+        //! \brief If this window is mapped, bring it to the top and give it focus
+        void RaiseAndSetFocus();
+
+        //! \brief If the window is mapped, bring it to the top
+        void Raise();
+
+        //! \brief If the window is mapped, give it the focus
+        void SetFocus();
+
+        //! \brief Get the frame window for this window. Only valid if the window is mapped.
+        xcb_window_t GetFrameWindow() const;
+
+        //! \brief Get the client window this object manages.
+        xcb_window_t GetClientWindow() const;
+
+    protected:
+        //! \brief  Set how far the client sits inside the frame on each side. Must be
+        //!         called before the window is mapped.
+        void SetFrameExtents(unsigned int left, unsigned int top, unsigned int right, unsigned int bottom);
+
+        //! \brief  Called once the frame has been created, but before anything is mapped.
+        //!         Derived classes add decorations and input grabs here.
+        virtual void OnFrameCreated();
+
+        //! \brief  The events to select on the frame when it's created. Derived classes add
+        //!         to the substructure events the frame needs to do its job.
+        virtual uint32_t GetFrameEventMask() const;
+
+        XBackend& GetBackend() const;
 
     private:
+        // core data
+        XBackend& m_Backend;
+        xcb_window_t m_RootWindow;
+        xcb_window_t m_ClientWindow;
+
+        // helpful data
+        bool m_IsMapped = false;
+        int m_X = 0;
+        int m_Y = 0;
+        unsigned int m_Width = 0;
+        unsigned int m_Height = 0;
+        bool m_GeometryKnown = false;   // given to the ctor, or learnt by an earlier Map
+
+        // frame data
+        xcb_window_t m_FrameWindow = XCB_WINDOW_NONE;
+        unsigned int m_FrameLeft = 0;
+        unsigned int m_FrameTop = 0;
+        unsigned int m_FrameRight = 0;
+        unsigned int m_FrameBottom = 0;
     };
-}
\ No newline at end of file
+}
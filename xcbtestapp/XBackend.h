@@ -0,0 +1,231 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#pragma once
+
+#include <xcb/xcb.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// every X operation the window manager issues goes through this interface, so it can
+// run against a real X server (XcbBackend) or an in-memory model of one.
+// The XCB wire structures (events, cookies, value lists) are the shared vocabulary.
+
+namespace Emperor
+{
+    class XBackend
+    {
+    public:
+        struct WindowGeometry
+        {
+            int16_t x;
+            int16_t y;
+            uint16_t width;
+            uint16_t height;
+            uint16_t borderWidth;
+        };
+
+        struct WindowAttributes
+        {
+            bool overrideRedirect;
+            uint8_t mapState;
+        };
+
+        //! Optional extensions may not be compiled in, so their requests are tracked by
+        //! sequence number alone. 0 if the request couldn't be sent.
+        struct ExtensionCookie
+        {
+            unsigned int sequence;
+        };
+
+        virtual ~XBackend() {}
+
+        // connection
+        virtual xcb_window_t GetRootWindow() const = 0;
+        virtual int GetFileDescriptor() const = 0;
+        virtual bool HasError() const = 0;
+        virtual xcb_generic_event_t* PollForEvent() = 0;
+        //! \return The name of an extension event type we've asked for, nullptr for
+        //!         core events and those of extensions we don't use.
+        virtual const char* GetExtensionEventName(uint8_t eventType) const = 0;
+        virtual void Flush() = 0;
+        virtual void Sync() = 0;
+
+        // requests without replies
+        virtual xcb_window_t CreateWindow(
+            xcb_window_t parent,
+            int16_t x,
+            int16_t y,
+            uint16_t width,
+            uint16_t height,
+            uint32_t valueMask,
+            const uint32_t* pValues) = 0;
+        virtual void DestroyWindow(xcb_window_t window) = 0;
+        virtual void ChangeWindowAttributes(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues) = 0;
+        virtual void ConfigureWindow(xcb_window_t window, uint16_t valueMask, const xcb_configure_window_value_list_t& values) = 0;
+        virtual void MapWindow(xcb_window_t window) = 0;
+        virtual void UnmapWindow(xcb_window_t window) = 0;
+        virtual void ReparentWindow(xcb_window_t window, xcb_window_t parent, int16_t x, int16_t y) = 0;
+        virtual void ChangeSaveSet(uint8_t mode, xcb_window_t window) = 0;
+        virtual void SetInputFocus(xcb_window_t window) = 0;
+        virtual void GrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key) = 0;
+        virtual void UngrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key) = 0;
+        //! A pointerMode of XCB_GRAB_MODE_SYNC freezes the pointer on each press until
+        //! AllowEvents says what to do with it.
+        virtual void GrabButton(xcb_window_t window, uint16_t eventMask, uint8_t button, uint16_t modifiers, uint8_t pointerMode) = 0;
+        virtual void AllowEvents(uint8_t mode, xcb_timestamp_t time) = 0;
+        virtual void UngrabKeyboard() = 0;
+        virtual void GrabServer() = 0;
+        virtual void UngrabServer() = 0;
+        virtual void SendEvent(xcb_window_t window, uint32_t eventMask, const void* pEvent) = 0;
+        virtual void KillClient(xcb_window_t window) = 0;
+
+        // requests with replies. Request* sends the request and returns straight away,
+        // Receive* waits for the reply, so several requests can share one round trip.
+        // Receive* returns false if the request failed (the window has gone, etc).
+        virtual xcb_void_cookie_t RequestChangeWindowAttributesChecked(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues) = 0;
+        virtual uint8_t ReceiveErrorCode(xcb_void_cookie_t cookie) = 0;
+
+        virtual xcb_intern_atom_cookie_t RequestAtom(const std::string& name) = 0;
+        virtual xcb_atom_t ReceiveAtom(xcb_intern_atom_cookie_t cookie) = 0;
+
+        virtual xcb_get_geometry_cookie_t RequestGeometry(xcb_window_t window) = 0;
+        virtual bool ReceiveGeometry(xcb_get_geometry_cookie_t cookie, WindowGeometry& geometry) = 0;
+
+        virtual xcb_get_window_attributes_cookie_t RequestAttributes(xcb_window_t window) = 0;
+        virtual bool ReceiveAttributes(xcb_get_window_attributes_cookie_t cookie, WindowAttributes& attributes) = 0;
+
+        virtual xcb_query_tree_cookie_t RequestChildren(xcb_window_t window) = 0;
+        virtual bool ReceiveChildren(xcb_query_tree_cookie_t cookie, std::vector<xcb_window_t>& children) = 0;
+
+        //! ReceiveProperty takes 32-bit format properties (atoms, cardinals, windows, etc),
+        //! ReceiveStringProperty 8-bit ones (WM_CLASS, WM_NAME, etc).
+        virtual xcb_get_property_cookie_t RequestProperty(xcb_window_t window, xcb_atom_t property, xcb_atom_t type) = 0;
+        virtual bool ReceiveProperty(xcb_get_property_cookie_t cookie, std::vector<uint32_t>& values) = 0;
+        virtual bool ReceiveStringProperty(xcb_get_property_cookie_t cookie, std::string& value) = 0;
+
+        virtual xcb_get_keyboard_mapping_cookie_t RequestKeyboardMapping() = 0;
+        virtual bool ReceiveKeyboardMapping(
+            xcb_get_keyboard_mapping_cookie_t cookie,
+            xcb_keycode_t& minKeycode,
+            uint8_t& keysymsPerKeycode,
+            std::vector<xcb_keysym_t>& keysyms) = 0;
+
+        //! Send every key event to the window until UngrabKeyboard.
+        //! ReceiveKeyboardGrab returns the grab status, XCB_GRAB_STATUS_SUCCESS if the
+        //! keyboard is ours (AlreadyGrabbed, Frozen, etc if not).
+        virtual xcb_grab_keyboard_cookie_t RequestKeyboardGrab(xcb_window_t window) = 0;
+        virtual uint8_t ReceiveKeyboardGrab(xcb_grab_keyboard_cookie_t cookie) = 0;
+
+        //! The modifiers and buttons held down right now, as in an event's state.
+        virtual xcb_query_pointer_cookie_t RequestPointerState(xcb_window_t window) = 0;
+        virtual bool ReceivePointerState(xcb_query_pointer_cookie_t cookie, uint16_t& state) = 0;
+
+        //! The root window's refresh rate, through RandR.
+        virtual ExtensionCookie RequestRefreshRate() = 0;
+        //! \return The refresh rate in Hz, 0 if it isn't known (no RandR, etc).
+        virtual unsigned int ReceiveRefreshRate(ExtensionCookie cookie) = 0;
+
+        //! Where each monitor is on the root window, through RandR.
+        virtual ExtensionCookie RequestMonitors() = 0;
+        //! \return false if the monitors aren't known (no RandR, etc).
+        virtual bool ReceiveMonitors(ExtensionCookie cookie, std::vector<xcb_rectangle_t>& monitors) = 0;
+
+        // XSync alarms, to hear when a client's counter reaches a value
+        //! \return The new alarm, 0 if the server doesn't do SYNC.
+        virtual uint32_t CreateCounterAlarm(uint32_t counter, int64_t value) = 0;
+        //! Fire the alarm again once its counter reaches this value.
+        virtual void ChangeCounterAlarm(uint32_t alarm, int64_t value) = 0;
+        virtual void DestroyCounterAlarm(uint32_t alarm) = 0;
+        //! \return true if the event is an alarm firing, with the alarm in alarm.
+        virtual bool IsCounterAlarmEvent(const xcb_generic_event_t* pEvent, uint32_t& alarm) const = 0;
+
+        // Composite, Render and Damage, for live thumbnails of windows. Without them
+        // (or without them compiled in) pictures and damage are 0.
+        //! Agree the versions of the extensions, and find the picture format for our
+        //! windows. Nothing is redirected yet.
+        //! \return false if the server can't do all of it.
+        virtual bool InitialiseThumbnails() = 0;
+        //! Keep one of the root's children's contents off screen, so it can be drawn
+        //! from even when covered, until it's unredirected. The server goes on showing it
+        //! itself, and copies what's on screen into the new pixmap, so there's something
+        //! to draw from straight away. Each one costs a pixmap and a copy on every draw.
+        virtual void RedirectWindow(xcb_window_t window) = 0;
+        virtual void UnredirectWindow(xcb_window_t window) = 0;
+        //! A picture of a redirected window's contents, named through Composite.
+        //! Named again after the window is resized, the old contents stay as they were.
+        virtual uint32_t CreateContentsPicture(xcb_window_t window) = 0;
+        //! A picture to draw on one of our own windows.
+        virtual uint32_t CreateWindowPicture(xcb_window_t window) = 0;
+        //! A picture on a new pixmap, to draw in off screen, the size given and as deep
+        //! as the window.
+        virtual uint32_t CreateBufferPicture(xcb_window_t window, uint16_t width, uint16_t height) = 0;
+        virtual void FreePicture(uint32_t picture) = 0;
+        //! Have the server scale a picture by numerator / denominator, smoothly,
+        //! whenever it's drawn from.
+        virtual void SetPictureScale(uint32_t picture, uint32_t numerator, uint32_t denominator) = 0;
+        //! Copy part of a (scaled) picture onto another.
+        virtual void CompositePicture(
+            uint32_t source,
+            uint32_t destination,
+            int16_t sourceX,
+            int16_t sourceY,
+            int16_t x,
+            int16_t y,
+            uint16_t width,
+            uint16_t height) = 0;
+        //! \param colour 0xrrggbb
+        virtual void FillRectangle(uint32_t picture, uint32_t colour, const xcb_rectangle_t& rectangle) = 0;
+        //! Hear when a window's contents change. One event, until the damage is subtracted.
+        virtual uint32_t CreateDamage(xcb_window_t window) = 0;
+        //! Hear where a window's contents change. An event each time the damaged area
+        //! grows, with the box round all of it, until the damage is subtracted.
+        virtual uint32_t CreateAreaDamage(xcb_window_t window) = 0;
+        virtual void SubtractDamage(uint32_t damage) = 0;
+        virtual void DestroyDamage(uint32_t damage) = 0;
+        //! \return true if the event is a damage report, with the damage in damage and
+        //!         the damaged area, relative to the window, in area.
+        virtual bool IsDamageEvent(const xcb_generic_event_t* pEvent, uint32_t& damage, xcb_rectangle_t& area) const = 0;
+        //! Draw the root's children ourselves: redirect them manually, so the server
+        //! stops showing them, and get the overlay window to show them on. Input goes
+        //! through the overlay to the windows underneath. InitialiseThumbnails comes first.
+        //! \return The overlay window, XCB_WINDOW_NONE if the server can't (no XFixes,
+        //!         another compositing manager, etc).
+        virtual xcb_window_t StartCompositing() = 0;
+
+        //! \brief  How many times we've had to wait on the server. Waiting for one reply
+        //!         also collects the replies to everything sent up to then - those
+        //!         don't count again.
+        uint64_t GetRoundTripCount() const { return m_RoundTripCount; }
+
+    protected:
+        //! \brief Implementations call this for every request they send.
+        void CountRequest(unsigned int sequence)
+        {
+            m_LastRequestSequence = sequence;
+        }
+
+        //! \brief Implementations call this before waiting for the reply to a request.
+        void CountRoundTrip(unsigned int sequence)
+        {
+            // waiting flushes everything sent so far, and those replies all come back
+            // together. Sequence numbers wrap, so compare the difference.
+            if((int)(sequence - m_AnsweredSequence) > 0)
+            {
+                m_AnsweredSequence = m_LastRequestSequence;
+                m_RoundTripCount++;
+            }
+        }
+
+    private:
+        unsigned int m_LastRequestSequence = 0;
+        unsigned int m_AnsweredSequence = 0;
+        uint64_t m_RoundTripCount = 0;
+    };
+}
@@ -0,0 +1,914 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#include "XcbBackend.h"
+#include <cstdlib>
+#include <cstdint>
+
+#ifdef HAVE_XCB_RANDR
+#include <xcb/randr.h>
+#endif
+#ifdef HAVE_XCB_SYNC
+#include <xcb/sync.h>
+#endif
+#if defined(HAVE_XCB_COMPOSITE) && defined(HAVE_XCB_RENDER) && defined(HAVE_XCB_DAMAGE)
+#define HAVE_XCB_THUMBNAILS
+#include <xcb/composite.h>
+#include <xcb/render.h>
+#include <xcb/damage.h>
+#endif
+#if defined(HAVE_XCB_THUMBNAILS) && defined(HAVE_XCB_XFIXES)
+#define HAVE_XCB_COMPOSITING
+#include <xcb/xfixes.h>
+#endif
+
+using namespace std;
+using namespace Emperor;
+
+//---------------------------------------------------------------------------------
+// Ctor & Dtor
+//---------------------------------------------------------------------------------
+
+XcbBackend::XcbBackend()
+{
+}
+
+XcbBackend::~XcbBackend()
+{
+    if(m_pConnection != nullptr)
+    {
+        xcb_disconnect(m_pConnection);
+    }
+}
+
+bool XcbBackend::Connect(const char* displayName)
+{
+    int screenNum;
+    m_pConnection = xcb_connect(displayName, &screenNum);
+    if(xcb_connection_has_error(m_pConnection) != 0)
+    {
+        return false;
+    }
+
+    // find the screen we were given
+    xcb_screen_iterator_t screenIter = xcb_setup_roots_iterator(xcb_get_setup(m_pConnection));
+    for(int i = 0; i < screenNum; i++)
+    {
+        xcb_screen_next(&screenIter);
+    }
+    m_pScreen = screenIter.data;
+
+    // ask about the extensions now, so the answers are waiting when they're needed
+#ifdef HAVE_XCB_RANDR
+    xcb_prefetch_extension_data(m_pConnection, &xcb_randr_id);
+#endif
+#ifdef HAVE_XCB_SYNC
+    xcb_prefetch_extension_data(m_pConnection, &xcb_sync_id);
+#endif
+#ifdef HAVE_XCB_THUMBNAILS
+    xcb_prefetch_extension_data(m_pConnection, &xcb_composite_id);
+    xcb_prefetch_extension_data(m_pConnection, &xcb_render_id);
+    xcb_prefetch_extension_data(m_pConnection, &xcb_damage_id);
+#endif
+#ifdef HAVE_XCB_COMPOSITING
+    xcb_prefetch_extension_data(m_pConnection, &xcb_xfixes_id);
+#endif
+
+    return true;
+}
+
+xcb_connection_t* XcbBackend::GetConnection() const
+{
+    return m_pConnection;
+}
+
+//---------------------------------------------------------------------------------
+// Connection
+//---------------------------------------------------------------------------------
+
+xcb_window_t XcbBackend::GetRootWindow() const
+{
+    return m_pScreen->root;
+}
+
+int XcbBackend::GetFileDescriptor() const
+{
+    return xcb_get_file_descriptor(m_pConnection);
+}
+
+bool XcbBackend::HasError() const
+{
+    return xcb_connection_has_error(m_pConnection) != 0;
+}
+
+xcb_generic_event_t* XcbBackend::PollForEvent()
+{
+    return xcb_poll_for_event(m_pConnection);
+}
+
+const char* XcbBackend::GetExtensionEventName(uint8_t eventType) const
+{
+#ifdef HAVE_XCB_SYNC
+    if(m_SyncFirstEvent != 0 && eventType == m_SyncFirstEvent + XCB_SYNC_ALARM_NOTIFY)
+    {
+        return "SyncAlarmNotify";
+    }
+#endif
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_DamageFirstEvent != 0 && eventType == m_DamageFirstEvent + XCB_DAMAGE_NOTIFY)
+    {
+        return "DamageNotify";
+    }
+#endif
+    return nullptr;
+}
+
+void XcbBackend::Flush()
+{
+    xcb_flush(m_pConnection);
+}
+
+void XcbBackend::Sync()
+{
+    xcb_get_input_focus_cookie_t cookie = Sent(xcb_get_input_focus(m_pConnection));
+    CountRoundTrip(cookie.sequence);
+    free(xcb_get_input_focus_reply(m_pConnection, cookie, nullptr));
+}
+
+//---------------------------------------------------------------------------------
+// Requests without replies
+//---------------------------------------------------------------------------------
+
+xcb_window_t XcbBackend::CreateWindow(
+    xcb_window_t parent,
+    int16_t x,
+    int16_t y,
+    uint16_t width,
+    uint16_t height,
+    uint32_t valueMask,
+    const uint32_t* pValues)
+{
+    xcb_window_t window = xcb_generate_id(m_pConnection);
+    Sent(xcb_create_window(
+        m_pConnection,                  // xcb connection
+        XCB_COPY_FROM_PARENT,           // depth
+        window,                         // window id
+        parent,                         // parent window
+        x, y,                           // x, y
+        width, height,                  // width, height
+        0,                              // border width
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,  // class
+        XCB_COPY_FROM_PARENT,           // visual
+        valueMask,                      // masks bitmap
+        pValues));                      // masks value array
+    return window;
+}
+
+void XcbBackend::DestroyWindow(xcb_window_t window)
+{
+    Sent(xcb_destroy_window(m_pConnection, window));
+}
+
+void XcbBackend::ChangeWindowAttributes(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues)
+{
+    Sent(xcb_change_window_attributes(m_pConnection, window, valueMask, pValues));
+}
+
+void XcbBackend::ConfigureWindow(xcb_window_t window, uint16_t valueMask, const xcb_configure_window_value_list_t& values)
+{
+    Sent(xcb_configure_window_aux(m_pConnection, window, valueMask, &values));
+}
+
+void XcbBackend::MapWindow(xcb_window_t window)
+{
+    Sent(xcb_map_window(m_pConnection, window));
+}
+
+void XcbBackend::UnmapWindow(xcb_window_t window)
+{
+    Sent(xcb_unmap_window(m_pConnection, window));
+}
+
+void XcbBackend::ReparentWindow(xcb_window_t window, xcb_window_t parent, int16_t x, int16_t y)
+{
+    Sent(xcb_reparent_window(m_pConnection, window, parent, x, y));
+}
+
+void XcbBackend::ChangeSaveSet(uint8_t mode, xcb_window_t window)
+{
+    Sent(xcb_change_save_set(m_pConnection, mode, window));
+}
+
+void XcbBackend::SetInputFocus(xcb_window_t window)
+{
+    Sent(xcb_set_input_focus(m_pConnection, XCB_INPUT_FOCUS_POINTER_ROOT, window, XCB_CURRENT_TIME));
+}
+
+void XcbBackend::GrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key)
+{
+    Sent(xcb_grab_key(
+        m_pConnection,
+        false,
+        window,
+        modifiers,
+        key,
+        XCB_GRAB_MODE_ASYNC,
+        XCB_GRAB_MODE_ASYNC));
+}
+
+void XcbBackend::UngrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key)
+{
+    Sent(xcb_ungrab_key(m_pConnection, key, window, modifiers));
+}
+
+void XcbBackend::GrabButton(xcb_window_t window, uint16_t eventMask, uint8_t button, uint16_t modifiers, uint8_t pointerMode)
+{
+    Sent(xcb_grab_button(
+        m_pConnection,
+        false,
+        window,
+        eventMask,
+        pointerMode,
+        XCB_GRAB_MODE_ASYNC,
+        XCB_NONE,
+        XCB_NONE,
+        button,
+        modifiers));
+}
+
+void XcbBackend::AllowEvents(uint8_t mode, xcb_timestamp_t time)
+{
+    Sent(xcb_allow_events(m_pConnection, mode, time));
+}
+
+void XcbBackend::UngrabKeyboard()
+{
+    Sent(xcb_ungrab_keyboard(m_pConnection, XCB_CURRENT_TIME));
+}
+
+void XcbBackend::GrabServer()
+{
+    Sent(xcb_grab_server(m_pConnection));
+}
+
+void XcbBackend::UngrabServer()
+{
+    Sent(xcb_ungrab_server(m_pConnection));
+}
+
+void XcbBackend::SendEvent(xcb_window_t window, uint32_t eventMask, const void* pEvent)
+{
+    Sent(xcb_send_event(m_pConnection, false, window, eventMask, (const char*)pEvent));
+}
+
+void XcbBackend::KillClient(xcb_window_t window)
+{
+    Sent(xcb_kill_client(m_pConnection, window));
+}
+
+//---------------------------------------------------------------------------------
+// Requests with replies
+//---------------------------------------------------------------------------------
+
+xcb_void_cookie_t XcbBackend::RequestChangeWindowAttributesChecked(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues)
+{
+    return Sent(xcb_change_window_attributes_checked(m_pConnection, window, valueMask, pValues));
+}
+
+uint8_t XcbBackend::ReceiveErrorCode(xcb_void_cookie_t cookie)
+{
+    uint8_t errorCode = 0;
+    CountRoundTrip(cookie.sequence);
+    xcb_generic_error_t* pError = xcb_request_check(m_pConnection, cookie);
+    if(pError != nullptr)
+    {
+        errorCode = pError->error_code;
+        free(pError);
+    }
+    return errorCode;
+}
+
+xcb_intern_atom_cookie_t XcbBackend::RequestAtom(const string& name)
+{
+    return Sent(xcb_intern_atom(m_pConnection, 0, name.length(), name.c_str()));
+}
+
+xcb_atom_t XcbBackend::ReceiveAtom(xcb_intern_atom_cookie_t cookie)
+{
+    xcb_atom_t atom = XCB_ATOM_NONE;
+    CountRoundTrip(cookie.sequence);
+    xcb_intern_atom_reply_t* pReply = xcb_intern_atom_reply(m_pConnection, cookie, nullptr);
+    if(pReply != nullptr)
+    {
+        atom = pReply->atom;
+        free(pReply);
+    }
+    return atom;
+}
+
+xcb_get_geometry_cookie_t XcbBackend::RequestGeometry(xcb_window_t window)
+{
+    return Sent(xcb_get_geometry(m_pConnection, window));
+}
+
+bool XcbBackend::ReceiveGeometry(xcb_get_geometry_cookie_t cookie, WindowGeometry& geometry)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_get_geometry_reply_t* pReply = xcb_get_geometry_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return false;
+    }
+
+    geometry.x = pReply->x;
+    geometry.y = pReply->y;
+    geometry.width = pReply->width;
+    geometry.height = pReply->height;
+    geometry.borderWidth = pReply->border_width;
+    free(pReply);
+    return true;
+}
+
+xcb_get_window_attributes_cookie_t XcbBackend::RequestAttributes(xcb_window_t window)
+{
+    return Sent(xcb_get_window_attributes(m_pConnection, window));
+}
+
+bool XcbBackend::ReceiveAttributes(xcb_get_window_attributes_cookie_t cookie, WindowAttributes& attributes)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_get_window_attributes_reply_t* pReply = xcb_get_window_attributes_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return false;
+    }
+
+    attributes.overrideRedirect = (pReply->override_redirect != 0);
+    attributes.mapState = pReply->map_state;
+    free(pReply);
+    return true;
+}
+
+xcb_query_tree_cookie_t XcbBackend::RequestChildren(xcb_window_t window)
+{
+    return Sent(xcb_query_tree(m_pConnection, window));
+}
+
+bool XcbBackend::ReceiveChildren(xcb_query_tree_cookie_t cookie, vector<xcb_window_t>& children)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_query_tree_reply_t* pReply = xcb_query_tree_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return false;
+    }
+
+    xcb_window_t* pChildren = xcb_query_tree_children(pReply);
+    children.assign(pChildren, pChildren + xcb_query_tree_children_length(pReply));
+    free(pReply);
+    return true;
+}
+
+xcb_get_property_cookie_t XcbBackend::RequestProperty(xcb_window_t window, xcb_atom_t property, xcb_atom_t type)
+{
+    return Sent(xcb_get_property(m_pConnection, false, window, property, type, 0, UINT32_MAX));
+}
+
+bool XcbBackend::ReceiveProperty(xcb_get_property_cookie_t cookie, vector<uint32_t>& values)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_get_property_reply_t* pReply = xcb_get_property_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return false;
+    }
+
+    // a missing property, or one of a different type, comes back with no value
+    if(pReply->format != 32)
+    {
+        values.clear();
+    }
+    else
+    {
+        uint32_t* pValues = (uint32_t*)xcb_get_property_value(pReply);
+        values.assign(pValues, pValues + (xcb_get_property_value_length(pReply) / sizeof(uint32_t)));
+    }
+    free(pReply);
+    return true;
+}
+
+bool XcbBackend::ReceiveStringProperty(xcb_get_property_cookie_t cookie, string& value)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_get_property_reply_t* pReply = xcb_get_property_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return false;
+    }
+
+    if(pReply->format != 8)
+    {
+        value.clear();
+    }
+    else
+    {
+        value.assign((const char*)xcb_get_property_value(pReply), xcb_get_property_value_length(pReply));
+    }
+    free(pReply);
+    return true;
+}
+
+xcb_get_keyboard_mapping_cookie_t XcbBackend::RequestKeyboardMapping()
+{
+    const xcb_setup_t* pSetup = xcb_get_setup(m_pConnection);
+    return Sent(xcb_get_keyboard_mapping(
+        m_pConnection,
+        pSetup->min_keycode,
+        pSetup->max_keycode - pSetup->min_keycode + 1));
+}
+
+bool XcbBackend::ReceiveKeyboardMapping(
+    xcb_get_keyboard_mapping_cookie_t cookie,
+    xcb_keycode_t& minKeycode,
+    uint8_t& keysymsPerKeycode,
+    vector<xcb_keysym_t>& keysyms)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_get_keyboard_mapping_reply_t* pReply = xcb_get_keyboard_mapping_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return false;
+    }
+
+    xcb_keysym_t* pKeysyms = xcb_get_keyboard_mapping_keysyms(pReply);
+    keysyms.assign(pKeysyms, pKeysyms + xcb_get_keyboard_mapping_keysyms_length(pReply));
+    keysymsPerKeycode = pReply->keysyms_per_keycode;
+    minKeycode = xcb_get_setup(m_pConnection)->min_keycode;
+    free(pReply);
+    return true;
+}
+
+xcb_grab_keyboard_cookie_t XcbBackend::RequestKeyboardGrab(xcb_window_t window)
+{
+    return Sent(xcb_grab_keyboard(
+        m_pConnection,
+        false,
+        window,
+        XCB_CURRENT_TIME,
+        XCB_GRAB_MODE_ASYNC,
+        XCB_GRAB_MODE_ASYNC));
+}
+
+uint8_t XcbBackend::ReceiveKeyboardGrab(xcb_grab_keyboard_cookie_t cookie)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_grab_keyboard_reply_t* pReply = xcb_grab_keyboard_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return XCB_GRAB_STATUS_NOT_VIEWABLE;
+    }
+
+    uint8_t status = pReply->status;
+    free(pReply);
+    return status;
+}
+
+xcb_query_pointer_cookie_t XcbBackend::RequestPointerState(xcb_window_t window)
+{
+    return Sent(xcb_query_pointer(m_pConnection, window));
+}
+
+bool XcbBackend::ReceivePointerState(xcb_query_pointer_cookie_t cookie, uint16_t& state)
+{
+    CountRoundTrip(cookie.sequence);
+    xcb_query_pointer_reply_t* pReply = xcb_query_pointer_reply(m_pConnection, cookie, nullptr);
+    if(pReply == nullptr)
+    {
+        return false;
+    }
+
+    state = pReply->mask;
+    free(pReply);
+    return true;
+}
+
+XBackend::ExtensionCookie XcbBackend::RequestRefreshRate()
+{
+#ifdef HAVE_XCB_RANDR
+    const xcb_query_extension_reply_t* pRandr = xcb_get_extension_data(m_pConnection, &xcb_randr_id);
+    if(pRandr != nullptr && pRandr->present != 0)
+    {
+        return { Sent(xcb_randr_get_screen_info(m_pConnection, m_pScreen->root)).sequence };
+    }
+#endif
+    return { 0 };
+}
+
+unsigned int XcbBackend::ReceiveRefreshRate(ExtensionCookie cookie)
+{
+    unsigned int rate = 0;
+#ifdef HAVE_XCB_RANDR
+    if(cookie.sequence != 0)
+    {
+        CountRoundTrip(cookie.sequence);
+        xcb_randr_get_screen_info_cookie_t randrCookie = { cookie.sequence };
+        xcb_randr_get_screen_info_reply_t* pReply = xcb_randr_get_screen_info_reply(m_pConnection, randrCookie, nullptr);
+        if(pReply != nullptr)
+        {
+            rate = pReply->rate;
+            free(pReply);
+        }
+    }
+#endif
+    return rate;
+}
+
+XBackend::ExtensionCookie XcbBackend::RequestMonitors()
+{
+#ifdef HAVE_XCB_RANDR
+    const xcb_query_extension_reply_t* pRandr = xcb_get_extension_data(m_pConnection, &xcb_randr_id);
+    if(pRandr != nullptr && pRandr->present != 0)
+    {
+        // RandR 1.5, a server without it answers with an error and we use the screen
+        return { Sent(xcb_randr_get_monitors(m_pConnection, m_pScreen->root, 1)).sequence };
+    }
+#endif
+    return { 0 };
+}
+
+bool XcbBackend::ReceiveMonitors(ExtensionCookie cookie, vector<xcb_rectangle_t>& monitors)
+{
+    monitors.clear();
+#ifdef HAVE_XCB_RANDR
+    if(cookie.sequence != 0)
+    {
+        CountRoundTrip(cookie.sequence);
+        xcb_randr_get_monitors_cookie_t randrCookie = { cookie.sequence };
+        xcb_randr_get_monitors_reply_t* pReply = xcb_randr_get_monitors_reply(m_pConnection, randrCookie, nullptr);
+        if(pReply != nullptr)
+        {
+            xcb_randr_monitor_info_iterator_t it = xcb_randr_get_monitors_monitors_iterator(pReply);
+            for(; it.rem > 0; xcb_randr_monitor_info_next(&it))
+            {
+                monitors.push_back({ it.data->x, it.data->y, it.data->width, it.data->height });
+            }
+            free(pReply);
+        }
+    }
+#endif
+    return false == monitors.empty();
+}
+
+//---------------------------------------------------------------------------------
+// SYNC
+//---------------------------------------------------------------------------------
+
+bool XcbBackend::InitialiseSync()
+{
+#ifdef HAVE_XCB_SYNC
+    if(false == m_SyncChecked)
+    {
+        m_SyncChecked = true;
+        const xcb_query_extension_reply_t* pSync = xcb_get_extension_data(m_pConnection, &xcb_sync_id);
+        if(pSync != nullptr && pSync->present != 0)
+        {
+            // the version has to be agreed before anything else, the answer doesn't matter
+            xcb_sync_initialize_cookie_t cookie = Sent(xcb_sync_initialize(m_pConnection, XCB_SYNC_MAJOR_VERSION, XCB_SYNC_MINOR_VERSION));
+            xcb_discard_reply(m_pConnection, cookie.sequence);
+            m_SyncFirstEvent = pSync->first_event;
+        }
+    }
+#endif
+    return m_SyncFirstEvent != 0;
+}
+
+uint32_t XcbBackend::CreateCounterAlarm(uint32_t counter, int64_t value)
+{
+#ifdef HAVE_XCB_SYNC
+    if(true == InitialiseSync())
+    {
+        xcb_sync_create_alarm_value_list_t values = {};
+        values.counter = counter;
+        values.valueType = XCB_SYNC_VALUETYPE_ABSOLUTE;
+        values.value.hi = (int32_t)(value >> 32);
+        values.value.lo = (uint32_t)value;
+        values.testType = XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON;
+        values.events = 1;
+
+        xcb_sync_alarm_t alarm = xcb_generate_id(m_pConnection);
+        Sent(xcb_sync_create_alarm_aux(
+            m_pConnection,
+            alarm,
+            XCB_SYNC_CA_COUNTER | XCB_SYNC_CA_VALUE_TYPE | XCB_SYNC_CA_VALUE | XCB_SYNC_CA_TEST_TYPE | XCB_SYNC_CA_DELTA | XCB_SYNC_CA_EVENTS,
+            &values));
+        return alarm;
+    }
+#endif
+    return 0;
+}
+
+void XcbBackend::ChangeCounterAlarm(uint32_t alarm, int64_t value)
+{
+#ifdef HAVE_XCB_SYNC
+    xcb_sync_change_alarm_value_list_t values = {};
+    values.value.hi = (int32_t)(value >> 32);
+    values.value.lo = (uint32_t)value;
+    Sent(xcb_sync_change_alarm_aux(m_pConnection, alarm, XCB_SYNC_CA_VALUE, &values));
+#endif
+}
+
+void XcbBackend::DestroyCounterAlarm(uint32_t alarm)
+{
+#ifdef HAVE_XCB_SYNC
+    Sent(xcb_sync_destroy_alarm(m_pConnection, alarm));
+#endif
+}
+
+bool XcbBackend::IsCounterAlarmEvent(const xcb_generic_event_t* pEvent, uint32_t& alarm) const
+{
+#ifdef HAVE_XCB_SYNC
+    if(m_SyncFirstEvent != 0 && (pEvent->response_type & ~0x80) == m_SyncFirstEvent + XCB_SYNC_ALARM_NOTIFY)
+    {
+        alarm = ((const xcb_sync_alarm_notify_event_t*)pEvent)->alarm;
+        return true;
+    }
+#endif
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+// Composite, Render & Damage
+//---------------------------------------------------------------------------------
+
+bool XcbBackend::InitialiseThumbnails()
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    const xcb_query_extension_reply_t* pComposite = xcb_get_extension_data(m_pConnection, &xcb_composite_id);
+    const xcb_query_extension_reply_t* pRender = xcb_get_extension_data(m_pConnection, &xcb_render_id);
+    const xcb_query_extension_reply_t* pDamage = xcb_get_extension_data(m_pConnection, &xcb_damage_id);
+    if(pComposite == nullptr || pComposite->present == 0 ||
+        pRender == nullptr || pRender->present == 0 ||
+        pDamage == nullptr || pDamage->present == 0)
+    {
+        return false;
+    }
+
+    // the versions have to be agreed before anything else, the answers don't matter
+    xcb_discard_reply(m_pConnection, Sent(xcb_composite_query_version(m_pConnection, XCB_COMPOSITE_MAJOR_VERSION, XCB_COMPOSITE_MINOR_VERSION)).sequence);
+    xcb_discard_reply(m_pConnection, Sent(xcb_render_query_version(m_pConnection, XCB_RENDER_MAJOR_VERSION, XCB_RENDER_MINOR_VERSION)).sequence);
+    xcb_discard_reply(m_pConnection, Sent(xcb_damage_query_version(m_pConnection, XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION)).sequence);
+    xcb_render_query_pict_formats_cookie_t formatsCookie = Sent(xcb_render_query_pict_formats(m_pConnection));
+
+    // frames and our own windows all have the root's visual, so that's the only
+    // picture format needed
+    CountRoundTrip(formatsCookie.sequence);
+    xcb_render_query_pict_formats_reply_t* pFormats = xcb_render_query_pict_formats_reply(m_pConnection, formatsCookie, nullptr);
+    if(pFormats == nullptr)
+    {
+        return false;
+    }
+    xcb_render_pictscreen_iterator_t screens = xcb_render_query_pict_formats_screens_iterator(pFormats);
+    for(; screens.rem > 0 && m_RootPictureFormat == 0; xcb_render_pictscreen_next(&screens))
+    {
+        xcb_render_pictdepth_iterator_t depths = xcb_render_pictscreen_depths_iterator(screens.data);
+        for(; depths.rem > 0 && m_RootPictureFormat == 0; xcb_render_pictdepth_next(&depths))
+        {
+            xcb_render_pictvisual_iterator_t visuals = xcb_render_pictdepth_visuals_iterator(depths.data);
+            for(; visuals.rem > 0; xcb_render_pictvisual_next(&visuals))
+            {
+                if(visuals.data->visual == m_pScreen->root_visual)
+                {
+                    m_RootPictureFormat = visuals.data->format;
+                    break;
+                }
+            }
+        }
+    }
+    free(pFormats);
+    m_DamageFirstEvent = pDamage->first_event;
+#endif
+    return m_RootPictureFormat != 0;
+}
+
+void XcbBackend::RedirectWindow(xcb_window_t window)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_RootPictureFormat != 0)
+    {
+        Sent(xcb_composite_redirect_window(m_pConnection, window, XCB_COMPOSITE_REDIRECT_AUTOMATIC));
+    }
+#endif
+}
+
+void XcbBackend::UnredirectWindow(xcb_window_t window)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_RootPictureFormat != 0)
+    {
+        Sent(xcb_composite_unredirect_window(m_pConnection, window, XCB_COMPOSITE_REDIRECT_AUTOMATIC));
+    }
+#endif
+}
+
+uint32_t XcbBackend::CreateContentsPicture(xcb_window_t window)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_RootPictureFormat != 0)
+    {
+        // the picture holds on to the pixmap for as long as it needs it
+        xcb_pixmap_t pixmap = xcb_generate_id(m_pConnection);
+        Sent(xcb_composite_name_window_pixmap(m_pConnection, window, pixmap));
+        xcb_render_picture_t picture = xcb_generate_id(m_pConnection);
+        uint32_t values[] = { XCB_SUBWINDOW_MODE_INCLUDE_INFERIORS };
+        Sent(xcb_render_create_picture(m_pConnection, picture, pixmap, m_RootPictureFormat, XCB_RENDER_CP_SUBWINDOW_MODE, values));
+        Sent(xcb_free_pixmap(m_pConnection, pixmap));
+        return picture;
+    }
+#endif
+    return 0;
+}
+
+uint32_t XcbBackend::CreateWindowPicture(xcb_window_t window)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_RootPictureFormat != 0)
+    {
+        xcb_render_picture_t picture = xcb_generate_id(m_pConnection);
+        Sent(xcb_render_create_picture(m_pConnection, picture, window, m_RootPictureFormat, 0, nullptr));
+        return picture;
+    }
+#endif
+    return 0;
+}
+
+uint32_t XcbBackend::CreateBufferPicture(xcb_window_t window, uint16_t width, uint16_t height)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_RootPictureFormat != 0)
+    {
+        xcb_pixmap_t pixmap = xcb_generate_id(m_pConnection);
+        Sent(xcb_create_pixmap(m_pConnection, m_pScreen->root_depth, pixmap, window, width, height));
+        xcb_render_picture_t picture = xcb_generate_id(m_pConnection);
+        Sent(xcb_render_create_picture(m_pConnection, picture, pixmap, m_RootPictureFormat, 0, nullptr));
+        Sent(xcb_free_pixmap(m_pConnection, pixmap));
+        return picture;
+    }
+#endif
+    return 0;
+}
+
+void XcbBackend::FreePicture(uint32_t picture)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    Sent(xcb_render_free_picture(m_pConnection, picture));
+#endif
+}
+
+void XcbBackend::SetPictureScale(uint32_t picture, uint32_t numerator, uint32_t denominator)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    // the transform takes where we draw to back to where in the picture to read from,
+    // so it's the inverse of the scale, in 16.16 fixed point
+    xcb_render_fixed_t inverse = (xcb_render_fixed_t)(((int64_t)denominator << 16) / numerator);
+    xcb_render_transform_t transform =
+    {
+        inverse, 0, 0,
+        0, inverse, 0,
+        0, 0, 1 << 16
+    };
+    Sent(xcb_render_set_picture_transform(m_pConnection, picture, transform));
+
+    static const char FILTER[] = "bilinear";
+    Sent(xcb_render_set_picture_filter(m_pConnection, picture, sizeof(FILTER) - 1, FILTER, 0, nullptr));
+#endif
+}
+
+void XcbBackend::CompositePicture(
+    uint32_t source,
+    uint32_t destination,
+    int16_t sourceX,
+    int16_t sourceY,
+    int16_t x,
+    int16_t y,
+    uint16_t width,
+    uint16_t height)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    Sent(xcb_render_composite(m_pConnection, XCB_RENDER_PICT_OP_SRC, source, XCB_NONE, destination, sourceX, sourceY, 0, 0, x, y, width, height));
+#endif
+}
+
+void XcbBackend::FillRectangle(uint32_t picture, uint32_t colour, const xcb_rectangle_t& rectangle)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    xcb_render_color_t renderColour;
+    renderColour.red = (uint16_t)(((colour >> 16) & 0xff) * 0x101);
+    renderColour.green = (uint16_t)(((colour >> 8) & 0xff) * 0x101);
+    renderColour.blue = (uint16_t)((colour & 0xff) * 0x101);
+    renderColour.alpha = 0xffff;
+    Sent(xcb_render_fill_rectangles(m_pConnection, XCB_RENDER_PICT_OP_SRC, picture, renderColour, 1, &rectangle));
+#endif
+}
+
+uint32_t XcbBackend::CreateDamage(xcb_window_t window)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    return CreateDamage(window, XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+#else
+    return 0;
+#endif
+}
+
+uint32_t XcbBackend::CreateAreaDamage(xcb_window_t window)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    return CreateDamage(window, XCB_DAMAGE_REPORT_LEVEL_BOUNDING_BOX);
+#else
+    return 0;
+#endif
+}
+
+uint32_t XcbBackend::CreateDamage(xcb_window_t window, uint8_t level)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_DamageFirstEvent != 0)
+    {
+        xcb_damage_damage_t damage = xcb_generate_id(m_pConnection);
+        Sent(xcb_damage_create(m_pConnection, damage, window, level));
+        return damage;
+    }
+#endif
+    return 0;
+}
+
+void XcbBackend::SubtractDamage(uint32_t damage)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    Sent(xcb_damage_subtract(m_pConnection, damage, XCB_NONE, XCB_NONE));
+#endif
+}
+
+void XcbBackend::DestroyDamage(uint32_t damage)
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    Sent(xcb_damage_destroy(m_pConnection, damage));
+#endif
+}
+
+bool XcbBackend::IsDamageEvent(const xcb_generic_event_t* pEvent, uint32_t& damage, xcb_rectangle_t& area) const
+{
+#ifdef HAVE_XCB_THUMBNAILS
+    if(m_DamageFirstEvent != 0 && (pEvent->response_type & ~0x80) == m_DamageFirstEvent + XCB_DAMAGE_NOTIFY)
+    {
+        const xcb_damage_notify_event_t* pNotify = (const xcb_damage_notify_event_t*)pEvent;
+        damage = pNotify->damage;
+        area = pNotify->area;
+        return true;
+    }
+#endif
+    return false;
+}
+
+xcb_window_t XcbBackend::StartCompositing()
+{
+#ifdef HAVE_XCB_COMPOSITING
+    const xcb_query_extension_reply_t* pXFixes = xcb_get_extension_data(m_pConnection, &xcb_xfixes_id);
+    if(m_RootPictureFormat == 0 || pXFixes == nullptr || pXFixes->present == 0)
+    {
+        return XCB_WINDOW_NONE;
+    }
+    xcb_discard_reply(m_pConnection, Sent(xcb_xfixes_query_version(m_pConnection, XCB_XFIXES_MAJOR_VERSION, XCB_XFIXES_MINOR_VERSION)).sequence);
+
+    // only one client can redirect manually, so this fails if there's another
+    // compositing manager. The overlay is asked for in the same round trip.
+    xcb_void_cookie_t redirectCookie = Sent(xcb_composite_redirect_subwindows_checked(m_pConnection, m_pScreen->root, XCB_COMPOSITE_REDIRECT_MANUAL));
+    xcb_composite_get_overlay_window_cookie_t overlayCookie = Sent(xcb_composite_get_overlay_window(m_pConnection, m_pScreen->root));
+
+    CountRoundTrip(overlayCookie.sequence);
+    xcb_composite_get_overlay_window_reply_t* pOverlay = xcb_composite_get_overlay_window_reply(m_pConnection, overlayCookie, nullptr);
+    xcb_generic_error_t* pError = xcb_request_check(m_pConnection, redirectCookie);
+    if(pError != nullptr || pOverlay == nullptr)
+    {
+        // the server goes on showing the windows, and the thumbnails still work
+        free(pError);
+        free(pOverlay);
+        return XCB_WINDOW_NONE;
+    }
+    xcb_window_t overlay = pOverlay->overlay_win;
+    free(pOverlay);
+
+    // an empty input shape, so clicks go through to the windows
+    xcb_xfixes_region_t region = xcb_generate_id(m_pConnection);
+    Sent(xcb_xfixes_create_region(m_pConnection, region, 0, nullptr));
+    Sent(xcb_xfixes_set_window_shape_region(m_pConnection, overlay, XCB_SHAPE_SK_INPUT, 0, 0, region));
+    Sent(xcb_xfixes_destroy_region(m_pConnection, region));
+    return overlay;
+#else
+    return XCB_WINDOW_NONE;
+#endif
+}
@@ -0,0 +1,145 @@
+/********************************************************************************
+*
+* WARNING This file is subject to the terms and conditions defined in the file
+* 'LICENSE.txt', which is part of this source code package. Please ensure you
+* have read the 'LICENSE.txt' file before using this software.
+*
+*********************************************************************************/
+
+#pragma once
+
+#include "XBackend.h"
+#include <xcb/xcb.h>
+
+// the real thing - forwards everything to an X server over XCB
+
+namespace Emperor
+{
+    class XcbBackend : public XBackend
+    {
+    public:
+        XcbBackend();
+        virtual ~XcbBackend();
+
+        //! \brief Connect to the X server.
+        //! \param displayName The display to connect to, nullptr to use the DISPLAY environment variable.
+        //! \return true if connected, false if not.
+        bool Connect(const char* displayName);
+
+        xcb_connection_t* GetConnection() const;
+
+        // XBackend
+        xcb_window_t GetRootWindow() const override;
+        int GetFileDescriptor() const override;
+        bool HasError() const override;
+        xcb_generic_event_t* PollForEvent() override;
+        const char* GetExtensionEventName(uint8_t eventType) const override;
+        void Flush() override;
+        void Sync() override;
+
+        xcb_window_t CreateWindow(
+            xcb_window_t parent,
+            int16_t x,
+            int16_t y,
+            uint16_t width,
+            uint16_t height,
+            uint32_t valueMask,
+            const uint32_t* pValues) override;
+        void DestroyWindow(xcb_window_t window) override;
+        void ChangeWindowAttributes(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues) override;
+        void ConfigureWindow(xcb_window_t window, uint16_t valueMask, const xcb_configure_window_value_list_t& values) override;
+        void MapWindow(xcb_window_t window) override;
+        void UnmapWindow(xcb_window_t window) override;
+        void ReparentWindow(xcb_window_t window, xcb_window_t parent, int16_t x, int16_t y) override;
+        void ChangeSaveSet(uint8_t mode, xcb_window_t window) override;
+        void SetInputFocus(xcb_window_t window) override;
+        void GrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key) override;
+        void UngrabKey(xcb_window_t window, uint16_t modifiers, xcb_keycode_t key) override;
+        void GrabButton(xcb_window_t window, uint16_t eventMask, uint8_t button, uint16_t modifiers, uint8_t pointerMode) override;
+        void AllowEvents(uint8_t mode, xcb_timestamp_t time) override;
+        void UngrabKeyboard() override;
+        void GrabServer() override;
+        void UngrabServer() override;
+        void SendEvent(xcb_window_t window, uint32_t eventMask, const void* pEvent) override;
+        void KillClient(xcb_window_t window) override;
+
+        xcb_void_cookie_t RequestChangeWindowAttributesChecked(xcb_window_t window, uint32_t valueMask, const uint32_t* pValues) override;
+        uint8_t ReceiveErrorCode(xcb_void_cookie_t cookie) override;
+        xcb_intern_atom_cookie_t RequestAtom(const std::string& name) override;
+        xcb_atom_t ReceiveAtom(xcb_intern_atom_cookie_t cookie) override;
+        xcb_get_geometry_cookie_t RequestGeometry(xcb_window_t window) override;
+        bool ReceiveGeometry(xcb_get_geometry_cookie_t cookie, WindowGeometry& geometry) override;
+        xcb_get_window_attributes_cookie_t RequestAttributes(xcb_window_t window) override;
+        bool ReceiveAttributes(xcb_get_window_attributes_cookie_t cookie, WindowAttributes& attributes) override;
+        xcb_query_tree_cookie_t RequestChildren(xcb_window_t window) override;
+        bool ReceiveChildren(xcb_query_tree_cookie_t cookie, std::vector<xcb_window_t>& children) override;
+        xcb_get_property_cookie_t RequestProperty(xcb_window_t window, xcb_atom_t property, xcb_atom_t type) override;
+        bool ReceiveProperty(xcb_get_property_cookie_t cookie, std::vector<uint32_t>& values) override;
+        bool ReceiveStringProperty(xcb_get_property_cookie_t cookie, std::string& value) override;
+        xcb_get_keyboard_mapping_cookie_t RequestKeyboardMapping() override;
+        bool ReceiveKeyboardMapping(
+            xcb_get_keyboard_mapping_cookie_t cookie,
+            xcb_keycode_t& minKeycode,
+            uint8_t& keysymsPerKeycode,
+            std::vector<xcb_keysym_t>& keysyms) override;
+        xcb_grab_keyboard_cookie_t RequestKeyboardGrab(xcb_window_t window) override;
+        uint8_t ReceiveKeyboardGrab(xcb_grab_keyboard_cookie_t cookie) override;
+        xcb_query_pointer_cookie_t RequestPointerState(xcb_window_t window) override;
+        bool ReceivePointerState(xcb_query_pointer_cookie_t cookie, uint16_t& state) override;
+        ExtensionCookie RequestRefreshRate() override;
+        unsigned int ReceiveRefreshRate(ExtensionCookie cookie) override;
+        ExtensionCookie RequestMonitors() override;
+        bool ReceiveMonitors(ExtensionCookie cookie, std::vector<xcb_rectangle_t>& monitors) override;
+        uint32_t CreateCounterAlarm(uint32_t counter, int64_t value) override;
+        void ChangeCounterAlarm(uint32_t alarm, int64_t value) override;
+        void DestroyCounterAlarm(uint32_t alarm) override;
+        bool IsCounterAlarmEvent(const xcb_generic_event_t* pEvent, uint32_t& alarm) const override;
+        bool InitialiseThumbnails() override;
+        void RedirectWindow(xcb_window_t window) override;
+        void UnredirectWindow(xcb_window_t window) override;
+        uint32_t CreateContentsPicture(xcb_window_t window) override;
+        uint32_t CreateWindowPicture(xcb_window_t window) override;
+        uint32_t CreateBufferPicture(xcb_window_t window, uint16_t width, uint16_t height) override;
+        void FreePicture(uint32_t picture) override;
+        void SetPictureScale(uint32_t picture, uint32_t numerator, uint32_t denominator) override;
+        void CompositePicture(
+            uint32_t source,
+            uint32_t destination,
+            int16_t sourceX,
+            int16_t sourceY,
+            int16_t x,
+            int16_t y,
+            uint16_t width,
+            uint16_t height) override;
+        void FillRectangle(uint32_t picture, uint32_t colour, const xcb_rectangle_t& rectangle) override;
+        uint32_t CreateDamage(xcb_window_t window) override;
+        uint32_t CreateAreaDamage(xcb_window_t window) override;
+        void SubtractDamage(uint32_t damage) override;
+        void DestroyDamage(uint32_t damage) override;
+        bool IsDamageEvent(const xcb_generic_event_t* pEvent, uint32_t& damage, xcb_rectangle_t& area) const override;
+        xcb_window_t StartCompositing() override;
+
+    private:
+        // note the sequence number of a request that's just been sent
+        template<typename Cookie>
+        Cookie Sent(Cookie cookie)
+        {
+            CountRequest(cookie.sequence);
+            return cookie;
+        }
+
+        bool InitialiseSync();
+        uint32_t CreateDamage(xcb_window_t window, uint8_t level);
+
+        // 0 until InitialiseThumbnails has found Composite, Render and Damage
+        uint32_t m_RootPictureFormat = 0;
+        uint8_t m_DamageFirstEvent = 0;
+
+        xcb_connection_t* m_pConnection = nullptr;
+        xcb_screen_t* m_pScreen = nullptr;
+
+        // 0 until SYNC has been set up, and if the server doesn't have it
+        uint8_t m_SyncFirstEvent = 0;
+        bool m_SyncChecked = false;
+    };
+}
@@ -295,6 +295,9 @@ int main(int argc, char** argv)
 		}
 
 		free(pEv);
+
+		// the handlers only buffer their log lines
+		Logger::FlushThreadLog();
 	}
 
 	// free some resources